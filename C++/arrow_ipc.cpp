@@ -0,0 +1,320 @@
+#include "arrow_ipc.hpp"
+#include <algorithm>
+#include <fstream>
+
+using namespace std;
+
+// Arrow constants (see Schema.fbs, Message.fbs and File.fbs of the Arrow format)
+static const int ARROW_METADATA_V5 = 4;
+static const int ARROW_HEADER_SCHEMA = 1;
+static const int ARROW_HEADER_RECORD_BATCH = 3;
+static const int ARROW_TYPE_FLOATING_POINT = 3;
+static const int ARROW_TYPE_UTF8 = 5;
+static const int ARROW_PRECISION_SINGLE = 1;
+static const int ARROW_PRECISION_DOUBLE = 2;
+
+// alignment (and padding) of the column buffers in the file
+static const size_t ARROW_ALIGN = 64;
+
+size_t ArrowColumn::nulls() const
+{
+	return count(valid.begin(), valid.end(), 0);
+}
+
+
+
+///////////////////////////////////////////////////////////////
+// FLATBUFFERS
+///////////////////////////////////////////////////////////////
+// The Arrow metadata are FlatBuffers. This builder lays the objects out front
+// to back: every table is written before the objects it refers to, so all
+// offsets point forward as the format requires. Every value is aligned to its
+// size from the start of the buffer and written little-endian.
+
+class FlatBuilder
+{
+public:
+	// a new empty table / a vector of tables / a vector of structs / a string
+	int table(){ return add(TABLE); }
+	int tables(const vector<int> &items){ int n = add(TABLES); nodes[n].items = items; return n; }
+	int structs(const vector<unsigned char> &bytes, int count, int align){ int n = add(STRUCTS); nodes[n].bytes = bytes; nodes[n].count = count; nodes[n].align = align; return n; }
+	int text(string s){ int n = add(STRING); nodes[n].bytes.assign(s.begin(), s.end()); return n; }
+
+	// field id of a table: a scalar of size bytes, or an offset to another object
+	void scalar(int t, int id, int size, uint64_t v){ Field f = {id, size, v, -1}; nodes[t].fields.push_back(f); }
+	void child(int t, int id, int node){ Field f = {id, 4, 0, node}; nodes[t].fields.push_back(f); }
+
+	// the buffer with root table root, padded to a multiple of 8 bytes
+	vector<unsigned char> finish(int root){
+		buf.assign(8, 0);
+		put(0, write(root), 4);
+		pad(8);
+		return buf;
+	}
+
+private:
+	enum Kind { TABLE, TABLES, STRUCTS, STRING };
+	struct Field
+	{
+		int id, size;
+		uint64_t value;
+		int node;			// object the field refers to (-1 for scalars)
+	};
+	struct Node
+	{
+		Kind kind;
+		vector<Field> fields;
+		vector<int> items;
+		vector<unsigned char> bytes;
+		int count, align;
+	};
+	vector<Node> nodes;
+	vector<unsigned char> buf;
+
+	int add(Kind k){ Node n; n.kind = k; n.count = 0; n.align = 4; nodes.push_back(n); return nodes.size()-1; }
+
+	static bool larger(const Field &a, const Field &b){ return a.size > b.size; }
+
+	void pad(size_t a){ while(buf.size()%a != 0) buf.push_back(0); }
+	void put(size_t pos, uint64_t v, int size){ for(int k=0; k<size; ++k) buf[pos+k] = (unsigned char)(v >> (8*k)); }
+	size_t append(uint64_t v, int size){ size_t pos = buf.size(); buf.resize(pos+size); put(pos, v, size); return pos; }
+
+	// write node n (and the objects it refers to); returns its position
+	size_t write(int n){
+		Node node = nodes[n];
+		size_t pos, k;
+
+		if(node.kind == STRING){
+			pad(4);
+			pos = append(node.bytes.size(), 4);
+			buf.insert(buf.end(), node.bytes.begin(), node.bytes.end());
+			buf.push_back(0);
+			return pos;
+		}
+		if(node.kind == STRUCTS){
+			// the elements follow the 4-byte length and must be aligned themselves
+			pad(4);
+			while((buf.size()+4)%node.align != 0) buf.push_back(0);
+			pos = append(node.count, 4);
+			buf.insert(buf.end(), node.bytes.begin(), node.bytes.end());
+			return pos;
+		}
+		if(node.kind == TABLES){
+			pad(4);
+			pos = append(node.items.size(), 4);
+			vector<size_t> slots;
+			for(k=0; k<node.items.size(); ++k){
+				slots.push_back(append(0, 4));
+			}
+			for(k=0; k<node.items.size(); ++k){
+				put(slots[k], write(node.items[k]) - slots[k], 4);
+			}
+			return pos;
+		}
+
+		// table: the fields, largest first, after the offset to the vtable (the
+		// table starts 8-byte aligned, so each field is aligned to its size)
+		stable_sort(node.fields.begin(), node.fields.end(), larger);
+		int maxid = -1;
+		for(k=0; k<node.fields.size(); ++k){
+			maxid = max(maxid, node.fields[k].id);
+		}
+		vector<int> at(maxid+1, 0);
+		size_t size = 4;
+		for(k=0; k<node.fields.size(); ++k){
+			int s = node.fields[k].size;
+			size = (size+s-1)/s*s;
+			at[node.fields[k].id] = (int)size;
+			size += s;
+		}
+
+		pad(2);
+		size_t vtable = append(4+2*(maxid+1), 2);
+		append(size, 2);
+		for(k=0; k<at.size(); ++k){
+			append(at[k], 2);
+		}
+		pad(8);
+		pos = buf.size();
+		buf.resize(pos+size, 0);
+		put(pos, pos-vtable, 4);
+		for(k=0; k<node.fields.size(); ++k){
+			if(node.fields[k].node < 0){
+				put(pos+at[node.fields[k].id], node.fields[k].value, node.fields[k].size);
+			}
+		}
+		for(k=0; k<node.fields.size(); ++k){
+			if(node.fields[k].node >= 0){
+				size_t slot = pos+at[node.fields[k].id];
+				put(slot, write(node.fields[k].node) - slot, 4);
+			}
+		}
+		return pos;
+	}
+};
+
+// little-endian bytes of the 64-bit values (Arrow FieldNode, Buffer and Block structs)
+static void putLongs(vector<unsigned char> &out, int64_t a, int64_t b){
+	for(int k=0; k<8; ++k) out.push_back((unsigned char)((uint64_t)a >> (8*k)));
+	for(int k=0; k<8; ++k) out.push_back((unsigned char)((uint64_t)b >> (8*k)));
+}
+
+static bool hostLittleEndian(){
+	const uint16_t one = 1;
+	return *reinterpret_cast<const unsigned char*>(&one) == 1;
+}
+
+// the Schema table of cols
+static int schemaTable(FlatBuilder &fb, const vector<ArrowColumn> &cols){
+	vector<int> fields;
+	size_t k;
+
+	for(k=0; k<cols.size(); ++k){
+		int type = fb.table();
+		if(!cols[k].utf8){
+			fb.scalar(type, 0, 2, cols[k].single ? ARROW_PRECISION_SINGLE : ARROW_PRECISION_DOUBLE);
+		}
+
+		int f = fb.table();
+		fb.child(f, 0, fb.text(cols[k].name));
+		fb.scalar(f, 1, 1, 1);								// nullable
+		fb.scalar(f, 2, 1, cols[k].utf8 ? ARROW_TYPE_UTF8 : ARROW_TYPE_FLOATING_POINT);
+		fb.child(f, 3, type);
+		fb.child(f, 5, fb.tables(vector<int>()));			// no children
+		fields.push_back(f);
+	}
+
+	int schema = fb.table();
+	fb.scalar(schema, 0, 2, hostLittleEndian() ? 0 : 1);	// the values are in this machine's byte order
+	fb.child(schema, 1, fb.tables(fields));
+	return schema;
+}
+
+// an encapsulated message: continuation marker, metadata length, metadata
+// padded so that what follows starts ARROW_ALIGN-aligned in the file.
+// Returns the metadata length including the prefix.
+static int32_t writeMessage(ofstream &f, vector<unsigned char> meta){
+	while(((size_t)f.tellp() + 8 + meta.size())%ARROW_ALIGN != 0) meta.push_back(0);
+	uint32_t prefix[2] = {0xFFFFFFFF, (uint32_t)meta.size()};
+	unsigned char le[8];
+
+	for(int k=0; k<8; ++k) le[k] = (unsigned char)(prefix[k/4] >> (8*(k%4)));
+	f.write(reinterpret_cast<const char*>(le), 8);
+	f.write(reinterpret_cast<const char*>(meta.data()), meta.size());
+	return 8+meta.size();
+}
+
+bool writeArrowFile(string fn, const vector<ArrowColumn> &cols){
+	size_t rows = cols.empty() ? 0 : cols[0].rows();
+	size_t k, i;
+
+	ofstream f(fn.c_str(), ios::out | ios::binary);
+	if(!f){
+		return false;
+	}
+	f.write("ARROW1\0\0", 8);
+
+	// schema message
+	FlatBuilder sb;
+	int smsg = sb.table();
+	sb.scalar(smsg, 0, 2, ARROW_METADATA_V5);
+	sb.scalar(smsg, 1, 1, ARROW_HEADER_SCHEMA);
+	sb.child(smsg, 2, schemaTable(sb, cols));
+	sb.scalar(smsg, 3, 8, 0);
+	writeMessage(f, sb.finish(smsg));
+
+	// record batch body: per column a validity bitmap (omitted without nulls)
+	// and the values (utf8: int32 offsets and the characters), each padded to
+	// ARROW_ALIGN
+	vector<unsigned char> body, nodes, buffers;
+	int nbuffers = 0;
+	for(k=0; k<cols.size(); ++k){
+		size_t nulls = cols[k].nulls();
+		putLongs(nodes, rows, nulls);
+
+		size_t start = body.size();
+		if(nulls > 0){
+			body.resize(start + (rows+7)/8, 0);
+			for(i=0; i<rows; ++i){
+				if(cols[k].valid[i]){
+					body[start+i/8] |= (unsigned char)(1 << (i%8));
+				}
+			}
+		}
+		putLongs(buffers, start, body.size()-start);
+		body.resize((body.size()+ARROW_ALIGN-1)/ARROW_ALIGN*ARROW_ALIGN, 0);
+		nbuffers += 2;
+
+		start = body.size();
+		if(cols[k].utf8){
+			int32_t offset = 0;
+			for(i=0; i<=rows; ++i){
+				body.insert(body.end(), reinterpret_cast<unsigned char*>(&offset), reinterpret_cast<unsigned char*>(&offset)+sizeof(offset));
+				offset += (i < rows) ? cols[k].texts[i].size() : 0;
+			}
+			putLongs(buffers, start, body.size()-start);
+			body.resize((body.size()+ARROW_ALIGN-1)/ARROW_ALIGN*ARROW_ALIGN, 0);
+			nbuffers += 1;
+
+			start = body.size();
+			for(i=0; i<rows; ++i){
+				body.insert(body.end(), cols[k].texts[i].begin(), cols[k].texts[i].end());
+			}
+			putLongs(buffers, start, body.size()-start);
+			body.resize((body.size()+ARROW_ALIGN-1)/ARROW_ALIGN*ARROW_ALIGN, 0);
+			continue;
+		}
+		for(i=0; i<rows; ++i){
+			double v = cols[k].valid[i] ? cols[k].values[i] : 0;
+			if(cols[k].single){
+				float s = (float)v;
+				body.insert(body.end(), reinterpret_cast<unsigned char*>(&s), reinterpret_cast<unsigned char*>(&s)+sizeof(s));
+			} else{
+				body.insert(body.end(), reinterpret_cast<unsigned char*>(&v), reinterpret_cast<unsigned char*>(&v)+sizeof(v));
+			}
+		}
+		putLongs(buffers, start, body.size()-start);
+		body.resize((body.size()+ARROW_ALIGN-1)/ARROW_ALIGN*ARROW_ALIGN, 0);
+	}
+
+	// record batch message
+	int64_t batchPos = f.tellp();
+	FlatBuilder bb;
+	int batch = bb.table();
+	bb.scalar(batch, 0, 8, rows);
+	bb.child(batch, 1, bb.structs(nodes, cols.size(), 8));
+	bb.child(batch, 2, bb.structs(buffers, nbuffers, 8));
+	int bmsg = bb.table();
+	bb.scalar(bmsg, 0, 2, ARROW_METADATA_V5);
+	bb.scalar(bmsg, 1, 1, ARROW_HEADER_RECORD_BATCH);
+	bb.child(bmsg, 2, batch);
+	bb.scalar(bmsg, 3, 8, body.size());
+	int32_t batchMeta = writeMessage(f, bb.finish(bmsg));
+	f.write(reinterpret_cast<const char*>(body.data()), body.size());
+
+	// end-of-stream marker, then the footer: the schema again and where the record batch is
+	const unsigned char eos[8] = {0xFF, 0xFF, 0xFF, 0xFF, 0, 0, 0, 0};
+	f.write(reinterpret_cast<const char*>(eos), 8);
+
+	// Block {offset, metaDataLength (int32 + 4 bytes padding), bodyLength}
+	vector<unsigned char> blocks;
+	putLongs(blocks, batchPos, batchMeta);
+	putLongs(blocks, body.size(), 0);
+	blocks.resize(24);
+
+	FlatBuilder fb;
+	int footer = fb.table();
+	fb.scalar(footer, 0, 2, ARROW_METADATA_V5);
+	fb.child(footer, 1, schemaTable(fb, cols));
+	fb.child(footer, 2, fb.structs(vector<unsigned char>(), 0, 8));
+	fb.child(footer, 3, fb.structs(blocks, 1, 8));
+	vector<unsigned char> meta = fb.finish(footer);
+	f.write(reinterpret_cast<const char*>(meta.data()), meta.size());
+
+	unsigned char len[4];
+	for(k=0; k<4; ++k) len[k] = (unsigned char)(meta.size() >> (8*k));
+	f.write(reinterpret_cast<const char*>(len), 4);
+	f.write("ARROW1", 6);
+
+	return (bool)f;
+}
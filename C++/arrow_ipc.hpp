@@ -0,0 +1,42 @@
+#ifndef ARROW_IPC_HPP
+#define ARROW_IPC_HPP
+
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+using namespace std;
+
+///////////////////////////////////////////////////////////////
+// ARROW IPC FILES
+///////////////////////////////////////////////////////////////
+// Tables of floating point (and string) columns written as Apache Arrow IPC files (the
+// "Feather v2" format read by pyarrow, polars, pandas, R arrow, DuckDB, ...),
+// without the Arrow libraries. The file holds the schema and one record batch;
+// every column is 64-byte aligned in the file, so readers can memory-map it and
+// use the values in place.
+
+// one nullable float64 (or float32, or utf8 string) column
+class ArrowColumn
+{
+public:
+	string name;
+	bool single;						// written as float32 rather than float64
+	bool utf8;							// holds strings (texts) rather than values
+	vector<double> values;				// one value per row (ignored where not valid)
+	vector<string> texts;				// one string per row of utf8 columns
+	vector<unsigned char> valid;		// 1 where the row holds a value, 0 for null
+
+	ArrowColumn(){ single = false; utf8 = false; }
+	ArrowColumn(string m_name, bool m_single, bool m_utf8 = false){ name = m_name; single = m_single; utf8 = m_utf8; }
+
+	void push(double v, bool ok){ values.push_back(v); valid.push_back(ok ? 1 : 0); }
+	void push(string s){ texts.push_back(s); valid.push_back(1); }
+	size_t rows() const { return valid.size(); }
+	size_t nulls() const;
+};
+
+// write cols (of equal length) to fn. Returns false if the file cannot be written.
+bool writeArrowFile(string fn, const vector<ArrowColumn> &cols);
+
+#endif
@@ -0,0 +1,270 @@
+#include <algorithm>
+#include <fstream>
+#include <math.h>
+#include <string>
+#include <vector>
+
+#ifndef _WIN32
+#include <glob.h>
+#endif
+
+using namespace std;
+
+///////////////////////////////////////////////////////////////
+// BATCH MODE (MANY DEM TILES IN ONE RUN)
+///////////////////////////////////////////////////////////////
+
+///////////////////////////////////////////////////////////////
+// MOSAIC (THE TILES OF A BATCH AS ONE RASTER)
+///////////////////////////////////////////////////////////////
+
+// The tiles of a batch placed on one grid by their map info. The tiles must
+// share the pixel size and lie a whole number of pixels apart. Where tiles
+// overlap, the first tile of the batch gives the elevations.
+class Mosaic
+{
+public:
+	// place the tiles (the tiles whose header cannot be read are left out)
+	bool build(const vector<string> &m_names, const Params &prms);
+
+	// index of the tile with iFile name, or -1 if it is not in the mosaic
+	int find(string name) const;
+
+	TileFrame frame(int t) const;
+
+	// fill the halo of tile t for windows of up to radius pixels from the other
+	// tiles. Returns false if a neighbour cannot be read.
+	bool halo(int t, int radius, TileHalo &h) const;
+
+	int ncols, nlines;
+
+private:
+	vector<string> names;
+	vector<Header> hdrs;
+	vector<int> row0, col0;		// place of each tile in the mosaic
+
+	// read the rows r0 to r1-1 and columns c0 to c1-1 of the mosaic that tile u
+	// covers into the halo of tile t (NULL pixels become NaN)
+	bool copyWindow(int u, int t, int r0, int r1, int c0, int c1, TileHalo &h) const;
+};
+
+bool Mosaic::build(const vector<string> &m_names, const Params &prms){
+	size_t t;
+	double minx = 0, maxy = 0;
+
+	names.clear();
+	hdrs.clear();
+	for(t=0; t<m_names.size(); ++t){
+		Header hdr;
+		if(!hdr.Initialize(m_names[t]) || prms.iBand < 1 || prms.iBand > hdr.bands){
+			continue;
+		}
+		hdr.band = prms.iBand-1;
+		if(!hdrs.empty() && (fabs(hdr.xres-hdrs[0].xres) > 1e-6*hdrs[0].xres || fabs(hdr.yres-hdrs[0].yres) > 1e-6*hdrs[0].yres)){
+			cout << "ERROR: Mosaic tile " << m_names[t] << " has a pixel size of " << hdr.xres << " x " << hdr.yres
+				<< ", not " << hdrs[0].xres << " x " << hdrs[0].yres << endl;
+			return false;
+		}
+		minx = (hdrs.empty() || hdr.ulx < minx) ? hdr.ulx : minx;
+		maxy = (hdrs.empty() || hdr.uly > maxy) ? hdr.uly : maxy;
+		names.push_back(m_names[t]);
+		hdrs.push_back(hdr);
+	}
+	if(hdrs.empty()){
+		cout << "ERROR: No tile of the mosaic can be read" << endl;
+		return false;
+	}
+
+	ncols = 0;
+	nlines = 0;
+	row0.resize(hdrs.size());
+	col0.resize(hdrs.size());
+	for(t=0; t<hdrs.size(); ++t){
+		double x = (hdrs[t].ulx-minx)/hdrs[0].xres;
+		double y = (maxy-hdrs[t].uly)/hdrs[0].yres;
+		if(fabs(x-floor(x+0.5)) > 1e-3 || fabs(y-floor(y+0.5)) > 1e-3){
+			cout << "ERROR: Mosaic tile " << names[t] << " is not aligned with the pixels of " << names[0] << endl;
+			return false;
+		}
+		col0[t] = (int)floor(x+0.5);
+		row0[t] = (int)floor(y+0.5);
+		ncols = max(ncols, col0[t]+hdrs[t].ncols);
+		nlines = max(nlines, row0[t]+hdrs[t].nlines);
+	}
+	return true;
+}
+
+int Mosaic::find(string name) const {
+	for(size_t t=0; t<names.size(); ++t){
+		if(names[t].compare(name) == 0){
+			return (int)t;
+		}
+	}
+	return -1;
+}
+
+TileFrame Mosaic::frame(int t) const {
+	TileFrame f;
+	f.row0 = row0[t];
+	f.col0 = col0[t];
+	f.nlines = nlines;
+	f.ncols = ncols;
+	return f;
+}
+
+bool Mosaic::halo(int t, int radius, TileHalo &h) const {
+	h.allocate(frame(t), hdrs[t].ncols, hdrs[t].nlines, radius);
+
+	// the strips of the halo in mosaic coordinates
+	int r0 = row0[t], r1 = row0[t]+hdrs[t].nlines;
+	int c0 = col0[t], c1 = col0[t]+hdrs[t].ncols;
+	int strips[4][4] = {
+		{ r0-h.top, r0, c0-h.left, c1+h.right },
+		{ r1, r1+h.bottom, c0-h.left, c1+h.right },
+		{ r0, r1, c0-h.left, c0 },
+		{ r0, r1, c1, c1+h.right }
+	};
+
+	// the last tiles first, so the first tile of the batch is copied last
+	for(int u=(int)hdrs.size()-1; u>=0; --u){
+		if(u == t){
+			continue;
+		}
+		for(int k=0; k<4; ++k){
+			int a0 = max(strips[k][0], row0[u]), a1 = min(strips[k][1], row0[u]+hdrs[u].nlines);
+			int b0 = max(strips[k][2], col0[u]), b1 = min(strips[k][3], col0[u]+hdrs[u].ncols);
+			if(a0 < a1 && b0 < b1 && !copyWindow(u, t, a0, a1, b0, b1, h)){
+				cout << "ERROR: Cannot read the halo of " << names[t] << " from '" << hdrs[u].dataFile(names[u]) << "'" << endl;
+				return false;
+			}
+		}
+	}
+	return true;
+}
+
+bool Mosaic::copyWindow(int u, int t, int r0, int r1, int c0, int c1, TileHalo &h) const {
+	BandReader reader;
+	int n = c1-c0;
+	vector<float> z((size_t)(r1-r0)*n);
+	const float nan = numeric_limits<float>::quiet_NaN();
+	const float floor = hdrs[u].nullFloor(), nodata = hdrs[u].nodata;
+
+	if(!reader.open(hdrs[u].dataFile(names[u]), hdrs[u]) || !reader.readWindow(r0-row0[u], r1-row0[u], c0-col0[u], c1-col0[u], z.data())){
+		return false;
+	}
+	for(int r=r0; r<r1; ++r){
+		float *src = &z[(size_t)(r-r0)*n];
+		float *dst = h.at(r-row0[t], c0-col0[t]);
+		for(int j=0; j<n; ++j){
+			dst[j] = (src[j] > floor && src[j] != nodata) ? src[j] : nan;
+		}
+	}
+	return true;
+}
+
+// one DEM tile of a batch and what processing it gave
+struct BatchTile
+{
+	string name;			// iFile of the tile
+	WorkPool *pool;			// runs the relative relief row blocks
+	const Mosaic *mosaic;	// the tiles as one raster (--mosaic), or NULL
+	MetricsWriter metrics;	// landform metrics of the tile (kept in memory)
+	bool ok;				// the tile was read and processed
+	int ncols, nlines;
+	double seconds;			// wall time of the tile
+
+	BatchTile(){ pool = NULL; mosaic = NULL; ok = false; ncols = 0; nlines = 0; seconds = 0; }
+};
+
+// iFile name of a DEM path: ENVI rasters are named without their .hdr/.dat
+// extension, GeoTIFFs with theirs
+static string batchTileName(string fn){
+	size_t dot = fn.find_last_of(".");
+	size_t slash = fn.find_last_of("/\\");
+
+	if(dot != string::npos && (slash == string::npos || dot > slash)){
+		string ext = fn.substr(dot);
+		transform(ext.begin(), ext.end(), ext.begin(), ::tolower);
+		if(ext.compare(".hdr") == 0 || ext.compare(".dat") == 0){
+			return fn.substr(0, dot);
+		}
+	}
+	return fn;
+}
+
+// the DEMs of a batch: a glob pattern (with * or ?), or a manifest file with one
+// DEM per line (blank lines and lines starting with # are skipped). Duplicates
+// (e.g. both the .hdr and the .dat of a tile) are listed once, in their first place.
+static bool listBatchTiles(string spec, vector<string> &names){
+	vector<string> paths;
+
+	if(spec.find_first_of("*?") != string::npos){
+#ifdef _WIN32
+		WIN32_FIND_DATAA found;
+		size_t slash = spec.find_last_of("/\\");
+		string dir = (slash == string::npos) ? "" : spec.substr(0, slash+1);
+		HANDLE h = FindFirstFileA(spec.c_str(), &found);
+		if(h != INVALID_HANDLE_VALUE){
+			do{
+				if(!(found.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY)){
+					paths.push_back(dir + found.cFileName);
+				}
+			} while(FindNextFileA(h, &found));
+			FindClose(h);
+		}
+		sort(paths.begin(), paths.end());
+#else
+		glob_t g;
+		if(glob(spec.c_str(), 0, NULL, &g) == 0){
+			for(size_t k=0; k<g.gl_pathc; ++k){
+				paths.push_back(g.gl_pathv[k]);
+			}
+		}
+		globfree(&g);
+#endif
+	} else{
+		ifstream manifest(spec.c_str());
+		if(!manifest){
+			cout << "ERROR: Cannot open batch manifest '" << spec << "'" << endl;
+			return false;
+		}
+		string line;
+		while(getline(manifest, line)){
+			// trim spaces (and the \r of DOS line ends)
+			size_t a = line.find_first_not_of(" \t\r");
+			size_t b = line.find_last_not_of(" \t\r");
+			if(a == string::npos || line[a] == '#'){
+				continue;
+			}
+			paths.push_back(line.substr(a, b-a+1));
+		}
+	}
+
+	names.clear();
+	for(size_t k=0; k<paths.size(); ++k){
+		string name = batchTileName(paths[k]);
+		if(find(names.begin(), names.end(), name) == names.end()){
+			names.push_back(name);
+		}
+	}
+	if(names.empty()){
+		cout << "ERROR: No DEM found for batch '" << spec << "'" << endl;
+		return false;
+	}
+	return true;
+}
+
+// base name of the merged batch outputs: the manifest without its extension,
+// or "batch" in the directory of a glob pattern
+static string batchBaseName(string spec){
+	size_t slash = spec.find_last_of("/\\");
+
+	if(spec.find_first_of("*?") != string::npos){
+		return ((slash == string::npos) ? string("") : spec.substr(0, slash+1)) + "batch";
+	}
+	size_t dot = spec.find_last_of(".");
+	if(dot != string::npos && (slash == string::npos || dot > slash)){
+		return spec.substr(0, dot);
+	}
+	return spec;
+}
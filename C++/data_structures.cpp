@@ -1,10 +1,24 @@
 #include "data_structures.hpp"
+#include "rr_kernels.hpp"
 #include <string.h>
+#include <ctype.h>
+#include <algorithm>
+#include <charconv>
+#include <chrono>
 #include <limits>
 #include <vector>
 #include <windows.h>
 #include <iostream>
 #include <fstream>
+#include <sstream>
+
+#ifndef _WIN32
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <errno.h>
+#endif
 
 using namespace std;
 
@@ -61,10 +75,163 @@ bool Params::LoadInParameters(const char* iFileName)
   grab >> ParamDescription;
   grab >> transect_direction;
 
+  //optional keys after the fixed parameters (values separated by spaces)
+  string key, values;
+  while(grab >> key)
+  {
+	getline(grab, values);
+	istringstream vals(values);
+
+	if(key.compare("iScales") == 0)
+	{
+	  int w;
+	  while(vals >> w) iScales.push_back(w);
+	}
+	else if(key.compare("iWeights") == 0)
+	{
+	  double wt;
+	  while(vals >> wt) iWeights.push_back(wt);
+	}
+	else if(key.compare("iBand") == 0)
+	{
+	  vals >> iBand;
+	}
+	else if(key.compare("oScales") == 0)
+	{
+	  vals >> oScales;
+	}
+	else if(key.compare("oBands") == 0)
+	{
+	  vals >> oBands;
+	}
+	else if(key.compare("oRaster") == 0)
+	{
+	  vals >> oRaster;
+	}
+	else if(key.compare("oCompress") == 0)
+	{
+	  vals >> oCompress;
+	}
+	else if(key.compare("oMetrics") == 0)
+	{
+	  vals >> oMetrics;
+	}
+	else
+	{
+	  cout << "WARNING: Ignoring unknown parameter '" << key << "' in " << iFileName << endl;
+	}
+  }
+
   return true;
 };
 
 
+///////////////////////////////////////////////////////////////
+// RELATIVE RELIEF SCALES
+///////////////////////////////////////////////////////////////
+
+//this function builds the relative relief scales from the parameters. Exits
+//if the window sizes or weights are invalid.
+bool Params::setScales()
+{
+	int k;
+
+	scales.windows = iScales;
+	if(scales.windows.empty()){
+		// legacy scales: the initial window size and the next 8 odd sizes
+		for(k=0; k<9; ++k){
+			scales.windows.push_back(iWindowSize+2*k);
+		}
+	}
+
+	for(k=0; k<scales.size(); ++k){
+		if(scales.windows[k] < 3 || scales.windows[k]%2 != 1){
+			cout << "ERROR: Invalid scale --> Window size " << scales.windows[k] << " must be an odd number of at least 3!" << endl;
+			exit(1);
+		}
+		if(k > 0 && scales.windows[k] <= scales.windows[k-1]){
+			cout << "ERROR: Invalid scales --> Window sizes must be listed from smallest to largest!" << endl;
+			exit(1);
+		}
+	}
+
+	scales.weights = iWeights;
+	if(scales.weights.empty()){
+		scales.weights.assign(scales.size(), 1.0);
+	} else if((int)scales.weights.size() != scales.size()){
+		cout << "ERROR: Invalid weights --> iWeights needs one weight per window size in iScales!" << endl;
+		exit(1);
+	}
+	if(scales.weightSum() <= 0){
+		cout << "ERROR: Invalid weights --> The weights must sum to more than 0!" << endl;
+		exit(1);
+	}
+
+	if(oScales < 1){
+		cout << "ERROR: Invalid oScales --> At least 1 scale must be kept!" << endl;
+		exit(1);
+	} else if(oScales > scales.size()){
+		oScales = scales.size();
+	}
+	if(oBands.compare("separate") != 0 && oBands.compare("single") != 0){
+		cout << "ERROR: Invalid oBands --> Must be 'separate' or 'single'!" << endl;
+		exit(1);
+	}
+	if(oRaster.compare("envi") != 0 && oRaster.compare("gtiff") != 0){
+		cout << "ERROR: Invalid oRaster --> Must be 'envi' or 'gtiff'!" << endl;
+		exit(1);
+	}
+	if(tiffCompression(oCompress) < 0){
+#ifdef RR_ZLIB
+		cout << "ERROR: Invalid oCompress --> Must be 'lzw', 'deflate' or 'none'!" << endl;
+#else
+		cout << "ERROR: Invalid oCompress --> Must be 'lzw' or 'none' ('deflate' needs a build with -DRR_ZLIB -lz)!" << endl;
+#endif
+		exit(1);
+	}
+	if(!csvMetrics() && !arrowMetrics()){
+		cout << "ERROR: Invalid oMetrics --> Must be 'csv', 'arrow' or 'both'!" << endl;
+		exit(1);
+	}
+
+	// the smallest window defines the raster edge that is masked
+	iWindowSize = scales.window(0);
+
+	return true;
+}
+
+unsigned char Params::landformBits() const
+{
+	if(oProduct.compare("shoreline")==0){
+		return SHORELINE_BIT;
+	} else if(oProduct.compare("dunetoe")==0){
+		return DUNE_TOE_BIT;
+	} else if(oProduct.compare("dunecrest")==0){
+		return DUNE_CREST_BIT;
+	} else if(oProduct.compare("duneheel")==0){
+		return DUNE_HEEL_BIT;
+	} else if(oProduct.compare("backbarrier")==0){
+		return BACKBARRIER_BIT;
+	} else if(oProduct.compare("rr")==0){
+		return 0;
+	}
+	// landforms, all
+	return SHORELINE_BIT | DUNE_TOE_BIT | DUNE_CREST_BIT | DUNE_HEEL_BIT | BACKBARRIER_BIT;
+}
+
+double ScaleSet::weightSum() const
+{
+	double wsum = 0;
+	int k;
+
+	for(k=0; k<size(); ++k){
+		wsum += weights[k];
+	}
+
+	return wsum;
+}
+
+
 ///////////////////////////////////////////////////////////////
 // HEADER INFORMATION
 ///////////////////////////////////////////////////////////////
@@ -110,6 +277,12 @@ bool Header::LoadInParameters(string filename){
 			Header::bands = atoi(line.substr(line.find_first_of("=")+2, line.length()-1).c_str());
 		}
 
+		// value of NULL pixels
+		if(item.compare("data ignore value") == 0){
+			Header::nodata = atof(line.substr(line.find_first_of("=")+2, line.length()-1).c_str());
+			Header::hasNodata = true;
+		}
+
 		// header offset information
 		if(item.compare("header offset") == 0){
 			Header::headeroffset = atoi(line.substr(line.find_first_of("=")+2, line.length()-1).c_str());
@@ -125,9 +298,21 @@ bool Header::LoadInParameters(string filename){
 			Header::datatype = atoi(line.substr(line.find_first_of("=")+2, line.length()-1).c_str());
 		}
 
+		// get byte order
+		if(item.compare("byte order") == 0){		// 0 = little-endian, 1 = big-endian
+			Header::byteorder = atoi(line.substr(line.find_first_of("=")+2, line.length()-1).c_str());
+		}
+
 		// get interleave format
 		if(item.compare("interleave") == 0){		// "BSQ" | "BIL" | "BIP"
-			Header::interleave = line.substr(line.find_first_of("=")+2, line.length()-1);
+			// kept in lower case, without spaces
+			string value = line.substr(line.find_first_of("=")+1);
+			Header::interleave = "";
+			for(i=0; i<(int)value.length(); ++i){
+				if(!isspace((unsigned char)value[i])){
+					Header::interleave += (char)tolower((unsigned char)value[i]);
+				}
+			}
 		}
 
 		// get sensor type
@@ -206,6 +391,30 @@ bool Header::LoadInParameters(string filename){
 	return true;
 }
 
+int Header::valueSize() const
+{
+	switch(Header::datatype){
+		case 1: return 1;		// uint8
+		case 2: return 2;		// int16
+		case 3: return 4;		// int32
+		case 4: return 4;		// float32
+		case 5: return 8;		// float64
+		case 12: return 2;		// uint16
+		case 13: return 4;		// uint32
+		case 14: return 8;		// int64
+		case 15: return 8;		// uint64
+	}
+	return 0;
+}
+
+bool Header::swapBytes() const
+{
+	const uint16_t one = 1;
+	bool little = (*reinterpret_cast<const unsigned char*>(&one) == 1);
+
+	return (Header::byteorder == 1) == little && Header::valueSize() > 1;
+}
+
 
 
 
@@ -241,7 +450,10 @@ void Header::writeHDR(string fn, vector<unsigned int> outinfo){
 	(void) fprintf(wrhead, "byte order = 0\n");
 	(void) fprintf(wrhead, "map info = {%s, 1.00000, 1.00000, %le, %le, %le, %le, %s, %s, %s, units=%s}\n", Header::coordsys.c_str(), Header::ulx, Header::uly, Header::xres, Header::yres, Header::utm_zone_number.c_str(), Header::utm_zone_band.c_str(), Header::datum.c_str(), Header::units.c_str());
 	(void) fprintf(wrhead, "coordinate system string = {PROJCS[\"UTM_Zone_14N\",GEOGCS[\"GCS_WGS_1984\",DATUM[\"D_WGS_1984\",SPHEROID[\"WGS_1984\",6378137.0,298.257223563]],PRIMEM[\"Greenwich\",0.0],UNIT[\"Degree\",0.0174532925199433]],PROJECTION[\"Transverse_Mercator\"],PARAMETER[\"False_Easting\",500000.0],PARAMETER[\"False_Northing\",0.0],PARAMETER[\"Central_Meridian\",-99.0],PARAMETER[\"Scale_Factor\",0.9996],PARAMETER[\"Latitude_Of_Origin\",0.0],UNIT[\"Meter\",1.0]]}\n");
-	(void) fprintf(wrhead, "data ignore value = -9999\n");
+	// (no data ignore value: every byte value is data)
+	if(!Header::bandnames.empty()){
+		(void) fprintf(wrhead, "band names = {%s}\n", Header::bandnames.c_str());
+	}
 	(void) fprintf(wrhead, "wavelength units = Unknown");
 
 	// close the header file
@@ -318,6 +530,9 @@ void Header::writeHDR(string fn, vector<float> outinfo){
 	(void) fprintf(wrhead, "map info = {%s, 1.00000, 1.00000, %le, %le, %le, %le, %s, %s, %s, units=%s}\n", Header::coordsys.c_str(), Header::ulx, Header::uly, Header::xres, Header::yres, Header::utm_zone_number.c_str(), Header::utm_zone_band.c_str(), Header::datum.c_str(), Header::units.c_str());
 	(void) fprintf(wrhead, "coordinate system string = {PROJCS[\"UTM_Zone_14N\",GEOGCS[\"GCS_WGS_1984\",DATUM[\"D_WGS_1984\",SPHEROID[\"WGS_1984\",6378137.0,298.257223563]],PRIMEM[\"Greenwich\",0.0],UNIT[\"Degree\",0.0174532925199433]],PROJECTION[\"Transverse_Mercator\"],PARAMETER[\"False_Easting\",500000.0],PARAMETER[\"False_Northing\",0.0],PARAMETER[\"Central_Meridian\",-99.0],PARAMETER[\"Scale_Factor\",0.9996],PARAMETER[\"Latitude_Of_Origin\",0.0],UNIT[\"Meter\",1.0]]}\n");
 	(void) fprintf(wrhead, "data ignore value = -9999\n");
+	if(!Header::bandnames.empty()){
+		(void) fprintf(wrhead, "band names = {%s}\n", Header::bandnames.c_str());
+	}
 	(void) fprintf(wrhead, "wavelength units = Unknown");
 
 	// close the header file
@@ -380,9 +595,9 @@ void Header::writeDAT(string fn, vector<unsigned int> outdat){
 		ofstream fout;
 		fout.open(tmp, ios::out | ios::binary);
 
-//		cout << "outdat is NOT empty." << endl;
-//		size_t size = outdat.size()*sizeof(outdat);
-		fout.write(reinterpret_cast<char*>(outdat.data()), outdat.size()*sizeof(BYTE));
+		// written as bytes to match the header (data type 1)
+		vector<unsigned char> bytes(outdat.begin(), outdat.end());
+		fout.write(reinterpret_cast<char*>(bytes.data()), bytes.size());
 //		(void) fwrite((float)outdat, sizeof(float), Header::npix, wrdat);
 
 		cout << "Successfully wrote data to binary file: " << tmp.c_str() << endl;
@@ -433,6 +648,42 @@ void Header::writeDAT(string fn, vector<float> outdat){
 		FILE.close();
 	}
 }
+void Header::writeDAT(string fn, const float *outdat, size_t n){
+	string tmp = fn;
+	tmp.append(".dat");
+
+	// write the binary data to file
+	if(n > 0){
+		ofstream fout;
+		fout.open(tmp, ios::out | ios::binary);
+
+		fout.write(reinterpret_cast<const char*>(outdat), n*sizeof(float));
+
+		cout << "Successfully wrote data to binary file: " << tmp.c_str() << endl;
+		cout << endl;
+
+		// close the file
+		fout.close();
+	}
+}
+void Header::writeDAT(string fn, const unsigned char *outdat, size_t n){
+	string tmp = fn;
+	tmp.append(".dat");
+
+	// write the binary data to file
+	if(n > 0){
+		ofstream fout;
+		fout.open(tmp, ios::out | ios::binary);
+
+		fout.write(reinterpret_cast<const char*>(outdat), n);
+
+		cout << "Successfully wrote data to binary file: " << tmp.c_str() << endl;
+		cout << endl;
+
+		// close the file
+		fout.close();
+	}
+}
 void Header::writeDAT(string fn, vector<double> outdat){
 	string tmp = fn;
 	tmp.append(".dat");
@@ -458,82 +709,847 @@ void Header::writeDAT(string fn, vector<double> outdat){
 
 
 ///////////////////////////////////////////////////////////////
-// RASTER INFORMATION
+// BAND READER
 ///////////////////////////////////////////////////////////////
 
-// Function to initialize raster of specified size
-void Raster::Init(int m_size)
+bool BandReader::open(string fn, const Header &hdr){
+	tiff = hdr.tiff();
+	if(tiff){
+		return tif.open(fn, hdr);
+	}
+
+	f.open(fn.c_str(), ios::binary | ios::in);
+	if(!f){
+		return false;
+	}
+
+	offset = hdr.headeroffset;
+	ncols = hdr.ncols;
+	nlines = hdr.nlines;
+	bands = hdr.bands;
+	band = hdr.band;
+	datatype = hdr.datatype;
+	size = hdr.valueSize();
+	swap = hdr.swapBytes();
+	// a single band is stored the same way in every interleave
+	interleave = hdr.bandSequential() ? "bsq" : hdr.interleave;
+
+	return true;
+}
+
+void BandReader::convert(const char *src, float *dst, size_t n){
+	rrKernels().convert(src, dst, (int)n, datatype, swap);
+}
+
+bool BandReader::read(int r0, int r1, float *dst){
+	size_t rowBytes = (size_t)ncols*size;
+	size_t n = (size_t)(r1-r0)*ncols;
+	bool direct = (datatype == 4 && !swap);
+	int r, j;
+
+	if(tiff){
+		return tif.read(r0, r1, dst);
+	}
+
+	if(interleave.compare("bsq") == 0){
+		// band b is nlines contiguous rows
+		f.seekg(offset + ((streamoff)band*nlines + r0)*(streamoff)rowBytes);
+		if(direct){
+			f.read(reinterpret_cast<char*>(dst), n*sizeof(float));
+		} else{
+			raw.resize(n*size);
+			f.read(raw.data(), raw.size());
+			convert(raw.data(), dst, n);
+		}
+	} else if(interleave.compare("bil") == 0){
+		// row r holds band 0 to bands-1, one after the other
+		raw.resize(rowBytes);
+		for(r=r0; r<r1 && f; ++r){
+			float *row = dst+(size_t)(r-r0)*ncols;
+			f.seekg(offset + ((streamoff)r*bands + band)*(streamoff)rowBytes);
+			if(direct){
+				f.read(reinterpret_cast<char*>(row), rowBytes);
+			} else{
+				f.read(raw.data(), rowBytes);
+				convert(raw.data(), row, ncols);
+			}
+		}
+	} else{
+		// bip: pixel j of row r holds band 0 to bands-1
+		raw.resize(n*bands*size);
+		packed.resize(n*size);
+		f.seekg(offset + (streamoff)r0*bands*(streamoff)rowBytes);
+		f.read(raw.data(), raw.size());
+		const char *src = raw.data()+(size_t)band*size;
+		for(j=0; j<(int)n; ++j){
+			memcpy(&packed[(size_t)j*size], src+(size_t)j*bands*size, size);
+		}
+		convert(packed.data(), dst, n);
+	}
+
+	return (bool)f;
+}
+
+bool BandReader::readWindow(int r0, int r1, int c0, int c1, float *dst){
+	int w = c1-c0;
+	int r;
+
+	if(c0 == 0 && c1 == ncols){
+		return read(r0, r1, dst);
+	}
+
+	if(!tiff && interleave.compare("bip") != 0){
+		// one seek and read per row
+		size_t rowBytes = (size_t)ncols*size;
+		raw.resize((size_t)w*size);
+		for(r=r0; r<r1 && f; ++r){
+			streamoff row = (interleave.compare("bsq") == 0) ? (streamoff)band*nlines + r : (streamoff)r*bands + band;
+			f.seekg(offset + row*(streamoff)rowBytes + (streamoff)c0*size);
+			f.read(raw.data(), raw.size());
+			convert(raw.data(), dst+(size_t)(r-r0)*w, w);
+		}
+		return (bool)f;
+	}
+
+	// whole rows, a few at a time
+	const int chunk = 64;
+	for(r=r0; r<r1; r+=chunk){
+		int e = (r+chunk < r1) ? r+chunk : r1;
+		rows.resize((size_t)(e-r)*ncols);
+		if(!read(r, e, rows.data())){
+			return false;
+		}
+		for(int i=r; i<e; ++i){
+			copy(&rows[(size_t)(i-r)*ncols+c0], &rows[(size_t)(i-r)*ncols+c1], dst+(size_t)(i-r0)*w);
+		}
+	}
+	return true;
+}
+
+
+///////////////////////////////////////////////////////////////
+// ELEVATION BUFFER
+///////////////////////////////////////////////////////////////
+
+ElevationBuffer::ElevationBuffer()
 {
-	Raster::x.resize(m_size);
-	Raster::y.resize(m_size);
-	Raster::z.resize(m_size);
-	Raster::complete.resize(m_size);
-	Raster::res.resize(m_size);
-	Raster::avg.resize(m_size);
-	Raster::shoreline.resize(m_size);
-	Raster::dune_toe_line.resize(m_size);
-	Raster::dune_ridge_line.resize(m_size);
-	Raster::dune_heel_line.resize(m_size);
-	Raster::backbarrier_line.resize(m_size);
+	ptr = NULL;
+	n = 0;
+	base = NULL;
+	len = 0;
+#ifdef _WIN32
+	hfile = INVALID_HANDLE_VALUE;
+	hmap = NULL;
+#endif
+}
 
-//	cout << "Raster size (init): " << Raster::z.size() << endl;  // for debugging purposes
+ElevationBuffer::~ElevationBuffer()
+{
+	release();
 }
 
+void ElevationBuffer::release(){
+	if(base){
+#ifdef _WIN32
+		UnmapViewOfFile(base);
+		CloseHandle(hmap);
+		CloseHandle(hfile);
+		hmap = NULL;
+		hfile = INVALID_HANDLE_VALUE;
+#else
+		munmap(base, len);
+#endif
+		base = NULL;
+		len = 0;
+	}
+	vector<float>().swap(owned);
+	ptr = NULL;
+	n = 0;
+}
 
-// Function to initialze a raster (wrapper for several functions)
-void Raster::Initialize(Params prms, Header hdr)
+float *ElevationBuffer::allocate(size_t m_n){
+	release();
+	owned.resize(m_n);
+	ptr = owned.data();
+	n = m_n;
+
+	return owned.data();
+}
+
+bool ElevationBuffer::map(string fn, size_t offset, size_t m_n, bool copyOnWrite){
+	release();
+
+	// the values must be float aligned within the file
+	if(offset%sizeof(float) != 0 || m_n == 0){
+		return false;
+	}
+	size_t bytes = m_n*sizeof(float);
+
+#ifdef _WIN32
+	SYSTEM_INFO si;
+	GetSystemInfo(&si);
+	size_t start = offset - offset%si.dwAllocationGranularity;
+
+	hfile = CreateFileA(fn.c_str(), GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, NULL);
+	if(hfile == INVALID_HANDLE_VALUE){
+		return false;
+	}
+	LARGE_INTEGER fsize;
+	if(!GetFileSizeEx(hfile, &fsize) || (unsigned long long)fsize.QuadPart < offset+bytes){
+		CloseHandle(hfile);
+		hfile = INVALID_HANDLE_VALUE;
+		return false;
+	}
+	hmap = CreateFileMappingA(hfile, NULL, copyOnWrite ? PAGE_WRITECOPY : PAGE_READONLY, 0, 0, NULL);
+	if(!hmap){
+		CloseHandle(hfile);
+		hfile = INVALID_HANDLE_VALUE;
+		return false;
+	}
+	len = offset+bytes-start;
+	base = MapViewOfFile(hmap, copyOnWrite ? FILE_MAP_COPY : FILE_MAP_READ, (DWORD)((unsigned long long)start >> 32), (DWORD)(start & 0xFFFFFFFF), len);
+	if(!base){
+		CloseHandle(hmap);
+		CloseHandle(hfile);
+		hmap = NULL;
+		hfile = INVALID_HANDLE_VALUE;
+		len = 0;
+		return false;
+	}
+#else
+	size_t page = sysconf(_SC_PAGESIZE);
+	size_t start = offset - offset%page;
+
+	int fd = open(fn.c_str(), O_RDONLY);
+	if(fd < 0){
+		return false;
+	}
+	struct stat st;
+	if(fstat(fd, &st) != 0 || (size_t)st.st_size < offset+bytes){
+		close(fd);
+		return false;
+	}
+	len = offset+bytes-start;
+	base = mmap(NULL, len, copyOnWrite ? PROT_READ|PROT_WRITE : PROT_READ, MAP_PRIVATE, fd, start);
+	close(fd);		// the mapping keeps the file open
+	if(base == MAP_FAILED){
+		base = NULL;
+		len = 0;
+		return false;
+	}
+	// start reading the file in the background while the header is processed
+	madvise(base, len, MADV_WILLNEED);
+#endif
+
+	ptr = reinterpret_cast<const float*>(static_cast<const char*>(base) + (offset-start));
+	n = m_n;
+
+	return true;
+}
+
+void ElevationBuffer::adviseSequential(){
+#ifndef _WIN32
+	if(base){
+		madvise(base, len, MADV_SEQUENTIAL);
+	}
+#endif
+}
+
+
+
+///////////////////////////////////////////////////////////////
+// ASYNCHRONOUS OUTPUT
+///////////////////////////////////////////////////////////////
+
+// largest single write (and the file alignment of the merged writes)
+static const uint64_t ASYNC_CHUNK = 8 << 20;
+
+AsyncWriter::AsyncWriter()
+{
+	stopping = false;
+	failed = false;
+}
+
+AsyncWriter::~AsyncWriter()
 {
-	Raster::Init(hdr.npix);  // initialize the Raster object with size npix
+	if(!workers.empty() || !files.empty()){
+		finish();
+	}
+}
+
+bool AsyncWriter::open(const vector<string> &names, int nthreads){
+	size_t k;
+	int t;
+
+	for(k=0; k<names.size(); ++k){
+#ifdef _WIN32
+		HANDLE h = CreateFileA(names[k].c_str(), GENERIC_WRITE, 0, NULL, CREATE_ALWAYS, FILE_ATTRIBUTE_NORMAL, NULL);
+		if(h == INVALID_HANDLE_VALUE){
+			closeFiles();
+			return false;
+		}
+#else
+		int h = ::open(names[k].c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+		if(h < 0){
+			closeFiles();
+			return false;
+		}
+#endif
+		files.push_back(h);
+	}
+
+	stopping = false;
+	failed = false;
+	for(t=0; t<nthreads || t<1; ++t){
+		workers.push_back(thread(&AsyncWriter::run, this));
+	}
+
+	return true;
+}
+
+void AsyncWriter::write(int k, uint64_t offset, const char *src, size_t len){
+	unique_lock<mutex> guard(lock);
+
+	while(len > 0){
+		// up to the next chunk boundary of the file
+		size_t n = ASYNC_CHUNK - offset%ASYNC_CHUNK;
+		if(n > len){
+			n = len;
+		}
+
+		// extend the last queued range if this one continues it within its chunk
+		if(!jobs.empty()){
+			Job &last = jobs.back();
+			if(last.file == k && last.offset+last.len == offset && last.src+last.len == src && last.offset%ASYNC_CHUNK + last.len + n <= ASYNC_CHUNK){
+				last.len += n;
+				offset += n;
+				src += n;
+				len -= n;
+				continue;
+			}
+		}
+
+		Job j = {k, offset, src, n};
+		jobs.push_back(j);
+		offset += n;
+		src += n;
+		len -= n;
+	}
+	guard.unlock();
+	queued.notify_all();
+}
+
+bool AsyncWriter::finish(){
+	size_t t;
 
-	if(!readDAT((prms.iFile), hdr))  // if unable to read input data file(s)
 	{
-		cout << "Input filename: " << prms.iFile << endl;
-		cout << "ERROR: Cannot find '" << prms.iFile << ".dat'" << endl;
+		unique_lock<mutex> guard(lock);
+		stopping = true;
+	}
+	queued.notify_all();
+	for(t=0; t<workers.size(); ++t){
+		workers[t].join();
+	}
+	workers.clear();
+	closeFiles();
+
+	return !failed;
+}
+
+void AsyncWriter::run(){
+	for(;;){
+		Job j;
+		{
+			unique_lock<mutex> guard(lock);
+			while(jobs.empty() && !stopping){
+				queued.wait(guard);
+			}
+			if(jobs.empty()){
+				return;
+			}
+			j = jobs.front();
+			jobs.pop_front();
+		}
+
+		if(!writeJob(j)){
+			unique_lock<mutex> guard(lock);
+			failed = true;
+		}
+	}
+}
+
+// write one range, resuming after short writes
+bool AsyncWriter::writeJob(const Job &j){
+	size_t done = 0;
+
+	while(done < j.len){
+#ifdef _WIN32
+		OVERLAPPED at;
+		DWORD n = 0;
+		uint64_t pos = j.offset+done;
+		memset(&at, 0, sizeof(at));
+		at.Offset = (DWORD)(pos & 0xFFFFFFFF);
+		at.OffsetHigh = (DWORD)(pos >> 32);
+		if(!WriteFile(files[j.file], j.src+done, (DWORD)(j.len-done), &n, &at) || n == 0){
+			return false;
+		}
+#else
+		ssize_t n = pwrite(files[j.file], j.src+done, j.len-done, (off_t)(j.offset+done));
+		if(n < 0 && errno == EINTR){
+			continue;
+		}
+		if(n <= 0){
+			return false;
+		}
+#endif
+		done += n;
+	}
+
+	return true;
+}
+
+void AsyncWriter::closeFiles(){
+	size_t k;
+
+	for(k=0; k<files.size(); ++k){
+#ifdef _WIN32
+		CloseHandle(files[k]);
+#else
+		::close(files[k]);
+#endif
+	}
+	files.clear();
+}
+
+
+
+///////////////////////////////////////////////////////////////
+// LANDFORM METRICS
+///////////////////////////////////////////////////////////////
+
+// size of the CSV buffer (written to the file whenever it fills up)
+static const size_t METRICS_BUFFER = 1 << 20;
+
+// room for one value and its ", " (at most 15 digits before the point and 17 significant digits)
+static const size_t METRICS_VALUE = 64;
+
+// the fill value of missing metrics (a null in the Arrow file)
+static const double METRICS_NODATA = -99999;
+
+MetricsWriter::MetricsWriter()
+{
+	file = NULL;
+	used = 0;
+	first = true;
+	failed = false;
+	csv = false;
+	arrow = false;
+	memory = false;
+	nrows = 0;
+	col = 0;
+}
+
+MetricsWriter::~MetricsWriter()
+{
+	close();
+}
+
+bool MetricsWriter::open(string csvName, string m_arrowName){
+	openMemory(!csvName.empty(), !m_arrowName.empty());
+	memory = false;
+	arrowName = m_arrowName;
+
+	if(!csvName.empty()){
+		file = fopen(csvName.c_str(), "wb");
+		buf.resize(METRICS_BUFFER);
+	}
+	// (the Arrow file is written on close: fail now rather than after the whole run)
+	FILE *f = arrow ? fopen(arrowName.c_str(), "wb") : NULL;
+	if(f){
+		fclose(f);
+	}
+	if((csv && !file) || (arrow && !f)){
+		close();
+		return false;
+	}
+	return true;
+}
+
+void MetricsWriter::openMemory(bool m_csv, bool m_arrow){
+	file = NULL;
+	used = 0;
+	first = true;
+	failed = false;
+	csv = m_csv;
+	arrow = m_arrow;
+	memory = true;
+	nrows = 0;
+	arrowName.clear();
+	cols.clear();
+	landformX.clear();
+	col = 0;
+}
+
+void MetricsWriter::column(string name, bool single){
+	cols.push_back(ArrowColumn(name, single));
+	landformX.push_back(0);
+}
+
+void MetricsWriter::textColumn(string name){
+	cols.push_back(ArrowColumn(name, false, true));
+	landformX.push_back(0);
+}
+
+void MetricsWriter::landformColumns(string name){
+	column(name + "X");
+	landformX.back() = 1;
+	column(name + "Z", true);
+	landformX.back() = 2;
+}
+
+void MetricsWriter::header(){
+	if(!csv){
+		return;
+	}
+	for(size_t k=0; k<cols.size(); ++k){
+		text(cols[k].name.c_str());
+		text(k+1 < cols.size() ? ", " : "\n");
+	}
+}
+
+// make room for n more bytes
+void MetricsWriter::reserve(size_t n){
+	if(memory){
+		if(used+n > buf.size()){
+			buf.resize(max(2*buf.size(), used+n));
+		}
+		return;
+	}
+	if(used+n > buf.size()){
+		if(used > 0 && fwrite(buf.data(), 1, used, file) != used){
+			failed = true;
+		}
+		used = 0;
+		if(n > buf.size()){
+			buf.resize(n);
+		}
+	}
+}
+
+void MetricsWriter::text(const char *s){
+	size_t n = strlen(s);
+
+	reserve(n);
+	memcpy(&buf[used], s, n);
+	used += n;
+	first = (n > 0 && s[n-1] == '\n') ? true : first;
+}
+
+// shortest decimal of v that reads back as v: in fixed notation (coordinates,
+// elevations, volumes), or in scientific notation if that would need more
+// than a few leading or trailing zeros
+template<class T>
+static char *shortestDecimal(char *first, char *last, T v){
+	T a = (v < 0) ? -v : v;
+
+	if(a == 0 || (a >= (T)1e-5 && a < (T)1e15)){
+		return to_chars(first, last, v, chars_format::fixed).ptr;
+	}
+	return to_chars(first, last, v, chars_format::scientific).ptr;
+}
+
+// add v to the Arrow column of the current value. Missing landforms (X of 0)
+// and the fill value are nulls.
+void MetricsWriter::keep(double v){
+	if(!arrow || col >= cols.size()){
+		return;
+	}
+	ArrowColumn &c = cols[col];
+	bool ok = (v != METRICS_NODATA);
+
+	if(landformX[col] == 1 && v == 0){
+		ok = false;
+	}
+	if(landformX[col] == 2 && col > 0 && !cols[col-1].valid.back()){
+		ok = false;
+	}
+	c.push(v, ok);
+	++col;
+}
+
+void MetricsWriter::value(double v){
+	keep(v);
+	if(!csv){
+		return;
+	}
+	reserve(METRICS_VALUE);
+	if(!first){
+		buf[used++] = ',';
+		buf[used++] = ' ';
+	}
+	used = shortestDecimal(&buf[used], buf.data()+buf.size(), v) - buf.data();
+	first = false;
+}
+
+void MetricsWriter::value(float v){
+	keep(v);
+	if(!csv){
+		return;
+	}
+	reserve(METRICS_VALUE);
+	if(!first){
+		buf[used++] = ',';
+		buf[used++] = ' ';
+	}
+	used = shortestDecimal(&buf[used], buf.data()+buf.size(), v) - buf.data();
+	first = false;
+}
+
+void MetricsWriter::endLine(){
+	col = 0;
+	++nrows;
+	if(!csv){
+		return;
+	}
+	reserve(1);
+	buf[used++] = '\n';
+	first = true;
+}
+
+void MetricsWriter::copyLine(const string &s){
+	const char *p = s.c_str();
+	char *e;
+
+	// the columns take the values read back (they were written to read back exactly)
+	col = 0;
+	while(arrow && *p){
+		double v = strtod(p, &e);
+		if(e == p){
+			break;
+		}
+		keep(v);
+		p = (*e == ',') ? e+1 : e;
+	}
+	if(csv){
+		text(s.c_str());
+	}
+	endLine();
+}
+
+void MetricsWriter::append(const MetricsWriter &tile, string name){
+	size_t k, i;
+
+	if(csv && tile.csv){
+		// the lines after the header, each after the name
+		const char *p = tile.buf.data();
+		const char *end = p + tile.used;
+		p = find(p, end, '\n');
+		p = (p < end) ? p+1 : end;
+		while(p < end){
+			const char *e = find(p, end, '\n');
+			e = (e < end) ? e+1 : end;
+			text(name.c_str());
+			text(", ");
+			reserve(e-p);
+			memcpy(&buf[used], p, e-p);
+			used += e-p;
+			p = e;
+		}
+		first = true;
+	}
+	if(arrow && tile.arrow && cols.size() == tile.cols.size()+1){
+		for(i=0; i<tile.cols[0].rows(); ++i){
+			cols[0].push(name);
+		}
+		for(k=0; k<tile.cols.size(); ++k){
+			cols[k+1].values.insert(cols[k+1].values.end(), tile.cols[k].values.begin(), tile.cols[k].values.end());
+			cols[k+1].valid.insert(cols[k+1].valid.end(), tile.cols[k].valid.begin(), tile.cols[k].valid.end());
+		}
+	}
+	nrows += tile.nrows;
+}
+
+bool MetricsWriter::close(){
+	if(arrow && !memory){
+		if(!writeArrowFile(arrowName, cols)){
+			failed = true;
+		}
+	}
+	csv = false;
+	arrow = false;
+	arrowName.clear();
+	cols.clear();
+	if(!file){
+		return !failed;
+	}
+	if(used > 0 && fwrite(buf.data(), 1, used, file) != used){
+		failed = true;
+	}
+	used = 0;
+	if(fclose(file) != 0){
+		failed = true;
+	}
+	file = NULL;
+
+	return !failed;
+}
+
+
+
+///////////////////////////////////////////////////////////////
+// RELATIVE RELIEF BANDS
+///////////////////////////////////////////////////////////////
+
+ReliefBands::ReliefBands()
+{
+	base = NULL;
+	nscale = 0;
+	npix = 0;
+}
+
+void ReliefBands::allocate(int m_nscales, size_t m_npix){
+	const size_t align = 64/sizeof(float);
+
+	nscale = m_nscales;
+	npix = m_npix;
+
+	// over-allocate by one alignment unit and start band 0 on a 64-byte boundary
+	store.assign((size_t)(nscale+1)*npix+align, 0.0f);
+	size_t skip = (align - (reinterpret_cast<size_t>(store.data())/sizeof(float))%align)%align;
+	base = store.data()+skip;
+}
+
+bool ReliefBands::map(string fn, size_t offset, int m_nscales, size_t m_npix){
+	if(!cached.map(fn, offset, (size_t)(m_nscales+1)*m_npix, true)){
+		return false;
+	}
+	vector<float>().swap(store);
+	nscale = m_nscales;
+	npix = m_npix;
+	// (the pages are private: setting NULLs does not change the file)
+	base = const_cast<float*>(cached.data());
+
+	return true;
+}
+
+void ReliefBands::setNull(size_t i){
+	int b;
+
+	for(b=0; b<=nscale; ++b){
+		base[(size_t)b*npix+i] = -9999;
 	}
 }
 
-// Function to read data file
-bool Raster::readDAT(string fn, Header hdr){
-	register int count, t, s, idx;
-	ifstream f;
 
+
+///////////////////////////////////////////////////////////////
+// RASTER INFORMATION
+///////////////////////////////////////////////////////////////
+
+// Function to initialize raster of specified size, keeping m_nscales relative relief
+// scales (0 keeps only the average) and the landform lines in m_lines (LandformBit)
+void Raster::Init(int m_size, int m_nscales, unsigned char m_lines)
+{
+	Raster::rr.allocate(m_nscales, m_size);
+	Raster::res = (m_nscales > 0) ? Raster::rr.scale(0) : NULL;
+	Raster::avg = Raster::rr.average();
+	Raster::lineBits = m_lines;
+	if(m_lines){
+		Raster::lines.assign(m_size, 0);
+	}
+
+//	cout << "Raster size (init): " << Raster::z.size() << endl;  // for debugging purposes
+}
+
+
+// Function to open data file. Float32 data are memory-mapped if possible,
+// otherwise z is allocated and the rows are read by loadRows.
+bool Raster::openDAT(string fn, Header hdr, bool usemap){
 	// open the file
-	f.open(fn.append(".dat"), ios::binary | ios::in);
-	if(!f){
+	fn = hdr.dataFile(fn);
+	if(!Raster::datfile.open(fn, hdr)){
 		cerr << "ERROR: Cannot open " << fn << endl;
 		return false;
 	}
 
 	cout << "Reading data from " << fn << "..." << endl;
 
-	if(hdr.datatype == 4){
-		f.read(reinterpret_cast<char*> (Raster::z.data()), Raster::z.size()*sizeof(float));
+	Raster::valid.allocate(hdr.ncols, hdr.nlines);
 
-		for(s=0; s<hdr.nlines; s++){
-			for(t=0; t<hdr.ncols; t++){
-				idx = s*hdr.ncols + t;
+	// float32 elevations in this machine's byte order are read in place from the file
+	// if possible; otherwise they are copied (and other types converted) into memory
+	size_t offset = hdr.headeroffset + (size_t)hdr.band*hdr.npix*sizeof(float);
+	if(hdr.datatype == 4 && !hdr.swapBytes() && hdr.bandSequential() && !hdr.tiff() && usemap && Raster::z.map(fn, offset, hdr.npix)){
+		cout << "Memory-mapped " << fn << endl;
+		Raster::datfile.close();
+	} else{
+		Raster::z.allocate(hdr.npix);
+	}
+	Raster::z.adviseSequential();
 
-				Raster::x[idx] = hdr.ulx + t*hdr.xres;
-				Raster::y[idx] = hdr.uly - s*hdr.yres;
+	return true;
+}
 
-				if(Raster::x[idx] > hdr.xmax){
-					hdr.xmax = Raster::x[idx];
-				}
-				if(Raster::y[idx] < hdr.ymin){
-					hdr.ymin = Raster::y[idx];
-				}
+// Function to load rows r0 to r1-1 (rows must be loaded in order). Also
+// updates the extent and z range in hdr.
+bool Raster::loadRows(Header &hdr, int r0, int r1){
+	int t, s, idx;
+	bool ok = true;
+
+	// rows are read (and converted to float) about 1 MB at a time, and marked
+	// while they are still in cache
+	float *dst = Raster::z.writable();
+	bool reading = dst && Raster::datfile.is_open();
+	size_t rowBytes = (size_t)hdr.ncols*hdr.valueSize();
+	int step = (rowBytes < (1<<20)) ? (int)((1<<20)/rowBytes) : 1;
+
+	for(s=r0; s<r1; s+=step){
+		int e = (s+step < r1) ? s+step : r1;
+
+		if(reading && !Raster::datfile.read(s, e, dst+(size_t)s*hdr.ncols)){
+			ok = false;
+		}
+
+		// mark the pixels that hold data
+		for(t=s; t<e; t++){
+			rrKernels().validity(Raster::z.data()+(size_t)t*hdr.ncols, Raster::valid.row(t), hdr.ncols, hdr.nullFloor(), hdr.nodata);
+		}
+	}
+	if(reading && r1 == hdr.nlines){
+		// close the file
+		Raster::datfile.close();
+	}
+
+	// extent of the loaded rows (the corner pixels, see Header::xcoord/ycoord)
+	double xs[2] = {hdr.xcoord(0), hdr.xcoord(hdr.ncols-1)};
+	double ys[2] = {hdr.ycoord(r0), hdr.ycoord(r1-1)};
+	for(t=0; t<2; t++){
+		if(xs[t] > hdr.xmax){
+			hdr.xmax = xs[t];
+		}
+		if(ys[t] < hdr.ymin){
+			hdr.ymin = ys[t];
+		}
+	}
+
+	for(s=r0; s<r1; s++){
+		for(t=0; t<hdr.ncols; t++){
+			idx = s*hdr.ncols + t;
 
-				if(Raster::z[idx] > -9999){
-					if(hdr.zmin > Raster::z[idx] && Raster::z[idx] > -100){
-						hdr.zmin = Raster::z[idx];
-					} else if(Raster::z[idx] > hdr.zmax){
-						hdr.zmax = Raster::z[idx];
-					}
+			if(Raster::valid(s, t)){
+				if(hdr.zmin > Raster::z[idx]){
+					hdr.zmin = Raster::z[idx];
+				} else if(Raster::z[idx] > hdr.zmax){
+					hdr.zmax = Raster::z[idx];
 				}
 			}
 		}
-	} else cout << "Invalid data type." << endl;
+	}
+
+	return ok;
+}
 
+void Raster::printInfo(Header hdr){
 	// print info about the file to the screen
 	cout << "FILE INFORMATION:" << endl;
 	cout << "Upper Left (" << hdr.ulx << ", " << hdr.uly << ")" << endl;
@@ -541,99 +1557,229 @@ bool Raster::readDAT(string fn, Header hdr){
 	cout << "Resolution (X, Y): (" << hdr.xres << ", " << hdr.yres << ")" << endl;
 	cout << "Z min & max: " << hdr.zmin << " - " << hdr.zmax << endl;
 	cout << "Rows: " << hdr.nlines << ", Columns: " << hdr.ncols << ", Pixels: " << hdr.npix << "\n" << endl;
+}
 
-	// close the file
-	f.close();
+vector<EnviProduct> Raster::enviProducts(string filename, Params pm){
+	vector<EnviProduct> out;
+	EnviProduct p;
+	int k;
+
+	p.nbands = 1;
+	p.relief = false;
+	if(Raster::lineBits){
+		// every requested landform line as one bit of a single uint8 raster
+		p.name = filename+"_landforms";
+		p.data = reinterpret_cast<const char*>(Raster::lines.data());
+		p.bandnames = "landforms (1 shoreline; 2 dune toe; 4 dune crest; 8 dune heel; 16 backbarrier shoreline)";
+		out.push_back(p);
+		p.bandnames = "";
+	}
+	if(pm.oProduct.compare("rr")==0 || pm.oProduct.compare("all")==0){
+		p.relief = true;
+		if(pm.oBands.compare("single")==0){
+			// every kept scale plus the average as the bands of one ENVI raster
+			p.name = filename+"_rr";
+			p.data = reinterpret_cast<const char*>(Raster::rr.data());
+			p.nbands = Raster::rr.nbands();
+			for(k=0; k<Raster::rr.nscales(); ++k){
+				p.bandnames.append("rr"+to_string(pm.scales.window(k))+", ");
+			}
+			p.bandnames.append("rr_avg");
+			out.push_back(p);
+		} else{
+			for(k=0; k<Raster::rr.nscales(); ++k){
+				p.name = filename+"_rr"+to_string(pm.scales.window(k));
+				p.data = reinterpret_cast<const char*>(Raster::rr.scale(k));
+				out.push_back(p);
+			}
+			p.name = filename+"_rr_avg";
+			p.data = reinterpret_cast<const char*>(Raster::rr.average());
+			out.push_back(p);
+		}
+	}
+
+	return out;
+}
+
+bool Raster::mapRelief(string fn, size_t offset){
+	if(!Raster::rr.map(fn, offset, Raster::rr.nscales(), Raster::rr.bandSize())){
+		return false;
+	}
+	Raster::res = (Raster::rr.nscales() > 0) ? Raster::rr.scale(0) : NULL;
+	Raster::avg = Raster::rr.average();
 
 	return true;
 }
 
-void Raster::writeENVIs(string filename, Header hdr, Params pm){
-	if(pm.oProduct.compare("shoreline")==0 || pm.oProduct.compare("landforms")==0 || pm.oProduct.compare("all")==0){
-		///////////////
-		// SHORELINE //
-		///////////////
-		string tmpname = filename;
-		tmpname.append("_shoreline");
-
-		// write out shoreline ENVI raster
-		hdr.writeHDR(tmpname, Raster::shoreline);
-		hdr.writeDAT(tmpname, Raster::shoreline);
-	}
-	if(pm.oProduct.compare("dunetoe")==0 || pm.oProduct.compare("landforms")==0 || pm.oProduct.compare("all")==0){
-		//////////////
-		// DUNE TOE //
-		//////////////
-		string tmpname = filename;
-		tmpname.append("_dune_toe");
-
-		// write out dune toe ENVI raster
-		hdr.writeHDR(tmpname, Raster::dune_toe_line);
-		hdr.writeDAT(tmpname, Raster::dune_toe_line);
-	}
-	if(pm.oProduct.compare("dunecrest")==0 || pm.oProduct.compare("landforms")==0 || pm.oProduct.compare("all")==0){
-		////////////////
-		// DUNE RIDGE //
-		////////////////
-		string tmpname = filename;
-		tmpname.append("_dune_crest");
-
-		// write out dune crest ENVI raster
-		hdr.writeHDR(tmpname, Raster::dune_ridge_line);
-		hdr.writeDAT(tmpname, Raster::dune_ridge_line);
-	}
-	if(pm.oProduct.compare("duneheel")==0 || pm.oProduct.compare("landforms")==0 || pm.oProduct.compare("all")==0){
-		///////////////
-		// DUNE HEEL //
-		///////////////
-		string tmpname = filename;
-		tmpname.append("_dune_heel");
-
-		// write out dune heel ENVI raster
-		hdr.writeHDR(tmpname, Raster::dune_heel_line);
-		hdr.writeDAT(tmpname, Raster::dune_heel_line);
-	}
-	if(pm.oProduct.compare("backbarrier")==0 || pm.oProduct.compare("landforms")==0 || pm.oProduct.compare("all")==0){
-		///////////////////////////
-		// BACKBARRIER SHORELINE //
-		///////////////////////////
-		string tmpname = filename;
-		tmpname.append("_backbarrier_shoreline");
-
-		// write out back barrier shoreline ENVI raster
-		hdr.writeHDR(tmpname, Raster::backbarrier_line);
-		hdr.writeDAT(tmpname, Raster::backbarrier_line);
+void Raster::maskReliefEdges(int buf, Header hdr, int r0, int r1, const TileFrame *frame){
+	TileFrame f = {0, 0, hdr.nlines, hdr.ncols};
+	int i, j;
+
+	if(frame){
+		f = *frame;
 	}
-	if(pm.oProduct.compare("rr")==0 || pm.oProduct.compare("all")==0){
-		/////////////////////
-		// RELATIVE RELIEF //
-		/////////////////////
-		string tmpname = filename;
-		tmpname.append("_rr"+to_string(pm.iWindowSize));
+	for(i=r0; i<r1; ++i){
+		int mi = f.row0+i;
+		for(j=0; j<hdr.ncols; ++j){
+			int mj = f.col0+j;
+			// IF the center pixel is within the buffer distance to the image edge
+			if(mi<buf || mi>f.nlines-buf || mj<buf || mj>f.ncols-buf){
+				Raster::rr.setNull((size_t)i*hdr.ncols+j);
+			}
+		}
+	}
+}
+
+
+///////////////////////////////////////////////////////////////
+// RELATIVE RELIEF CACHE
+///////////////////////////////////////////////////////////////
+
+// an entry: this header, then the bands of Raster::rr (float32, this machine's
+// byte order) from byte RR_CACHE_HEADER on, so that the mapped bands are aligned
+static const char RR_CACHE_MAGIC[8] = {'R', 'R', 'C', 'A', 'C', 'H', 'E', '1'};
+static const size_t RR_CACHE_HEADER = 64;
+
+// 64-bit hash of n bytes at p, continuing from h (whole 8-byte words are mixed
+// in at a time, so long inputs hash at about memory speed)
+static uint64_t cacheHash(uint64_t h, const void *p, size_t n){
+	const unsigned char *b = static_cast<const unsigned char*>(p);
+	uint64_t w;
+
+	for(; n >= 8; n -= 8, b += 8){
+		memcpy(&w, b, 8);
+		h ^= w * 0x87C37B91114253D5ULL;
+		h = ((h << 31) | (h >> 33)) * 0x9E3779B97F4A7C15ULL + 0x52DCE729;
+	}
+	for(; n > 0; --n, ++b){
+		h = (h ^ *b) * 0x100000001B3ULL;
+	}
+	return h;
+}
 
-		// write out relative relief ENVI rasters
-		hdr.writeHDR(tmpname, Raster::res);
-		hdr.writeDAT(tmpname, Raster::res);
+template<class T>
+static uint64_t cacheHash(uint64_t h, T v){ return cacheHash(h, &v, sizeof(v)); }
 
-		tmpname = filename;
-		tmpname.append("_rr"+to_string(pm.iWindowSize+2));
+bool ReliefCache::open(string dir, string fn, const Header &hdr, const Params &pm, int nscales){
+	FILE *f = fopen(fn.c_str(), "rb");
+	vector<unsigned char> buf(1<<20);
+	uint64_t h = 0x5252434143484531ULL;
+	size_t n, k;
 
-		// write out relative relief ENVI rasters
-		hdr.writeHDR(tmpname, Raster::res_plus1);
-		hdr.writeDAT(tmpname, Raster::res_plus1);
+	if(!f){
+		cout << "ERROR: Cannot open " << fn << endl;
+		return false;
+	}
+	// the DEM file (every band: the band read is part of the key)
+	while((n = fread(buf.data(), 1, buf.size(), f)) > 0){
+		h = cacheHash(h, buf.data(), n);
+	}
+	bool failed = ferror(f) != 0;
+	fclose(f);
+	if(failed){
+		cout << "ERROR: Cannot read " << fn << endl;
+		return false;
+	}
 
-		tmpname = filename;
-		tmpname.append("_rr"+to_string(pm.iWindowSize+4));
+	// the header geometry, the values read and the NULL rule
+	h = cacheHash(h, hdr.ncols);
+	h = cacheHash(h, hdr.nlines);
+	h = cacheHash(h, hdr.bands);
+	h = cacheHash(h, hdr.band);
+	h = cacheHash(h, hdr.headeroffset);
+	h = cacheHash(h, hdr.datatype);
+	h = cacheHash(h, hdr.byteorder);
+	h = cacheHash(h, hdr.interleave.data(), hdr.interleave.size());
+	h = cacheHash(h, hdr.xres);
+	h = cacheHash(h, hdr.yres);
+	h = cacheHash(h, hdr.ulx);
+	h = cacheHash(h, hdr.uly);
+	h = cacheHash(h, hdr.nullFloor());
+	h = cacheHash(h, hdr.nodata);
+
+	// the scale set and the bands kept
+	for(k=0; k<pm.scales.windows.size(); ++k){
+		h = cacheHash(h, pm.scales.windows[k]);
+		h = cacheHash(h, pm.scales.weights[k]);
+	}
+	h = cacheHash(h, nscales);
+
+	// (final mix)
+	h ^= h >> 33;
+	h *= 0xFF51AFD7ED558CCDULL;
+	h ^= h >> 33;
+	h *= 0xC4CEB9FE1A85EC53ULL;
+	h ^= h >> 33;
+
+	key = h;
+	ncols = hdr.ncols;
+	nlines = hdr.nlines;
+	nbands = nscales+1;
+
+	char name[24];
+	snprintf(name, sizeof(name), "%016llx.rr", (unsigned long long)key);
+	if(!dir.empty() && dir[dir.size()-1] != '/' && dir[dir.size()-1] != '\\'){
+		dir += "/";
+	}
+	file = dir + name;
 
-		// write out relative relief ENVI rasters
-		hdr.writeHDR(tmpname, Raster::res_plus2);
-		hdr.writeDAT(tmpname, Raster::res_plus2);
+	return true;
+}
 
-		tmpname = filename;
-		tmpname.append("_rr_avg");
+bool ReliefCache::load(Raster &data){
+	char head[RR_CACHE_HEADER];
+	uint64_t k;
+	int32_t dims[3];
 
-		// write out average relative relief ENVI raster
-		hdr.writeHDR(tmpname, Raster::avg);
-		hdr.writeDAT(tmpname, Raster::avg);
+	FILE *f = fopen(file.c_str(), "rb");
+	if(!f){
+		return false;
+	}
+	bool ok = fread(head, 1, RR_CACHE_HEADER, f) == RR_CACHE_HEADER;
+	fclose(f);
+	if(!ok || memcmp(head, RR_CACHE_MAGIC, 8) != 0){
+		return false;
 	}
+	memcpy(&k, head+8, 8);
+	memcpy(dims, head+16, sizeof(dims));
+	if(k != key || dims[0] != ncols || dims[1] != nlines || dims[2] != nbands || data.rr.nbands() != nbands){
+		return false;
+	}
+	// (fails if the entry is shorter than its bands)
+	return data.mapRelief(file, RR_CACHE_HEADER);
+}
+
+bool ReliefCache::store(Raster &data){
+	char head[RR_CACHE_HEADER];
+	int32_t dims[3] = {ncols, nlines, nbands};
+	size_t n = (size_t)nbands*data.rr.bandSize();
+
+	memset(head, 0, RR_CACHE_HEADER);
+	memcpy(head, RR_CACHE_MAGIC, 8);
+	memcpy(head+8, &key, 8);
+	memcpy(head+16, dims, sizeof(dims));
+
+	// written under a name of its own and renamed, so that a run never maps a
+	// partly written entry (also when runs share the cache)
+	string dir = file.substr(0, file.find_last_of("/\\")+1);
+#ifdef _WIN32
+	CreateDirectoryA(dir.c_str(), NULL);
+#else
+	mkdir(dir.c_str(), 0777);
+#endif
+	string part = file + "." + to_string(chrono::steady_clock::now().time_since_epoch().count()) + ".part";
+	FILE *f = fopen(part.c_str(), "wb");
+	if(!f){
+		return false;
+	}
+	bool ok = fwrite(head, 1, RR_CACHE_HEADER, f) == RR_CACHE_HEADER && fwrite(data.rr.data(), sizeof(float), n, f) == n;
+	ok = (fclose(f) == 0) && ok;
+#ifdef _WIN32
+	remove(file.c_str());
+#endif
+	if(!ok || rename(part.c_str(), file.c_str()) != 0){
+		remove(part.c_str());
+		return false;
+	}
+	return true;
 }
@@ -1,8 +1,16 @@
 #include <math.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <condition_variable>
+#include <deque>
 #include <fstream>
 #include <iostream>
+#include <mutex>
+#include <thread>
 #include <windows.h>
 #include <vector>
+#include "arrow_ipc.hpp"
+#include "geotiff.hpp"
 
 using namespace std;
 
@@ -19,8 +27,10 @@ public:
 	int bands; 			// number of bands
 	int headeroffset;
 	string filetype;
-	int datatype;
-	string interleave;		// data interleave format (bsq, bip, or bil)
+	int datatype;			// ENVI data type (e.g. 2 = int16, 4 = float32, 5 = float64)
+	int byteorder;			// 0 = little-endian, 1 = big-endian
+	string interleave;		// data interleave format (bsq, bip, or bil; lower case)
+	int band;				// band read from the data file (0-based, set from iBand)
 	string sensortype;
 	string coordsys;		// coordinate system information
 	float xres;			// resolution (x direction)
@@ -36,18 +46,70 @@ public:
 	string datum;
 	string units;		// measurement units
 	string proj_string;	// projection string
+	string bandnames;	// band names written to float headers (e.g. "rr21, rr_avg"), optional
+	float nodata;		// value of NULL pixels ("data ignore value")
+	bool hasNodata;		// the header gives a data ignore value
+
+	// NULL pixels: z equal to the data ignore value, or (if the header gives
+	// none) z <= -100. A pixel holds data when z > nullFloor() and z != nodata.
+	float nullFloor() const { return hasNodata ? -INFINITY : -100; }
+
+	// bytes per value of the data type (0 if it is not a real numeric type)
+	int valueSize() const;
+
+	// the values must be byte-swapped to read them on this machine
+	bool swapBytes() const;
+
+	// the rows of the band are contiguous in the data file (bsq, or a single band)
+	bool bandSequential() const { return bands == 1 || interleave.compare("bsq") == 0; }
+
+	// the values are in a GeoTIFF (read by TiffReader) rather than an ENVI .dat
+	bool tiff() const { return filetype.compare("TIFF") == 0; }
+
+	// name of the data file of input fn (GeoTIFFs are named with their extension)
+	string dataFile(string fn) const { return tiff() ? fn : fn+".dat"; }
+
+	// map coordinates of column t / row s (computed in double precision: floats
+	// lose centimetres at UTM magnitudes)
+	double xcoord(int t) const { return ulx + t*(double)xres; }
+	double ycoord(int s) const { return uly - s*(double)yres; }
 
 	bool Initialize(string Fname)
 	{
-		Fname.append(".hdr");
+		bool geotiff = isTiffName(Fname);
+		if(!geotiff){
+			Fname.append(".hdr");
+		}
 
-		if(!LoadInParameters(Fname))
+		headeroffset = 0;
+		byteorder = 0;
+		bands = 1;
+		band = 0;
+		interleave = "bsq";
+		nodata = -9999;
+		hasNodata = false;
+
+		if(geotiff ? !LoadTIFF(Fname) : !LoadInParameters(Fname))
 		{
 			cout << "ERROR: Cannot find '" << Fname << endl;
 
 			return false;
 		}
 
+		if(valueSize() == 0)
+		{
+			cout << "ERROR: Unsupported data type " << datatype << " in '" << Fname << "' (complex types cannot be used)" << endl;
+
+			return false;
+		}
+
+		if(interleave.compare("bsq") != 0 && interleave.compare("bil") != 0 && interleave.compare("bip") != 0)
+		{
+			cout << "ERROR: Unsupported interleave '" << interleave << "' in '" << Fname << "'" << endl;
+
+			return false;
+		}
+
 		return true;
 	}
 
@@ -55,8 +117,13 @@ public:
 
 	bool LoadInParameters(string Fname);
 
+	// read the layout and georeferencing of a GeoTIFF (see geotiff.cpp)
+	bool LoadTIFF(string Fname);
+
 	//function to write binary data file
 	void writeDAT(string fn, vector<float> outdat);
+	void writeDAT(string fn, const float *outdat, size_t n);
+	void writeDAT(string fn, const unsigned char *outdat, size_t n);
 	void writeDAT(string fn, vector<unsigned int> outdat);
 	void writeDAT(string fn, vector<int> outdat);
 	void writeDAT(string fn, vector<long int> outdat);
@@ -70,6 +137,40 @@ public:
 	void writeHDR(string fn, vector<double> outinfo);
 };
 
+///////////////////////////////////////////////////////////////
+// RELATIVE RELIEF SCALES
+///////////////////////////////////////////////////////////////
+// Window sizes at which relative relief is computed (smallest first) and the
+// weight of each scale in the average relative relief.
+class ScaleSet
+{
+public:
+	vector<int> windows;		// window sizes (odd, strictly increasing)
+	vector<double> weights;		// weight of each scale in the average
+
+	int size() const { return windows.size(); }
+	int window(int k) const { return windows[k]; }
+	int radius(int k) const { return (windows[k]-1)/2; }
+	int maxRadius() const { return radius(size()-1); }
+
+	// sum of the weights (the divisor of the weighted average)
+	double weightSum() const;
+};
+
+///////////////////////////////////////////////////////////////
+// LANDFORM LINES
+///////////////////////////////////////////////////////////////
+// Bit of each landform in Raster::lines and in the uint8 "_landforms" raster.
+enum LandformBit
+{
+	SHORELINE_BIT = 1,
+	DUNE_TOE_BIT = 2,
+	DUNE_CREST_BIT = 4,
+	DUNE_HEEL_BIT = 8,
+	BACKBARRIER_BIT = 16
+};
+
+
 ///////////////////////////////////////////////////////////////
 // THRESHOLDS INFORMATION
 ///////////////////////////////////////////////////////////////
@@ -111,8 +212,79 @@ class Params
 	// transect direction
 	string transect_direction;
 
+	// optional: relative relief window sizes and their weights in the average.
+	// Defaults to 9 scales (iWindowSize, iWindowSize+2, ..., iWindowSize+16) of equal weight.
+	vector<int> iScales;
+	vector<double> iWeights;
+	ScaleSet scales;
+
+	// optional: band of a multi-band input file that holds the elevations (1-based) [default: 1]
+	int iBand;
+
+	// optional: number of relative relief scales (smallest first) kept and written out [default: 3]
+	int oScales;
+
+	// optional: "separate" writes one ENVI file per scale, "single" writes one
+	// multi-band ENVI file with every scale plus the average [default: separate]
+	string oBands;
+
+	// optional: format of the output rasters, "envi" or "gtiff" (tiled GeoTIFF) [default: envi]
+	string oRaster;
+
+	// optional: compression of GeoTIFF outputs, "lzw", "deflate" (builds with zlib) or "none" [default: lzw]
+	string oCompress;
+
+	// optional: format of the landform metrics, "csv", "arrow" (Apache Arrow IPC
+	// file with typed, nullable columns) or "both" [default: csv]
+	string oMetrics;
+
+	// number of threads used to compute relative relief (set with --threads N, 0 = all cores)
+	int nThreads;
+
+	// stream the DEM through a row buffer instead of loading it (set with --stream)
+	bool stream;
+
+	// memory-map float32 inputs instead of reading them (disable with --no-mmap)
+	bool mmapInput;
+
+	// compute relative relief only within reach of each transect's shoreline
+	// (set with --shore-band; landform products only)
+	bool shoreBand;
+
+	// incremental run: the DEM of the previous run, or a mask of the changed
+	// pixels (set with --update / --update-mask; empty for a full run)
+	string updateDEM;
+	string updateMask;
+
+	// only the pixels changed since the previous run are processed
+	bool incremental() const { return !updateDEM.empty() || !updateMask.empty(); }
+
+	// directory of the relative relief cache (set with --rr-cache; empty = no cache)
+	string rrCache;
+
+	// file of threshold sets evaluated over one relative relief (set with --sweep;
+	// empty = the thresholds above only)
+	string sweep;
+
 	bool Initialize()
 	{
+	nThreads = 0;
+	stream = false;
+	mmapInput = true;
+	shoreBand = false;
+	updateDEM.clear();
+	updateMask.clear();
+	rrCache.clear();
+	sweep.clear();
+	iBand = 1;
+	iScales.clear();
+	iWeights.clear();
+	oScales = 3;
+	oBands = "separate";
+	oRaster = "envi";
+	oCompress = "lzw";
+	oMetrics = "csv";
+
 	if(!LoadInParameters("params_rr.ini"))
 		{
 			cout << "ERROR: Cannot find 'params_rr.ini'" << endl;
@@ -129,9 +301,356 @@ class Params
 			exit(1);
 		}
 
-		return true;
+		return setScales();
 	}
 	bool LoadInParameters(const char* szFileName);
+
+	// build (and check) the scale set from iScales/iWeights or from iWindowSize
+	bool setScales();
+
+	// the relative relief rasters are written (oProduct rr or all)
+	bool reliefOutput() const { return oProduct.compare("rr")==0 || oProduct.compare("all")==0; }
+
+	// LandformBit of every landform line requested by oProduct (0 for rr)
+	unsigned char landformBits() const;
+
+	// the output rasters are GeoTIFFs
+	bool tiffOutput() const { return oRaster.compare("gtiff")==0; }
+
+	// base name of the output files (iFile without a .tif/.tiff extension)
+	string outName() const { return isTiffName(iFile) ? iFile.substr(0, iFile.find_last_of(".")) : iFile; }
+
+	// the landform metrics are written as CSV / as an Arrow file
+	bool csvMetrics() const { return oMetrics.compare("csv")==0 || oMetrics.compare("both")==0; }
+	bool arrowMetrics() const { return oMetrics.compare("arrow")==0 || oMetrics.compare("both")==0; }
+};
+
+
+///////////////////////////////////////////////////////////////
+// ELEVATION BUFFER
+///////////////////////////////////////////////////////////////
+// Read-only elevation values. The values are either read into memory or, for
+// float32 .dat files, memory-mapped straight from the file so that the RR
+// kernels read them in place without a copy.
+class ElevationBuffer
+{
+public:
+	ElevationBuffer();
+	~ElevationBuffer();
+
+	const float &operator[](size_t i) const { return ptr[i]; }
+	const float *data() const { return ptr; }
+	size_t size() const { return n; }
+	bool mapped() const { return base != NULL; }
+
+	// allocate a zero-filled in-memory buffer of m_n values and return it for filling
+	float *allocate(size_t m_n);
+
+	// the in-memory values for filling (NULL if the values are mapped)
+	float *writable(){ return base ? NULL : owned.data(); }
+
+	// map m_n floats starting at byte offset of file fn (as private copy-on-write
+	// pages if copyOnWrite, so the values can be changed without changing the
+	// file). Returns false (and maps nothing) if the file cannot be mapped.
+	bool map(string fn, size_t offset, size_t m_n, bool copyOnWrite = false);
+
+	// hint that the mapped values will be read sequentially (row by row), for
+	// aggressive read-ahead. No effect on in-memory buffers.
+	void adviseSequential();
+
+private:
+	const float *ptr;
+	size_t n;
+	vector<float> owned;	// in-memory values
+
+	void *base;				// start of the mapping (page aligned)
+	size_t len;				// length of the mapping
+#ifdef _WIN32
+	HANDLE hfile, hmap;
+#endif
+
+	void release();
+
+	// not copyable (owns a mapping)
+	ElevationBuffer(const ElevationBuffer &);
+	ElevationBuffer &operator=(const ElevationBuffer &);
+};
+
+
+///////////////////////////////////////////////////////////////
+// VALIDITY MASK
+///////////////////////////////////////////////////////////////
+// One bit per DEM pixel, set when the pixel holds data (see Header::nullFloor).
+// Every row starts on a new 64-bit word, so rows can be filled and read
+// independently: bit j%64 of row(i)[j/64] is pixel (i, j).
+class ValidityMask
+{
+public:
+	ValidityMask(){ stride = 0; }
+
+	void allocate(int ncols, int nlines){
+		stride = (ncols+63)/64;
+		bits.assign((size_t)stride*nlines, 0);
+	}
+
+	uint64_t *row(int i){ return &bits[(size_t)i*stride]; }
+	const uint64_t *row(int i) const { return &bits[(size_t)i*stride]; }
+
+	bool operator()(int i, int j) const { return (bits[(size_t)i*stride+(j>>6)] >> (j&63)) & 1; }
+
+private:
+	vector<uint64_t> bits;
+	int stride;				// words per row
+};
+
+
+///////////////////////////////////////////////////////////////
+// BAND READER
+///////////////////////////////////////////////////////////////
+// Reads rows of band hdr.band of an ENVI .dat file as floats, whatever its
+// interleave, data type and byte order. Only the bytes of the band are read
+// from bsq files (one read per block of rows) and bil files (one read per row);
+// bip rows hold every band pixel by pixel, so they are read whole and the
+// band's values gathered from them. GeoTIFF inputs are read by a TiffReader.
+class BandReader
+{
+public:
+	bool open(string fn, const Header &hdr);
+	bool is_open() const { return tiff ? tif.is_open() : f.is_open(); }
+	void close(){ f.close(); tif.close(); }
+
+	// read rows r0 to r1-1 into dst. Returns false if the file is too short.
+	bool read(int r0, int r1, float *dst);
+
+	// read columns c0 to c1-1 of rows r0 to r1-1 into dst (c1-c0 values per row).
+	// Only the bytes of the window are read from bsq and bil files.
+	bool readWindow(int r0, int r1, int c0, int c1, float *dst);
+
+private:
+	ifstream f;
+	bool tiff;
+	TiffReader tif;
+	streamoff offset;			// header offset
+	int ncols, nlines, bands, band;
+	int datatype, size;			// ENVI data type and bytes per value
+	bool swap;
+	string interleave;
+	vector<char> raw, packed;	// rows as read, and the band's values (bip)
+	vector<float> rows;			// whole rows of a window (bip, GeoTIFF)
+
+	// convert the n values at src (in file order) into dst
+	void convert(const char *src, float *dst, size_t n);
+};
+
+
+///////////////////////////////////////////////////////////////
+// RELATIVE RELIEF BANDS
+///////////////////////////////////////////////////////////////
+// Relative relief results in one contiguous, band-sequential buffer: one band
+// per kept scale (smallest first) followed by the average. The buffer starts on
+// a 64-byte boundary and is laid out exactly like a BSQ .dat file.
+class ReliefBands
+{
+public:
+	ReliefBands();
+
+	// allocate m_nscales scale bands plus the average band of m_npix values each
+	void allocate(int m_nscales, size_t m_npix);
+
+	// map the m_nscales+1 bands from byte offset of file fn instead (copy-on-write).
+	// Returns false (and keeps the allocated bands) if the file cannot be mapped.
+	bool map(string fn, size_t offset, int m_nscales, size_t m_npix);
+	bool mapped() const { return cached.mapped(); }
+
+	int nscales() const { return nscale; }
+	int nbands() const { return nscale+1; }
+	size_t bandSize() const { return npix; }
+
+	float *data(){ return base; }
+	float *scale(int k){ return base+(size_t)k*npix; }
+	float *average(){ return base+(size_t)nscale*npix; }
+
+	// set pixel i of every band to NULL (-9999)
+	void setNull(size_t i);
+
+private:
+	vector<float> store;
+	ElevationBuffer cached;	// mapped bands (relative relief cache)
+	float *base;			// first value of band 0 (aligned within store, or mapped)
+	int nscale;
+	size_t npix;
+
+	// not copyable (base points into store)
+	ReliefBands(const ReliefBands &);
+	ReliefBands &operator=(const ReliefBands &);
+};
+
+
+///////////////////////////////////////////////////////////////
+// ENVI OUTPUT PRODUCTS
+///////////////////////////////////////////////////////////////
+// An ENVI raster of the outputs (see Raster::enviProducts): nbands
+// band-sequential bands of npix values starting at data, either float32
+// (relative relief) or uint8 (landform lines).
+class EnviProduct
+{
+public:
+	string name;			// output file name (without extension)
+	const char *data;		// first byte of band 0
+	int nbands;
+	string bandnames;		// ENVI band names
+	bool relief;			// float32 relative relief bands (as opposed to uint8 landform lines)
+
+	// bytes per value
+	size_t valueSize() const { return relief ? sizeof(float) : 1; }
+};
+
+
+///////////////////////////////////////////////////////////////
+// ASYNCHRONOUS OUTPUT
+///////////////////////////////////////////////////////////////
+// Writes byte ranges of output files on background I/O threads, so the
+// caller hands over finished rows and goes on computing instead of waiting
+// for the disk. Ranges are written with positional writes (pwrite, or
+// WriteFile at an offset on Windows): any thread can write any range of any
+// file, so several files, and the parts of one large range, are written at the
+// same time. Consecutive ranges of a file are merged into writes of up to
+// ASYNC_CHUNK bytes, aligned to ASYNC_CHUNK in the file. The memory handed to
+// write() is not copied and must stay unchanged until finish() returns.
+class AsyncWriter
+{
+public:
+	AsyncWriter();
+	~AsyncWriter();
+
+	// create (or truncate) the files and start nthreads I/O threads. Returns false
+	// if a file cannot be created.
+	bool open(const vector<string> &names, int nthreads);
+
+	// queue len bytes at src to be written at byte offset of file k
+	void write(int k, uint64_t offset, const char *src, size_t len);
+
+	// wait until every queued range is written and close the files. Returns
+	// false if a write failed.
+	bool finish();
+
+private:
+	struct Job
+	{
+		int file;
+		uint64_t offset;
+		const char *src;
+		size_t len;
+	};
+
+#ifdef _WIN32
+	vector<HANDLE> files;
+#else
+	vector<int> files;
+#endif
+	deque<Job> jobs;
+	mutex lock;
+	condition_variable queued;
+	bool stopping;				// finish() was called: exit once the queue is empty
+	bool failed;
+	vector<thread> workers;
+
+	void run();
+	bool writeJob(const Job &j);
+	void closeFiles();
+
+	// not copyable (owns threads and files)
+	AsyncWriter(const AsyncWriter &);
+	AsyncWriter &operator=(const AsyncWriter &);
+};
+
+
+///////////////////////////////////////////////////////////////
+// LANDFORM METRICS
+///////////////////////////////////////////////////////////////
+// Writes the _ISLAND_METRICS.csv lines into a large buffer that is flushed
+// to the file in big blocks. Values are formatted with to_chars, which does
+// not depend on the locale and gives the shortest decimal that reads back as
+// the same float (or double): e.g. 0.2f is written as 0.2, not 0.200000.
+//
+// The same rows can also be kept as columns and written as an Arrow file on
+// close(), where the -99999 fill value and the landforms that were not found
+// are nulls. In batch mode each tile keeps its metrics in memory, and the
+// tiles are appended to one merged writer with a leading "tile" column.
+class MetricsWriter
+{
+public:
+	MetricsWriter();
+	~MetricsWriter();
+
+	// csv and/or arrow file names (an empty name is not written)
+	bool open(string csvName, string arrowName);
+	// keep the csv text and/or the columns in memory (for append)
+	void openMemory(bool m_csv, bool m_arrow);
+	bool is_open() const { return csv || arrow; }
+
+	// add a float64 (or float32) column / a string column / the float64 X and
+	// float32 Z columns of a landform (null where X is 0), then write the header
+	// line with the names
+	void column(string name, bool single = false);
+	void textColumn(string name);
+	void landformColumns(string name);
+	void header();
+
+	// add the rows of tile (kept in memory, with the columns of this writer
+	// after the first) with name in the first column
+	void append(const MetricsWriter &tile, string name);
+	size_t rows() const { return nrows; }
+
+	// values, each separated from the previous value of the line by ", "
+	void fields(){}
+	template<class T, class... More>
+	void fields(T v, More... more){ value(v); fields(more...); }
+
+	// values ending the line
+	template<class... T>
+	void line(T... v){ fields(v...); endLine(); }
+
+	void endLine();
+
+	// a line (without its line end) of a CSV written earlier with the same columns
+	void copyLine(const string &s);
+
+	// flush the buffer and close the file(s). Returns false if a write failed.
+	bool close();
+
+private:
+	FILE *file;
+	vector<char> buf;
+	size_t used;
+	bool first;				// no value written on the current line yet
+	bool failed;
+	bool csv, arrow;		// the csv text / the columns are kept
+	bool memory;			// ... in memory rather than written to files
+	size_t nrows;			// lines written after the header
+
+	string arrowName;
+	vector<ArrowColumn> cols;
+	vector<unsigned char> landformX;	// column holds a landform X coordinate
+	size_t col;				// column of the next value
+
+	void text(const char *s);
+	void value(double v);
+	void value(float v);
+	void keep(double v);
+	void reserve(size_t n);
+};
+
+
+///////////////////////////////////////////////////////////////
+// MOSAIC TILES
+///////////////////////////////////////////////////////////////
+// Place of a tile in a mosaic of tiles on one grid: the tile's first row and
+// column in the mosaic, and the size of the mosaic (the bounding box of its tiles).
+struct TileFrame
+{
+	int row0, col0;
+	int nlines, ncols;
 };
 
 
@@ -144,34 +663,79 @@ public:
 	//integer corresponding to the number of pixels
 	int size;
 
-	//DEM information
-	vector<float> x;			// x coordinate
-	vector<float> y;			// y coordinate
-	vector<float> z;			// z coordinate
+	//DEM information (the x/y coordinates come from Header::xcoord/ycoord)
+	ElevationBuffer z;			// z coordinate (read-only)
+	ValidityMask valid;			// pixels of z that hold data (filled by loadRows)
+
+	//relative relief variables (per pixel) at the kept scales plus the average
+	ReliefBands rr;
+	float *res;					// smallest scale (band 0 of rr, NULL if no scale is kept)
+	float *avg;					// average of all scales (last band of rr)
+
+	//feature positions: one LandformBit per landform found at the pixel (allocated
+	//only when landforms are extracted). Only the bits in lineBits are kept.
+	vector<unsigned char> lines;
+	unsigned char lineBits;
+
+	// record landform bit at pixel i
+	void mark(size_t i, unsigned char bit){ Raster::lines[i] |= bit & Raster::lineBits; }
+
+	//input data file (open while rows are loaded with loadRows)
+	BandReader datfile;
 
-	//binary indicating whether the location has data for all data types
-	vector<unsigned int> complete;
+	void Init(int m_size, int m_nscales, unsigned char m_lines);
 
-	//relative relief variables (per pixel)
-	vector<float> res;
-	vector<float> res_plus1;
-	vector<float> res_plus2;
-	vector<float> avg;
+	// use the relative relief bands stored from byte offset of file fn (a cache
+	// entry) instead of the allocated ones. Returns false if fn cannot be mapped.
+	bool mapRelief(string fn, size_t offset);
 
-	//binary indicators of feature position
-	vector<float> shoreline;
-	vector<float> dune_toe_line;
-	vector<float> dune_ridge_line;
-	vector<float> dune_heel_line;
-	vector<float> backbarrier_line;
+	// open (or map) the data file, load rows r0 to r1-1 as they are needed
+	// (false if they cannot be read), then print the file statistics gathered
+	// in hdr
+	bool openDAT(string Fname, Header hdr, bool usemap);
+	bool loadRows(Header &hdr, int r0, int r1);
+	void printInfo(Header hdr);
+
+	// ENVI rasters requested by pm, in the order they are written
+	vector<EnviProduct> enviProducts(string filename, Params pm);
+
+	// set the relative relief of rows r0 to r1-1 that lie within buf pixels of the raster edge to NULL
+	// (with a frame, only the pixels within buf of the mosaic edge)
+	void maskReliefEdges(int buf, Header hdr, int r0, int r1, const TileFrame *frame = NULL);
+};
+
+
+///////////////////////////////////////////////////////////////
+// RELATIVE RELIEF CACHE
+///////////////////////////////////////////////////////////////
+// Entries of the on-disk cache of relative relief bands (--rr-cache DIR). An
+// entry holds the bands of Raster::rr, final and edge masked, and is named
+// after a hash of everything they depend on: the bytes of the DEM file, the
+// header geometry and band, the scales and weights, and the number of kept
+// scales. A later run with the same key maps the entry instead of computing
+// the relative relief, so a run that only changes landform thresholds goes
+// straight to the transects.
+class ReliefCache
+{
+public:
+	ReliefCache(){ key = 0; }
 
-	void Initialize(Params prms, Header hdr);
+	// hash the DEM file fn of hdr with the scales of pm and nscales kept scales
+	// into the entry name in dir. Returns false if the DEM cannot be read.
+	bool open(string dir, string fn, const Header &hdr, const Params &pm, int nscales);
 
-	void Init(int m_size);
+	string path() const { return file; }
 
-	bool readDAT(string Fname, Header hdr);
+	// map the entry as the relative relief of data. Returns false if there is no
+	// entry (or it does not match).
+	bool load(Raster &data);
 
-	void writeENVIs(string filename, Header hdr, Params pm);
+	// write the relative relief of data as the entry. Returns false if it cannot
+	// be written.
+	bool store(Raster &data);
 
-	void computeRelativeRelief(int i, int j, int buf, Header hdr);
+private:
+	string file;
+	uint64_t key;
+	int ncols, nlines, nbands;
 };
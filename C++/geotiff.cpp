@@ -0,0 +1,1101 @@
+#include "data_structures.hpp"
+#include "rr_kernels.hpp"
+#include <stdlib.h>
+#include <string.h>
+#include <atomic>
+#include <map>
+#include <sstream>
+#include <thread>
+
+#ifdef RR_ZLIB
+#include <zlib.h>
+#endif
+
+using namespace std;
+
+// side of the tiles written by TiffWriter
+static const int TIFF_TILE = 256;
+
+// files whose values may not fit in 4 GB (with the directory) are written as BigTIFF
+static const uint64_t TIFF_CLASSIC_LIMIT = 0xF0000000ull;
+
+static bool hostLittle(){
+	const uint16_t one = 1;
+	return *reinterpret_cast<const unsigned char*>(&one) == 1;
+}
+
+int tiffCompression(string name){
+	if(name.compare("none") == 0){
+		return TIFF_NONE;
+	} else if(name.compare("lzw") == 0){
+		return TIFF_LZW;
+	}
+#ifdef RR_ZLIB
+	else if(name.compare("deflate") == 0){
+		return TIFF_DEFLATE;
+	}
+#endif
+	return -1;
+}
+
+bool isTiffName(string fn){
+	size_t dot = fn.find_last_of(".");
+	if(dot == string::npos){
+		return false;
+	}
+	string ext = fn.substr(dot+1);
+	for(size_t i=0; i<ext.length(); ++i){
+		ext[i] = (char)tolower((unsigned char)ext[i]);
+	}
+	return ext.compare("tif") == 0 || ext.compare("tiff") == 0;
+}
+
+// reverse the bytes of each of the n values of `size` bytes at p
+static void swapValues(unsigned char *p, size_t n, int size){
+	size_t i;
+	int k;
+
+	for(i=0; i<n; ++i, p+=size){
+		for(k=0; k<size/2; ++k){
+			unsigned char t = p[k];
+			p[k] = p[size-1-k];
+			p[size-1-k] = t;
+		}
+	}
+}
+
+
+
+///////////////////////////////////////////////////////////////
+// TIFF DIRECTORY
+///////////////////////////////////////////////////////////////
+
+// one field of a TIFF directory: its values as integers (integer types), as
+// reals (every numeric type) or as text (ASCII)
+struct TiffTag
+{
+	int type;
+	vector<uint64_t> ints;
+	vector<double> reals;
+	string text;
+};
+
+// bytes per value of a TIFF field type (0 if unknown)
+static int tiffTypeSize(int type){
+	switch(type){
+		case 1: case 2: case 6: case 7: return 1;					// BYTE, ASCII, SBYTE, UNDEFINED
+		case 3: case 8: return 2;									// SHORT, SSHORT
+		case 4: case 9: case 11: case 13: return 4;					// LONG, SLONG, FLOAT, IFD
+		case 5: case 10: case 12: case 16: case 17: case 18: return 8;	// RATIONAL, SRATIONAL, DOUBLE, LONG8, SLONG8, IFD8
+	}
+	return 0;
+}
+
+// unsigned integer of `size` bytes at p in the file's byte order
+static uint64_t tiffUInt(const unsigned char *p, int size, bool little){
+	uint64_t v = 0;
+	int k;
+
+	for(k=0; k<size; ++k){
+		v |= (uint64_t)p[little ? k : size-1-k] << (8*k);
+	}
+	return v;
+}
+
+// read the first directory of a TIFF (or BigTIFF) file
+static bool readDirectory(ifstream &f, map<int, TiffTag> &tags, bool &little, bool &big){
+	unsigned char h[16];
+	uint64_t ifd, n, i, k;
+
+	memset(h, 0, sizeof(h));
+	f.seekg(0);
+	f.read(reinterpret_cast<char*>(h), sizeof(h));
+	f.clear();
+	if(h[0] == 'I' && h[1] == 'I'){
+		little = true;
+	} else if(h[0] == 'M' && h[1] == 'M'){
+		little = false;
+	} else{
+		return false;
+	}
+
+	int magic = (int)tiffUInt(h+2, 2, little);
+	if(magic == 42){
+		big = false;
+		ifd = tiffUInt(h+4, 4, little);
+	} else if(magic == 43){
+		big = true;
+		ifd = tiffUInt(h+8, 8, little);
+	} else{
+		return false;
+	}
+
+	// entries: tag, type, count and the value (or the offset of the values)
+	int countSize = big ? 8 : 2;
+	int fieldSize = big ? 8 : 4;
+	int entrySize = big ? 20 : 12;
+	unsigned char cnt[8];
+	f.seekg(ifd);
+	f.read(reinterpret_cast<char*>(cnt), countSize);
+	n = tiffUInt(cnt, countSize, little);
+	vector<unsigned char> entries(n*entrySize);
+	f.read(reinterpret_cast<char*>(entries.data()), entries.size());
+	if(!f){
+		return false;
+	}
+
+	for(i=0; i<n; ++i){
+		const unsigned char *e = &entries[i*entrySize];
+		TiffTag t;
+		int tag = (int)tiffUInt(e, 2, little);
+		t.type = (int)tiffUInt(e+2, 2, little);
+		uint64_t count = tiffUInt(e+4, big ? 8 : 4, little);
+		const unsigned char *field = e + (big ? 12 : 8);
+		int size = tiffTypeSize(t.type);
+		if(size == 0){
+			continue;
+		}
+
+		vector<unsigned char> values(count*size);
+		if(values.size() <= (size_t)fieldSize){
+			memcpy(values.data(), field, values.size());
+		} else{
+			f.seekg(tiffUInt(field, fieldSize, little));
+			f.read(reinterpret_cast<char*>(values.data()), values.size());
+			if(!f){
+				return false;
+			}
+		}
+
+		if(t.type == 2){
+			t.text.assign(values.begin(), values.end());
+			t.text = t.text.substr(0, t.text.find('\0'));
+		}
+		for(k=0; k<count; ++k){
+			const unsigned char *p = &values[k*size];
+			double real;
+			if(t.type == 5 || t.type == 10){
+				// rational: numerator/denominator
+				uint64_t num = tiffUInt(p, 4, little), den = tiffUInt(p+4, 4, little);
+				real = (t.type == 5) ? (double)num/den : (double)(int32_t)num/(int32_t)den;
+			} else if(t.type == 11){
+				uint32_t bits = (uint32_t)tiffUInt(p, 4, little);
+				float v;
+				memcpy(&v, &bits, 4);
+				real = v;
+			} else if(t.type == 12){
+				uint64_t bits = tiffUInt(p, 8, little);
+				memcpy(&real, &bits, 8);
+			} else{
+				uint64_t v = tiffUInt(p, size, little);
+				t.ints.push_back(v);
+				real = (t.type == 8) ? (int16_t)v : (t.type == 9) ? (int32_t)v : (t.type == 17) ? (double)(int64_t)v : (double)v;
+			}
+			t.reals.push_back(real);
+		}
+		tags[tag] = t;
+	}
+
+	return true;
+}
+
+// first integer value of a tag, def if the tag is missing
+static uint64_t tagValue(const map<int, TiffTag> &tags, int tag, uint64_t def){
+	map<int, TiffTag>::const_iterator it = tags.find(tag);
+	if(it == tags.end() || it->second.ints.empty()){
+		return def;
+	}
+	return it->second.ints[0];
+}
+
+// value of a GeoTIFF key stored in the key directory itself (0 if missing)
+static int geoKey(const map<int, TiffTag> &tags, int key){
+	map<int, TiffTag>::const_iterator it = tags.find(34735);
+	size_t k;
+
+	if(it == tags.end() || it->second.ints.size() < 4){
+		return 0;
+	}
+	const vector<uint64_t> &v = it->second.ints;
+	for(k=4; k+3<v.size(); k+=4){
+		if((int)v[k] == key && v[k+1] == 0){
+			return (int)v[k+3];
+		}
+	}
+	return 0;
+}
+
+// ENVI data type of TIFF samples (0 if ENVI has none)
+static int enviDataType(int bits, int format){
+	if(format == 1){		// unsigned integer
+		if(bits == 8) return 1;
+		if(bits == 16) return 12;
+		if(bits == 32) return 13;
+		if(bits == 64) return 15;
+	} else if(format == 2){	// signed integer
+		if(bits == 16) return 2;
+		if(bits == 32) return 3;
+		if(bits == 64) return 14;
+	} else if(format == 3){	// IEEE float
+		if(bits == 32) return 4;
+		if(bits == 64) return 5;
+	}
+	return 0;
+}
+
+// the compressions this build can decode
+static bool tiffDecodable(int compression){
+	if(compression == TIFF_NONE || compression == TIFF_LZW){
+		return true;
+	}
+#ifdef RR_ZLIB
+	if(compression == TIFF_DEFLATE || compression == TIFF_DEFLATE_OLD){
+		return true;
+	}
+#endif
+	return false;
+}
+
+bool Header::LoadTIFF(string Fname){
+	map<int, TiffTag> tags;
+	bool little, big;
+
+	ifstream infile(Fname.c_str(), ios::binary | ios::in);
+	if(!infile){
+		cerr << "ERROR: Cannot open " << Fname << endl;
+		return false;
+	}
+
+	cout << "Reading header information from " << Fname.c_str() << "..." << endl;
+
+	if(!readDirectory(infile, tags, little, big)){
+		cout << "ERROR: '" << Fname << "' is not a TIFF file" << endl;
+		return false;
+	}
+
+	Header::description = Fname;
+	Header::filetype = "TIFF";
+	Header::ncols = (int)tagValue(tags, 256, 0);
+	Header::nlines = (int)tagValue(tags, 257, 0);
+	Header::bands = (int)tagValue(tags, 277, 1);
+	Header::interleave = (tagValue(tags, 284, 1) == 2) ? "bsq" : "bip";
+	Header::byteorder = little ? 0 : 1;
+	Header::datatype = enviDataType((int)tagValue(tags, 258, 1), (int)tagValue(tags, 339, 1));
+
+	int compression = (int)tagValue(tags, 259, TIFF_NONE);
+	if(!tiffDecodable(compression)){
+		cout << "ERROR: Unsupported TIFF compression " << compression << " in '" << Fname << "'";
+#ifndef RR_ZLIB
+		if(compression == TIFF_DEFLATE || compression == TIFF_DEFLATE_OLD){
+			cout << " (DEFLATE needs a build with -DRR_ZLIB -lz)";
+		}
+#endif
+		cout << endl;
+		return false;
+	}
+
+	// georeferencing: pixel size and the map coordinates of a tie point
+	map<int, TiffTag>::const_iterator scale = tags.find(33550), tie = tags.find(33922);
+	if(scale != tags.end() && tie != tags.end() && scale->second.reals.size() >= 2 && tie->second.reals.size() >= 6){
+		const vector<double> &s = scale->second.reals, &t = tie->second.reals;
+		Header::xres = s[0];
+		Header::yres = s[1];
+		Header::ulx = t[3] - t[0]*s[0];
+		Header::uly = t[4] + t[1]*s[1];
+		if(geoKey(tags, 1025) == 2){
+			// PixelIsPoint: the tie point is the centre of the pixel
+			Header::ulx -= 0.5*s[0];
+			Header::uly += 0.5*s[1];
+		}
+	} else{
+		cout << "WARNING: '" << Fname << "' is not georeferenced; using pixel coordinates" << endl;
+		Header::xres = 1;
+		Header::yres = 1;
+		Header::ulx = 0;
+		Header::uly = 0;
+	}
+
+	// coordinate system (WGS-84 / NAD83 UTM zones and WGS-84 lat/lon are recognised)
+	int epsg = geoKey(tags, 3072);
+	Header::coordsys = "Arbitrary";
+	Header::units = "Meters";
+	if((epsg > 32600 && epsg <= 32660) || (epsg > 32700 && epsg <= 32760)){
+		Header::coordsys = "UTM";
+		Header::utm_zone_number = to_string(epsg%100);
+		Header::utm_zone_band = (epsg < 32700) ? "North" : "South";
+		Header::datum = "WGS-84";
+	} else if(epsg > 26900 && epsg <= 26923){
+		Header::coordsys = "UTM";
+		Header::utm_zone_number = to_string(epsg%100);
+		Header::utm_zone_band = "North";
+		Header::datum = "North America 1983";
+	} else if(geoKey(tags, 2048) == 4326){
+		Header::coordsys = "Geographic Lat/Lon";
+		Header::datum = "WGS-84";
+		Header::units = "Degrees";
+	}
+
+	// value of NULL pixels (GDAL_NODATA)
+	map<int, TiffTag>::const_iterator nd = tags.find(42113);
+	if(nd != tags.end() && !nd->second.text.empty()){
+		Header::nodata = atof(nd->second.text.c_str());
+		Header::hasNodata = true;
+	}
+
+	// compute total number of pixels
+	Header::npix = Header::ncols * Header::nlines;
+	Header::xmax = -99999;
+	Header::ymin = 9999999999;
+
+	return true;
+}
+
+
+
+///////////////////////////////////////////////////////////////
+// LZW (TIFF VARIANT)
+///////////////////////////////////////////////////////////////
+// Codes of 9 to 12 bits, most significant bit first. The code width grows one
+// code early ("early change"), as in every TIFF writer.
+static const int LZW_CLEAR = 256;
+static const int LZW_EOI = 257;
+static const int LZW_FIRST = 258;
+static const int LZW_FULL = 4094;		// the table is reset once this many codes exist
+
+// appends codes to a byte vector
+class LzwBits
+{
+public:
+	LzwBits(vector<unsigned char> &m_out) : out(m_out) { acc = 0; nacc = 0; }
+
+	void put(int code, int nbits){
+		acc = (acc << nbits) | (uint32_t)code;
+		nacc += nbits;
+		while(nacc >= 8){
+			nacc -= 8;
+			out.push_back((unsigned char)(acc >> nacc));
+		}
+		acc &= (1u << nacc) - 1;
+	}
+
+	void flush(){
+		if(nacc > 0){
+			out.push_back((unsigned char)(acc << (8-nacc)));
+		}
+		nacc = 0;
+		acc = 0;
+	}
+
+private:
+	vector<unsigned char> &out;
+	uint32_t acc;
+	int nacc;
+};
+
+static void lzwEncode(const unsigned char *src, size_t n, vector<unsigned char> &out){
+	// open-addressing table of (prefix code, byte) -> code
+	const size_t HSIZE = 9001;
+	vector<int32_t> keys(HSIZE, -1);
+	vector<uint16_t> codes(HSIZE);
+	LzwBits bits(out);
+	int nbits = 9, next = LZW_FIRST;
+	size_t i;
+
+	out.clear();
+	out.reserve(n/2);
+	bits.put(LZW_CLEAR, nbits);
+	if(n == 0){
+		bits.put(LZW_EOI, nbits);
+		bits.flush();
+		return;
+	}
+
+	int w = src[0];
+	for(i=1; i<n; ++i){
+		int32_t key = (w << 8) | src[i];
+		size_t h = (size_t)((uint32_t)key*2654435761u) % HSIZE;
+		while(keys[h] != -1 && keys[h] != key){
+			h = (h+1 == HSIZE) ? 0 : h+1;
+		}
+		if(keys[h] == key){
+			w = codes[h];
+			continue;
+		}
+
+		bits.put(w, nbits);
+		keys[h] = key;
+		codes[h] = (uint16_t)next++;
+		if(next == LZW_FULL){
+			bits.put(LZW_CLEAR, nbits);
+			fill(keys.begin(), keys.end(), -1);
+			next = LZW_FIRST;
+			nbits = 9;
+		} else if(next > (1 << nbits) - 1){
+			nbits++;
+		}
+		w = src[i];
+	}
+
+	// the last string also counts as a table entry for the width of EOI
+	bits.put(w, nbits);
+	if(++next == LZW_FULL){
+		bits.put(LZW_CLEAR, nbits);
+		nbits = 9;
+	} else if(next > (1 << nbits) - 1){
+		nbits++;
+	}
+	bits.put(LZW_EOI, nbits);
+	bits.flush();
+}
+
+// decode exactly `size` bytes into dst. Returns false on a corrupt stream.
+static bool lzwDecode(const unsigned char *src, size_t n, unsigned char *dst, size_t size){
+	vector<uint16_t> prefix(4096), length(4096);
+	vector<unsigned char> suffix(4096), first(4096);
+	unsigned char str[4096];
+	size_t out = 0, bitpos = 0, nbits_total = n*8;
+	int nbits = 9, next = LZW_FIRST, old = -1;
+	int c;
+
+	for(c=0; c<256; ++c){
+		suffix[c] = first[c] = (unsigned char)c;
+		length[c] = 1;
+	}
+
+	while(out < size){
+		// next code (running out of input ends the stream)
+		if(bitpos + nbits > nbits_total){
+			break;
+		}
+		int code = 0;
+		for(c=0; c<nbits; ++c, ++bitpos){
+			code = (code << 1) | ((src[bitpos >> 3] >> (7 - (bitpos & 7))) & 1);
+		}
+
+		if(code == LZW_EOI){
+			break;
+		}
+		if(code == LZW_CLEAR){
+			nbits = 9;
+			next = LZW_FIRST;
+			old = -1;
+			continue;
+		}
+
+		// the string of the code (code == next: the previous string plus its first byte)
+		int len;
+		if(code < next && (code < 256 || old >= 0 || code < LZW_FIRST)){
+			if(code >= 256 && code < LZW_FIRST){
+				return false;
+			}
+			len = length[code];
+			int k = code;
+			for(c=len-1; c>=0; --c){
+				str[c] = suffix[k];
+				k = prefix[k];
+			}
+		} else if(code == next && old >= 0){
+			len = length[old]+1;
+			int k = old;
+			for(c=len-2; c>=0; --c){
+				str[c] = suffix[k];
+				k = prefix[k];
+			}
+			str[len-1] = first[old];
+		} else{
+			return false;
+		}
+
+		size_t m = (out+len <= size) ? (size_t)len : size-out;
+		memcpy(dst+out, str, m);
+		out += m;
+
+		// add the previous string plus the first byte of this one
+		if(old >= 0 && next < 4096){
+			prefix[next] = (uint16_t)old;
+			suffix[next] = str[0];
+			first[next] = first[old];
+			length[next] = length[old]+1;
+			next++;
+			if(next > (1 << nbits) - 2 && nbits < 12){
+				nbits++;
+			}
+		}
+		old = code;
+	}
+
+	return out == size;
+}
+
+
+
+///////////////////////////////////////////////////////////////
+// PREDICTORS
+///////////////////////////////////////////////////////////////
+
+// predictor 2: undo the horizontal differencing of n samples (native order),
+// stride samples per pixel
+template <class T>
+static void accumulate(unsigned char *row, size_t n, int stride){
+	T *p = reinterpret_cast<T*>(row);
+	size_t i;
+
+	for(i=stride; i<n; ++i){
+		p[i] = (T)(p[i] + p[i-stride]);
+	}
+}
+
+static void undoHorizontal(unsigned char *row, size_t n, int size, int stride){
+	switch(size){
+		case 1: accumulate<uint8_t>(row, n, stride); break;
+		case 2: accumulate<uint16_t>(row, n, stride); break;
+		case 4: accumulate<uint32_t>(row, n, stride); break;
+		case 8: accumulate<uint64_t>(row, n, stride); break;
+	}
+}
+
+// predictor 3: the bytes of the n samples of a row are stored as planes (most
+// significant byte first) and differenced byte by byte. The planes do not depend
+// on the file's byte order, so the samples come out in this machine's order.
+static void undoFloatPredictor(unsigned char *row, size_t n, int size, int stride, vector<unsigned char> &tmp){
+	size_t nb = n*size, i;
+	bool little = hostLittle();
+	int k;
+
+	for(i=stride; i<nb; ++i){
+		row[i] = (unsigned char)(row[i] + row[i-stride]);
+	}
+	tmp.assign(row, row+nb);
+	for(i=0; i<n; ++i){
+		for(k=0; k<size; ++k){
+			row[i*size+k] = tmp[(little ? size-1-k : k)*n + i];
+		}
+	}
+}
+
+static void applyFloatPredictor(unsigned char *row, size_t n, int size, vector<unsigned char> &tmp){
+	size_t nb = n*size, i;
+	bool little = hostLittle();
+	int k;
+
+	tmp.resize(nb);
+	for(i=0; i<n; ++i){
+		for(k=0; k<size; ++k){
+			tmp[(little ? size-1-k : k)*n + i] = row[i*size+k];
+		}
+	}
+	for(i=nb-1; i>=1; --i){
+		tmp[i] = (unsigned char)(tmp[i] - tmp[i-1]);
+	}
+	memcpy(row, tmp.data(), nb);
+}
+
+
+
+///////////////////////////////////////////////////////////////
+// GEOTIFF READER
+///////////////////////////////////////////////////////////////
+
+TiffReader::TiffReader()
+{
+	cached = -1;
+}
+
+bool TiffReader::open(string fn, const Header &hdr){
+	map<int, TiffTag> tags;
+	bool little, big;
+
+	f.open(fn.c_str(), ios::binary | ios::in);
+	if(!f || !readDirectory(f, tags, little, big)){
+		return false;
+	}
+
+	swap = (little != hostLittle());
+	width = hdr.ncols;
+	length = hdr.nlines;
+	spp = hdr.bands;
+	bytes = hdr.valueSize();
+	datatype = hdr.datatype;
+	band = hdr.band;
+	planar = (tagValue(tags, 284, 1) == 2);
+	compression = (int)tagValue(tags, 259, TIFF_NONE);
+	predictor = (int)tagValue(tags, 317, 1);
+
+	if(tags.count(322) && tags.count(324)){
+		tileWidth = (int)tagValue(tags, 322, width);
+		tileLength = (int)tagValue(tags, 323, length);
+		offsets = tags[324].ints;
+		counts = tags[325].ints;
+		stripped = false;
+	} else{
+		uint64_t rps = tagValue(tags, 278, length);
+		tileWidth = width;
+		tileLength = (rps < (uint64_t)length) ? (int)rps : length;
+		offsets = tags[273].ints;
+		counts = tags[279].ints;
+		stripped = true;
+	}
+	if(tileWidth <= 0 || tileLength <= 0){
+		return false;
+	}
+	across = (width+tileWidth-1)/tileWidth;
+	down = (length+tileLength-1)/tileLength;
+	if(offsets.size() < (size_t)across*down*(planar ? spp : 1) || counts.size() < offsets.size()){
+		cerr << "ERROR: " << fn << " lists too few tiles" << endl;
+		return false;
+	}
+	if(predictor != 1 && predictor != 2 && !(predictor == 3 && (datatype == 4 || datatype == 5))){
+		cerr << "ERROR: Unsupported TIFF predictor " << predictor << " in " << fn << endl;
+		return false;
+	}
+
+	cached = -1;
+	rows.resize((size_t)tileLength*width);
+
+	return true;
+}
+
+// decompress tile (or strip) `index` into tile, which holds size bytes
+bool TiffReader::decodeTile(size_t index, size_t size){
+	tile.resize(size);
+
+	// tiles that were never written are empty
+	if(counts[index] == 0){
+		memset(tile.data(), 0, size);
+		return true;
+	}
+
+	data.resize(counts[index]);
+	f.seekg(offsets[index]);
+	f.read(reinterpret_cast<char*>(data.data()), data.size());
+	if(!f){
+		return false;
+	}
+
+	switch(compression){
+		case TIFF_NONE:
+			if(data.size() < size){
+				return false;
+			}
+			memcpy(tile.data(), data.data(), size);
+			return true;
+		case TIFF_LZW:
+			return lzwDecode(data.data(), data.size(), tile.data(), size);
+#ifdef RR_ZLIB
+		case TIFF_DEFLATE:
+		case TIFF_DEFLATE_OLD:
+		{
+			uLongf len = size;
+			return uncompress(tile.data(), &len, data.data(), data.size()) == Z_OK && len == size;
+		}
+#endif
+	}
+	return false;
+}
+
+// decode the band's values of tile row tr into rows
+bool TiffReader::decodeTileRow(int tr){
+	int inTile = planar ? 1 : spp;			// samples per pixel within a tile
+	int sample = planar ? 0 : band;
+	int nrows = (length - tr*tileLength < tileLength) ? length - tr*tileLength : tileLength;
+	// strips hold only their own rows; tiles are always whole
+	int tileRows = stripped ? nrows : tileLength;
+	size_t rowSamples = (size_t)tileWidth*inTile;
+	int tx, r, j;
+
+	for(tx=0; tx<across; ++tx){
+		size_t index = (planar ? (size_t)band*across*down : 0) + (size_t)tr*across + tx;
+		if(!decodeTile(index, (size_t)tileRows*rowSamples*bytes)){
+			return false;
+		}
+
+		int c0 = tx*tileWidth;
+		int nc = (width - c0 < tileWidth) ? width - c0 : tileWidth;
+		for(r=0; r<nrows; ++r){
+			unsigned char *row = &tile[(size_t)r*rowSamples*bytes];
+			if(predictor == 3){
+				undoFloatPredictor(row, rowSamples, bytes, inTile, packed);
+			} else{
+				if(swap && bytes > 1){
+					swapValues(row, rowSamples, bytes);
+				}
+				if(predictor == 2){
+					undoHorizontal(row, rowSamples, bytes, inTile);
+				}
+			}
+
+			// gather the band's samples (pixel interleaved tiles) and convert them
+			const unsigned char *src = row;
+			if(inTile > 1){
+				packed.resize((size_t)nc*bytes);
+				for(j=0; j<nc; ++j){
+					memcpy(&packed[(size_t)j*bytes], row + ((size_t)j*inTile + sample)*bytes, bytes);
+				}
+				src = packed.data();
+			}
+			rrKernels().convert(src, &rows[(size_t)r*width + c0], nc, datatype, false);
+		}
+	}
+	cached = tr;
+
+	return true;
+}
+
+bool TiffReader::read(int r0, int r1, float *dst){
+	int r;
+
+	for(r=r0; r<r1; ++r){
+		int tr = r/tileLength;
+		if(tr != cached && !decodeTileRow(tr)){
+			cerr << "ERROR: Cannot decode the tiles of row " << r << endl;
+			return false;
+		}
+		memcpy(dst + (size_t)(r-r0)*width, &rows[(size_t)(r - tr*tileLength)*width], (size_t)width*sizeof(float));
+	}
+
+	return true;
+}
+
+
+
+///////////////////////////////////////////////////////////////
+// GEOTIFF WRITER
+///////////////////////////////////////////////////////////////
+
+// a directory field to be written (values in this machine's byte order)
+struct TiffField
+{
+	int tag, type;
+	uint64_t count;
+	vector<unsigned char> values;
+	uint64_t pos;			// file position of the values
+};
+
+template <class T>
+static TiffField tiffField(int tag, int type, const vector<T> &v){
+	TiffField e;
+	e.tag = tag;
+	e.type = type;
+	e.count = v.size();
+	e.values.resize(v.size()*sizeof(T));
+	if(!v.empty()){
+		memcpy(e.values.data(), v.data(), e.values.size());
+	}
+	e.pos = 0;
+	return e;
+}
+
+static TiffField tiffText(int tag, string s){
+	vector<char> v(s.begin(), s.end());
+	v.push_back('\0');
+	return tiffField(tag, 2, v);
+}
+
+// the EPSG code of the header's coordinate system (0 if unknown); geographic
+// is set for latitude/longitude systems
+static int headerEPSG(const Header &hdr, bool &geographic){
+	int zone = atoi(hdr.utm_zone_number.c_str());
+	bool south = !hdr.utm_zone_band.empty() && (hdr.utm_zone_band[0] == 'S' || hdr.utm_zone_band[0] == 's');
+
+	geographic = false;
+	if(hdr.coordsys.compare("UTM") == 0 && zone >= 1 && zone <= 60){
+		if(hdr.datum.find("WGS") != string::npos && hdr.datum.find("84") != string::npos){
+			return (south ? 32700 : 32600) + zone;
+		}
+		if(!south && zone <= 23 && (hdr.datum.find("NAD83") != string::npos || hdr.datum.find("1983") != string::npos)){
+			return 26900 + zone;
+		}
+	} else if(hdr.coordsys.find("Geographic") != string::npos && hdr.datum.find("WGS") != string::npos){
+		geographic = true;
+		return 4326;
+	}
+	return 0;
+}
+
+TiffWriter::TiffWriter()
+{
+	big = false;
+	end = 0;
+}
+
+bool TiffWriter::open(string fn, const Header &hdr, int m_nbands, bool m_bytes, int m_compression, int nthreads, string bandnames){
+	size_t k;
+
+	name = fn;
+	width = hdr.ncols;
+	length = hdr.nlines;
+	nbands = m_nbands;
+	bytes = m_bytes ? 1 : sizeof(float);
+	compression = m_compression;
+	// the floating point predictor roughly halves the size of compressed float rasters
+	predictor = (!m_bytes && compression != TIFF_NONE) ? 3 : 1;
+	threads = (nthreads > 0) ? nthreads : 1;
+	across = (width+TIFF_TILE-1)/TIFF_TILE;
+	down = (length+TIFF_TILE-1)/TIFF_TILE;
+	big = ((uint64_t)nbands*hdr.npix*bytes > TIFF_CLASSIC_LIMIT);
+
+	size_t ntiles = (size_t)across*down*nbands;
+	offsets.assign(ntiles, 0);
+	counts.assign(ntiles, 0);
+	pending.assign(nbands, vector<char>((size_t)TIFF_TILE*width*bytes));
+	next.assign(nbands, 0);
+
+	f.open(fn.c_str(), ios::out | ios::binary);
+	if(!f){
+		return false;
+	}
+
+	// directory fields, in tag order
+	vector<TiffField> fields;
+	int offsetType = big ? 16 : 4;		// LONG8 or LONG
+	fields.push_back(tiffField(256, 4, vector<uint32_t>(1, width)));
+	fields.push_back(tiffField(257, 4, vector<uint32_t>(1, length)));
+	fields.push_back(tiffField(258, 3, vector<uint16_t>(nbands, 8*bytes)));
+	fields.push_back(tiffField(259, 3, vector<uint16_t>(1, compression)));
+	fields.push_back(tiffField(262, 3, vector<uint16_t>(1, 1)));			// BlackIsZero
+	fields.push_back(tiffField(277, 3, vector<uint16_t>(1, nbands)));
+	fields.push_back(tiffField(284, 3, vector<uint16_t>(1, (nbands > 1) ? 2 : 1)));	// one plane per band
+	if(compression != TIFF_NONE){
+		fields.push_back(tiffField(317, 3, vector<uint16_t>(1, predictor)));
+	}
+	fields.push_back(tiffField(322, 4, vector<uint32_t>(1, TIFF_TILE)));
+	fields.push_back(tiffField(323, 4, vector<uint32_t>(1, TIFF_TILE)));
+	if(big){
+		fields.push_back(tiffField(324, offsetType, vector<uint64_t>(ntiles, 0)));
+		fields.push_back(tiffField(325, offsetType, vector<uint64_t>(ntiles, 0)));
+	} else{
+		fields.push_back(tiffField(324, offsetType, vector<uint32_t>(ntiles, 0)));
+		fields.push_back(tiffField(325, offsetType, vector<uint32_t>(ntiles, 0)));
+	}
+	if(nbands > 1){
+		fields.push_back(tiffField(338, 3, vector<uint16_t>(nbands-1, 0)));	// the other bands are unspecified extra samples
+	}
+	fields.push_back(tiffField(339, 3, vector<uint16_t>(nbands, m_bytes ? 1 : 3)));
+
+	// georeferencing: pixel size, upper-left corner and the coordinate system
+	double scale[3] = {hdr.xres, hdr.yres, 0};
+	double tie[6] = {0, 0, 0, hdr.ulx, hdr.uly, 0};
+	fields.push_back(tiffField(33550, 12, vector<double>(scale, scale+3)));
+	fields.push_back(tiffField(33922, 12, vector<double>(tie, tie+6)));
+	bool geographic;
+	int epsg = headerEPSG(hdr, geographic);
+	vector<uint16_t> keys;
+	keys.push_back(1); keys.push_back(1); keys.push_back(0); keys.push_back(0);
+	uint16_t model[4] = {1024, 0, 1, (uint16_t)(geographic ? 2 : 1)};		// GTModelType
+	uint16_t raster[4] = {1025, 0, 1, 1};									// GTRasterType: PixelIsArea
+	keys.insert(keys.end(), model, model+4);
+	keys.insert(keys.end(), raster, raster+4);
+	if(epsg && geographic){
+		uint16_t gcs[4] = {2048, 0, 1, (uint16_t)epsg};
+		keys.insert(keys.end(), gcs, gcs+4);
+	} else if(epsg){
+		uint16_t pcs[4] = {3072, 0, 1, (uint16_t)epsg};
+		keys.insert(keys.end(), pcs, pcs+4);
+	}
+	keys[3] = (uint16_t)(keys.size()/4 - 1);
+	fields.push_back(tiffField(34735, 3, keys));
+
+	// band names (GDAL_METADATA) and the value of NULL pixels (GDAL_NODATA)
+	if(!bandnames.empty()){
+		string xml = "<GDALMetadata>\n";
+		stringstream names(bandnames);
+		string bn;
+		int b = 0;
+		while(getline(names, bn, ',')){
+			bn = bn.substr(bn.find_first_not_of(" "));
+			xml += "  <Item name=\"DESCRIPTION\" sample=\"" + to_string(b++) + "\" role=\"description\">" + bn + "</Item>\n";
+		}
+		xml += "</GDALMetadata>";
+		fields.push_back(tiffText(42112, xml));
+	}
+	if(!m_bytes){
+		fields.push_back(tiffText(42113, "-9999"));
+	}
+
+	// layout: header, directory, the values that do not fit in their entry, then the tiles
+	int headerSize = big ? 16 : 8;
+	int entrySize = big ? 20 : 12;
+	int fieldSize = big ? 8 : 4;
+	uint64_t dirSize = big ? 8 + fields.size()*entrySize + 8 : 2 + fields.size()*entrySize + 4;
+	uint64_t pos = headerSize + dirSize;
+	for(k=0; k<fields.size(); ++k){
+		if(fields[k].values.size() > (size_t)fieldSize){
+			fields[k].pos = pos;
+			pos += (fields[k].values.size()+7) & ~(uint64_t)7;
+		} else{
+			fields[k].pos = headerSize + (big ? 8 : 2) + k*entrySize + (big ? 12 : 8);
+		}
+		if(fields[k].tag == 324) offsetsPos = fields[k].pos;
+		if(fields[k].tag == 325) countsPos = fields[k].pos;
+	}
+	end = pos;
+
+	// everything in this machine's byte order
+	vector<unsigned char> head(end, 0);
+	unsigned char *p = head.data();
+	uint16_t magic = big ? 43 : 42;
+	p[0] = p[1] = hostLittle() ? 'I' : 'M';
+	memcpy(p+2, &magic, 2);
+	if(big){
+		uint16_t osize = 8, zero = 0;
+		uint64_t dir = headerSize;
+		memcpy(p+4, &osize, 2);
+		memcpy(p+6, &zero, 2);
+		memcpy(p+8, &dir, 8);
+	} else{
+		uint32_t dir = headerSize;
+		memcpy(p+4, &dir, 4);
+	}
+	p += headerSize;
+	if(big){
+		uint64_t n = fields.size();
+		memcpy(p, &n, 8);
+		p += 8;
+	} else{
+		uint16_t n = (uint16_t)fields.size();
+		memcpy(p, &n, 2);
+		p += 2;
+	}
+	for(k=0; k<fields.size(); ++k, p+=entrySize){
+		uint16_t tag = (uint16_t)fields[k].tag, type = (uint16_t)fields[k].type;
+		memcpy(p, &tag, 2);
+		memcpy(p+2, &type, 2);
+		if(big){
+			uint64_t count = fields[k].count;
+			memcpy(p+4, &count, 8);
+		} else{
+			uint32_t count = (uint32_t)fields[k].count;
+			memcpy(p+4, &count, 4);
+		}
+		if(fields[k].values.size() > (size_t)fieldSize){
+			if(big){
+				memcpy(p+12, &fields[k].pos, 8);
+			} else{
+				uint32_t off = (uint32_t)fields[k].pos;
+				memcpy(p+8, &off, 4);
+			}
+		}
+		memcpy(&head[fields[k].pos], fields[k].values.data(), fields[k].values.size());
+	}
+	// (the offset of the next directory stays 0: there is only one image)
+
+	f.write(reinterpret_cast<const char*>(head.data()), head.size());
+
+	return (bool)f;
+}
+
+void TiffWriter::writeRows(int b, int r0, int r1, const char *src){
+	size_t rowBytes = (size_t)width*bytes;
+	int r;
+
+	for(r=r0; r<r1; ++r){
+		int tr = r/TIFF_TILE;
+		memcpy(&pending[b][(size_t)(r - tr*TIFF_TILE)*rowBytes], src + (size_t)(r-r0)*rowBytes, rowBytes);
+		next[b] = r+1;
+		if(next[b]%TIFF_TILE == 0 || next[b] == length){
+			flushTileRow(b, tr);
+		}
+	}
+}
+
+// compress tile tx of tile row tr of band b
+void TiffWriter::encodeTile(int b, int tr, int tx, vector<unsigned char> &out){
+	vector<unsigned char> tile((size_t)TIFF_TILE*TIFF_TILE*bytes, 0), tmp;
+	size_t rowBytes = (size_t)TIFF_TILE*bytes;
+	int c0 = tx*TIFF_TILE;
+	int nc = (width - c0 < TIFF_TILE) ? width - c0 : TIFF_TILE;
+	int nr = (length - tr*TIFF_TILE < TIFF_TILE) ? length - tr*TIFF_TILE : TIFF_TILE;
+	int r;
+
+	// edge tiles are padded with zeros
+	for(r=0; r<nr; ++r){
+		memcpy(&tile[r*rowBytes], &pending[b][((size_t)r*width + c0)*bytes], (size_t)nc*bytes);
+	}
+	if(predictor == 3){
+		for(r=0; r<TIFF_TILE; ++r){
+			applyFloatPredictor(&tile[r*rowBytes], TIFF_TILE, bytes, tmp);
+		}
+	}
+
+	if(compression == TIFF_LZW){
+		lzwEncode(tile.data(), tile.size(), out);
+	}
+#ifdef RR_ZLIB
+	else if(compression == TIFF_DEFLATE){
+		uLongf len = compressBound(tile.size());
+		out.resize(len);
+		compress2(out.data(), &len, tile.data(), tile.size(), 6);
+		out.resize(len);
+	}
+#endif
+	else{
+		out.swap(tile);
+	}
+}
+
+void TiffWriter::encodeTiles(int b, int tr, atomic<int> *nextTile, vector< vector<unsigned char> > *out){
+	int tx;
+
+	while((tx = (*nextTile)++) < across){
+		encodeTile(b, tr, tx, (*out)[tx]);
+	}
+}
+
+// compress the tiles of tile row tr of band b (on several threads) and append them
+void TiffWriter::flushTileRow(int b, int tr){
+	vector< vector<unsigned char> > out(across);
+	vector<thread> pool;
+	atomic<int> nextTile(0);
+	int t, tx;
+
+	int nt = (threads < across) ? threads : across;
+	for(t=1; t<nt; ++t){
+		pool.push_back(thread(&TiffWriter::encodeTiles, this, b, tr, &nextTile, &out));
+	}
+	encodeTiles(b, tr, &nextTile, &out);
+	for(t=0; t<(int)pool.size(); ++t){
+		pool[t].join();
+	}
+
+	f.seekp(end);
+	for(tx=0; tx<across; ++tx){
+		size_t index = (size_t)b*across*down + (size_t)tr*across + tx;
+		offsets[index] = end;
+		counts[index] = out[tx].size();
+		f.write(reinterpret_cast<const char*>(out[tx].data()), out[tx].size());
+		end += out[tx].size();
+	}
+}
+
+bool TiffWriter::close(){
+	size_t k;
+	int b;
+
+	// a partly written tile row (only if fewer rows than the raster were written)
+	for(b=0; b<nbands; ++b){
+		if(next[b]%TIFF_TILE != 0 && next[b] < length){
+			flushTileRow(b, next[b]/TIFF_TILE);
+		}
+	}
+
+	// the tile offsets and byte counts reserved in the directory
+	if(big){
+		f.seekp(offsetsPos);
+		f.write(reinterpret_cast<const char*>(offsets.data()), offsets.size()*sizeof(uint64_t));
+		f.seekp(countsPos);
+		f.write(reinterpret_cast<const char*>(counts.data()), counts.size()*sizeof(uint64_t));
+	} else{
+		vector<uint32_t> v(offsets.size());
+		for(k=0; k<v.size(); ++k) v[k] = (uint32_t)offsets[k];
+		f.seekp(offsetsPos);
+		f.write(reinterpret_cast<const char*>(v.data()), v.size()*sizeof(uint32_t));
+		for(k=0; k<v.size(); ++k) v[k] = (uint32_t)counts[k];
+		f.seekp(countsPos);
+		f.write(reinterpret_cast<const char*>(v.data()), v.size()*sizeof(uint32_t));
+	}
+
+	bool ok = (bool)f;
+	f.close();
+
+	return ok;
+}
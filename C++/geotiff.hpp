@@ -0,0 +1,114 @@
+#ifndef GEOTIFF_HPP
+#define GEOTIFF_HPP
+
+#include <stdint.h>
+#include <atomic>
+#include <fstream>
+#include <string>
+#include <vector>
+
+using namespace std;
+
+class Header;
+
+///////////////////////////////////////////////////////////////
+// GEOTIFF RASTERS
+///////////////////////////////////////////////////////////////
+// Tiled or stripped GeoTIFF rasters (classic TIFF or BigTIFF), read and written
+// without external libraries. LZW and the horizontal (2) and floating point (3)
+// predictors are built in; DEFLATE needs zlib (compile with -DRR_ZLIB and link
+// with -lz). Header::LoadTIFF reads the georeferencing and layout of a file.
+
+// TIFF compression codes
+enum TiffCompression
+{
+	TIFF_NONE = 1,
+	TIFF_LZW = 5,
+	TIFF_DEFLATE = 8,			// "Adobe" deflate (zlib stream)
+	TIFF_DEFLATE_OLD = 32946	// older code of the same stream (read only)
+};
+
+// compression code of a parameter value (none, lzw or deflate), -1 if unknown
+// or not available in this build
+int tiffCompression(string name);
+
+// the file name ends in .tif or .tiff
+bool isTiffName(string fn);
+
+// Reads rows of one band of a GeoTIFF as floats. Only the tiles (or strips) that
+// hold the requested rows are read and decoded; the last decoded tile row is kept,
+// so rows can be requested in blocks of any size.
+class TiffReader
+{
+public:
+	TiffReader();
+
+	bool open(string fn, const Header &hdr);
+	bool is_open() const { return f.is_open(); }
+	void close(){ f.close(); }
+
+	// read rows r0 to r1-1 of band hdr.band into dst. Returns false if a tile
+	// cannot be read or decoded.
+	bool read(int r0, int r1, float *dst);
+
+private:
+	ifstream f;
+	bool swap;					// the file's byte order is not this machine's
+	int width, length;
+	int spp, bytes;				// samples per pixel, bytes per sample
+	bool planar;				// one plane per band (PlanarConfiguration 2)
+	int compression, predictor;
+	int tileWidth, tileLength;	// strips are tiles as wide as the image
+	bool stripped;				// the last strip holds only the rows left
+	int across, down;			// tiles per tile row / per plane
+	vector<uint64_t> offsets, counts;
+	int band, datatype;
+
+	int cached;					// tile row held in rows (-1 if none)
+	vector<float> rows;			// band values of tile row `cached` (tileLength x width)
+	vector<unsigned char> data, tile, packed;
+
+	bool decodeTileRow(int tr);
+	bool decodeTile(size_t index, size_t size);
+};
+
+// Writes a tiled GeoTIFF (256 x 256 tiles) of float32 or uint8 bands with the
+// georeferencing of a Header. The directory is written at the start of the file,
+// ahead of the tiles, as in a cloud optimized GeoTIFF (without overviews). Rows
+// are buffered until a tile row is complete; its tiles are then compressed on
+// several threads. Files that may exceed 4 GB are written as BigTIFF.
+class TiffWriter
+{
+public:
+	TiffWriter();
+
+	// create fn with nbands bands of float32 (or uint8 if bytes) values.
+	// bandnames is a comma separated list (optional).
+	bool open(string fn, const Header &hdr, int nbands, bool bytes, int compression, int nthreads, string bandnames);
+
+	// rows r0 to r1-1 of band b (the rows of each band must be written in order)
+	void writeRows(int b, int r0, int r1, const char *src);
+
+	// write the tiles still buffered and the tile offsets, and close the file
+	bool close();
+
+private:
+	ofstream f;
+	string name;
+	int width, length, nbands, bytes;
+	int compression, predictor, threads;
+	int across, down;			// tiles per tile row / per band
+	bool big;					// BigTIFF
+
+	vector< vector<char> > pending;		// rows of the current tile row of each band
+	vector<int> next;					// next row expected of each band
+	vector<uint64_t> offsets, counts;
+	uint64_t offsetsPos, countsPos;		// where the offset/count arrays go in the file
+	uint64_t end;						// end of the data written so far
+
+	void flushTileRow(int b, int tr);
+	void encodeTile(int b, int tr, int tx, vector<unsigned char> &out);
+	void encodeTiles(int b, int tr, atomic<int> *nextTile, vector< vector<unsigned char> > *out);
+};
+
+#endif
@@ -7,49 +7,1213 @@
 #include <map>
 #include <vector>
 #include <random>
+#include <limits>
+#include <thread>
+#include <functional>
+#include <initializer_list>
+
+// SIMD row kernels with runtime CPU dispatch
+#include "rr_kernels.hpp"
 
 using namespace std;
 
-//function to compute the relative relief
-void Raster::computeRelativeRelief(int i, int j, int buf, Header hdr){
-	register int ii, jj, a;
-	int index = (i*hdr.ncols)+j;
-	float z1 = 0;
-	vector<float> tmp;
-
-	// iterate through all pixels in the specified window size
-	for(a=buf; a<(buf+9); ++a){
-		float z_min = Raster::z[index];
-		float z_max = Raster::z[index];
-
-		for(ii=i-a; ii<i+a+1; ++ii){
-			if(ii>=0 && ii<hdr.nlines){
-				for(jj=j-a; jj<j+a+1; ++jj){
-					if(jj>=0 && jj<hdr.ncols){
-						int index2 = (ii*hdr.ncols)+jj;
-
-						if(Raster::z[index2] > -100){
-//							cout << index2 << " ==> " << Raster::z[index2] << endl;
-
-							// calculate parameters for relative relief
-							if(Raster::z[index2] > z_max){
-								z_max = Raster::z[index2];
-//								cout << index << " - " << index2 << " (" << a << ")" << " max -> " << z_max << endl;
-							} else if(Raster::z[index2] < z_min){
-								z_min = Raster::z[index2];
-//								cout << index << " - " << index2 << " (" << a << ")" << " min -> " << z_min << endl;
-							}
-						}
+///////////////////////////////////////////////////////////////
+// RASTER ROW SOURCES
+///////////////////////////////////////////////////////////////
+
+// Supplies elevation rows to the running min/max filters below.
+class RowSource
+{
+public:
+	virtual ~RowSource(){}
+
+	// pointer to the ncols elevations of raster row r
+	virtual const float *row(int r) = 0;
+
+	// validity bits of row r (bit 0 is the first pixel of row(r)); the pointer
+	// may be reused by the next call
+	virtual const uint64_t *valid(int r) = 0;
+};
+
+// rows of the input band read on demand (as floats) into a ring buffer of `capacity`
+// rows. Rows are read sequentially, so the file is only read once, and a row can
+// be requested again as long as fewer than `capacity` newer rows have been read.
+class StreamedRows : public RowSource
+{
+public:
+	bool open(string fn, Header hdr, int m_capacity);
+
+	const float *row(int r);
+	const uint64_t *valid(int r);
+
+private:
+	BandReader f;
+	vector<float> ring;
+	vector<uint64_t> ringValid;	// validity bits of the rows in ring
+	int words;					// validity words per row
+	float floor, nodata;		// validity rule of the header
+	int ncols, nlines;
+	int capacity;
+	int loaded;			// number of rows read from the file so far
+};
+
+bool StreamedRows::open(string fn, Header hdr, int m_capacity){
+	ncols = hdr.ncols;
+	nlines = hdr.nlines;
+	capacity = (m_capacity < nlines) ? m_capacity : nlines;
+	loaded = 0;
+	words = (ncols+63)/64;
+	floor = hdr.nullFloor();
+	nodata = hdr.nodata;
+
+	fn = hdr.dataFile(fn);
+	if(!f.open(fn, hdr)){
+		cerr << "ERROR: Cannot open " << fn << endl;
+		return false;
+	}
+
+	ring.resize((size_t)capacity*ncols);
+	ringValid.resize((size_t)capacity*words);
+
+	return true;
+}
+
+const float *StreamedRows::row(int r){
+	while(loaded <= r){
+		float *dst = &ring[(size_t)(loaded%capacity)*ncols];
+		if(!f.read(loaded, loaded+1, dst)){
+			cerr << "ERROR: Unexpected end of file at row " << loaded << endl;
+			exit(1);
+		}
+		rrKernels().validity(dst, &ringValid[(size_t)(loaded%capacity)*words], ncols, floor, nodata);
+		++loaded;
+	}
+	if(r < loaded-capacity){
+		cerr << "ERROR: Row " << r << " is no longer held in the row buffer" << endl;
+		exit(1);
+	}
+
+	return &ring[(size_t)(r%capacity)*ncols];
+}
+
+const uint64_t *StreamedRows::valid(int r){
+	row(r);
+	return &ringValid[(size_t)(r%capacity)*words];
+}
+
+
+
+///////////////////////////////////////////////////////////////
+// SEPARABLE RUNNING MINIMUM (van Herk/Gil-Werman)
+///////////////////////////////////////////////////////////////
+
+// Row pass: prefix (lpre) and suffix (lsuf) minima of every block of w values
+// of the padded line (len is a multiple of w).
+typedef void (*RowPass)(const float *line, float *lpre, float *lsuf, int len, int w);
+
+static void rowPassGeneric(const float *line, float *lpre, float *lsuf, int len, int w){
+	int k, kk;
+
+	for(k=0; k<len; k+=w){
+		int e = k+w-1;
+		lpre[k] = line[k];
+		for(kk=k+1; kk<=e; ++kk){
+			lpre[kk] = (lpre[kk-1] < line[kk]) ? lpre[kk-1] : line[kk];
+		}
+		lsuf[e] = line[e];
+		for(kk=e-1; kk>=k; --kk){
+			lsuf[kk] = (lsuf[kk+1] < line[kk]) ? lsuf[kk+1] : line[kk];
+		}
+	}
+}
+
+// same as rowPassGeneric with the block width W fixed at compile time, so the
+// prefix/suffix loops of each block are fully unrolled
+template<int W>
+static void rowPassFixed(const float *line, float *lpre, float *lsuf, int len, int){
+	int k, kk;
+
+	for(k=0; k<len; k+=W){
+		const float *l = line+k;
+		float *p = lpre+k;
+		float *s = lsuf+k;
+
+		p[0] = l[0];
+#pragma GCC unroll 64
+		for(kk=1; kk<W; ++kk){
+			p[kk] = (p[kk-1] < l[kk]) ? p[kk-1] : l[kk];
+		}
+		s[W-1] = l[W-1];
+#pragma GCC unroll 64
+		for(kk=W-2; kk>=0; --kk){
+			s[kk] = (s[kk+1] < l[kk]) ? s[kk+1] : l[kk];
+		}
+	}
+}
+
+// window widths that get a compile-time specialised row pass; all others use
+// rowPassGeneric. Add the window sizes of the scale sets you run routinely.
+template<int... W>
+struct RowPassTable
+{
+	static RowPass find(int w){
+		RowPass fn = rowPassGeneric;
+		(void)initializer_list<int>{ (w == W ? (fn = rowPassFixed<W>, 0) : 0)... };
+		return fn;
+	}
+};
+typedef RowPassTable<3, 5, 7, 9, 11, 13, 15, 17, 19, 21, 23, 25, 27, 29, 31, 33, 35, 37, 39, 41> FixedRowPasses;
+
+// Streams the minimum of every (2a+1)x(2a+1) window one raster row at a time.
+// The window is split into a column pass (whole rows at a time) followed by a
+// row pass, and each pass uses the van Herk/Gil-Werman block prefix/suffix
+// trick, so every output costs 3 comparisons per pass no matter how large the
+// window is. Only 2*(2a+1) rows of scratch are kept in memory, and the input
+// rows requested for output row k stay within k-3a to k+3a+1.
+//
+// Pixels outside the raster and NULL pixels (see Header::nullFloor) are replaced by +inf so
+// they can never be selected. Maxima are computed as the minimum of -z, which
+// is exact for floats; the rows returned hold the minima of sign*z, so the
+// caller negates them back. The element-wise row work goes through the SIMD
+// kernels selected by rrKernels().
+class RunningMinimum
+{
+public:
+	RunningMinimum(RowSource *m_src, int m_ncols, int m_nlines, int m_a, bool m_negate);
+
+	// write the window minimum (of sign*z) of the next raster row to rowmin
+	// (ncols values)
+	void nextRow(float *rowmin);
+
+	// position the filter so that the next call to nextRow() returns row r
+	void seek(int r){ row = r; }
+private:
+	RowSource *src;
+	int ncols, nlines;
+	int a, w;			// window radius and width
+	float sign;			// -1 filters -z instead of z (used for the running maximum)
+	int block;			// index of the block currently held in suf/pre
+	int row;			// next output row
+
+	vector<float> suf;	// suffix minima of the current block of w rows
+	vector<float> pre;	// prefix minima of the following block of w rows
+	vector<float> line, lpre, lsuf;	// padded scratch for the row pass
+	RowPass rowpass;
+
+	void loadRow(int p, float *out);
+	void loadBlock(int b);
+};
+
+RunningMinimum::RunningMinimum(RowSource *m_src, int m_ncols, int m_nlines, int m_a, bool m_negate)
+{
+	src = m_src;
+	ncols = m_ncols;
+	nlines = m_nlines;
+	a = m_a;
+	w = 2*a+1;
+	sign = m_negate ? -1 : 1;
+	block = -1;
+	row = 0;
+	rowpass = FixedRowPasses::find(w);
+
+	suf.resize((size_t)w*ncols);
+	pre.resize((size_t)w*ncols);
+
+	// the padded row is rounded up to a whole number of blocks
+	int len = ((ncols+2*a+w-1)/w)*w;
+	line.assign(len, numeric_limits<float>::infinity());
+	lpre.resize(len);
+	lsuf.resize(len);
+}
+
+// copy padded row p (raster row p-a) into out, replacing NULL and out-of-raster pixels with +inf
+void RunningMinimum::loadRow(int p, float *out){
+	int r = p-a;
+
+	if(r<0 || r>=nlines){
+		fill(out, out+ncols, numeric_limits<float>::infinity());
+		return;
+	}
+
+	rrKernels().mask(src->row(r), src->valid(r), out, ncols, sign);
+}
+
+// build the suffix minima of block b and the prefix minima of block b+1
+void RunningMinimum::loadBlock(int b){
+	const RRKernels &kern = rrKernels();
+	int k;
+	int p0 = b*w;
+
+	loadRow(p0+w-1, &suf[(size_t)(w-1)*ncols]);
+	for(k=w-2; k>=0; --k){
+		float *cur = &suf[(size_t)k*ncols];
+		const float *nxt = cur+ncols;
+		loadRow(p0+k, cur);
+		kern.minimum(nxt, cur, cur, ncols, 1);
+	}
+
+	// the last row of the next block is never needed (its window starts a new block)
+	p0 += w;
+	loadRow(p0, &pre[0]);
+	for(k=1; k<w-1; ++k){
+		float *cur = &pre[(size_t)k*ncols];
+		const float *prv = cur-ncols;
+		loadRow(p0+k, cur);
+		kern.minimum(prv, cur, cur, ncols, 1);
+	}
+
+	block = b;
+}
+
+void RunningMinimum::nextRow(float *rowmin){
+	const RRKernels &kern = rrKernels();
+	int b = row/w;
+	int off = row-b*w;
+
+	if(b != block){
+		loadBlock(b);
+	}
+
+	// column pass: window of padded rows [row, row+2a] spans suf[off] and pre[off-1]
+	float *col = &line[a];
+	const float *s = &suf[(size_t)off*ncols];
+	if(off == 0){
+		copy(s, s+ncols, col);
+	} else{
+		kern.minimum(&pre[(size_t)(off-1)*ncols], s, col, ncols, 1);
+	}
+
+	// row pass over the padded line (the pads stay +inf)
+	rowpass(&line[0], &lpre[0], &lsuf[0], line.size(), w);
+	kern.minimum(&lpre[2*a], &lsuf[0], rowmin, ncols, 1);
+
+	++row;
+}
+
+
+// The window minima of every scale of a scale set, each scale derived from
+// the next smaller one instead of from the rows. A window of radius b = a+d
+// with d <= a is the union of the four windows of radius a centred d pixels
+// away diagonally, so
+//	m_b[i][x] = min(m_a[i-d][x-d], m_a[i-d][x+d], m_a[i+d][x-d], m_a[i+d][x+d])
+// with the indices clamped to the raster (a clamped window still lies inside
+// the larger one). That is one vertical and one horizontal comparison per
+// pixel whatever the radii; only the smallest scale runs a RunningMinimum over
+// the rows. Scales more than twice as wide as the previous one are reached
+// through intermediate levels. Min and max are exact, so the result is
+// bit-identical to filtering each scale separately.
+//
+// Each level produces its rows on demand and keeps the last few in a ring:
+// the rows the next level reads (i-d to i+d) and, for the levels of the scale
+// set, the rows from the current output row up to the ones the largest scale
+// needs. Ask for a row of the largest scale first (see ReliefRows::nextRow),
+// so that the smaller ones already hold the rows the larger ones read.
+class NestedMinimum
+{
+public:
+	NestedMinimum(RowSource *src, int m_ncols, int m_nlines, const ScaleSet &scales, bool m_negate);
+
+	// window minima (of sign*z) of scale k at raster row r (clamped to the raster)
+	const float *row(int k, int r){ return levelRow(scaleLevel[k], r); }
+private:
+	struct Level
+	{
+		int d;				// radius added to the previous level
+		int capacity;		// rows kept in the ring
+		int last;			// last row produced (-1 before the first)
+		vector<float> ring;
+	};
+
+	int ncols, nlines;
+	RunningMinimum base;
+	vector<Level> levels;
+	vector<int> scaleLevel;	// level of each scale
+	vector<float> line;		// padded scratch for the horizontal step
+
+	const float *levelRow(int l, int r);
+	void produce(int l, int r, float *out);
+};
+
+NestedMinimum::NestedMinimum(RowSource *src, int m_ncols, int m_nlines, const ScaleSet &scales, bool m_negate)
+	: base(src, m_ncols, m_nlines, scales.radius(0), m_negate)
+{
+	int k, l;
+	int R = scales.maxRadius();
+	int cur = scales.radius(0);
+	int dmax = 0;
+
+	ncols = m_ncols;
+	nlines = m_nlines;
+
+	// level 0 is the smallest scale, the others add d <= (current radius) at a time
+	levels.push_back(Level());
+	levels.back().d = 0;
+	scaleLevel.push_back(0);
+	for(k=1; k<scales.size(); ++k){
+		while(cur < scales.radius(k)){
+			Level lv;
+			lv.d = (scales.radius(k)-cur < cur) ? scales.radius(k)-cur : cur;
+			cur += lv.d;
+			dmax = (lv.d > dmax) ? lv.d : dmax;
+			levels.push_back(lv);
+		}
+		scaleLevel.push_back(levels.size()-1);
+	}
+
+	// a level keeps the rows the next one reads around its row; the levels of
+	// the scale set also run ahead of the output row by R minus their radius
+	cur = scales.radius(0);
+	for(l=0, k=0; l<(int)levels.size(); ++l){
+		cur += levels[l].d;
+		int next = (l+1 < (int)levels.size()) ? 2*levels[l+1].d : 0;
+		int ahead = 0;
+		if(k < scales.size() && scaleLevel[k] == l){
+			ahead = R-cur;
+			++k;
+		}
+		levels[l].capacity = ((next > ahead) ? next : ahead)+1;
+		levels[l].last = -1;
+		levels[l].ring.resize((size_t)levels[l].capacity*ncols);
+	}
+
+	line.resize(ncols+2*dmax);
+}
+
+const float *NestedMinimum::levelRow(int l, int r){
+	Level &lv = levels[l];
+	r = (r < 0) ? 0 : ((r >= nlines) ? nlines-1 : r);
+
+	if(lv.last < 0){
+		// the first row asked for is where the level starts
+		lv.last = r-1;
+		if(l == 0){
+			base.seek(r);
+		}
+	}
+	while(lv.last < r){
+		++lv.last;
+		produce(l, lv.last, &lv.ring[(size_t)(lv.last%lv.capacity)*ncols]);
+	}
+
+	return &lv.ring[(size_t)(r%lv.capacity)*ncols];
+}
+
+void NestedMinimum::produce(int l, int r, float *out){
+	const RRKernels &kern = rrKernels();
+	int d = levels[l].d;
+
+	if(l == 0){
+		base.nextRow(out);
+		return;
+	}
+
+	// vertical: rows r-d and r+d of the previous level (the ring holds both)
+	const float *up = levelRow(l-1, r-d);
+	const float *down = levelRow(l-1, r+d);
+	float *mid = &line[d];
+	kern.minimum(up, down, mid, ncols, 1);
+
+	// horizontal: columns x-d and x+d, the pads repeating the edge columns
+	fill(mid-d, mid, mid[0]);
+	fill(mid+ncols, mid+ncols+d, mid[ncols-1]);
+	kern.minimum(mid-d, mid+d, out, ncols, 1);
+}
+
+
+///////////////////////////////////////////////////////////////
+// MULTI-SCALE RELATIVE RELIEF BY ROW
+///////////////////////////////////////////////////////////////
+
+// Computes the relative relief of one row at a time at every scale of a scale
+// set plus their weighted average. NULL pixels get -9999; the raster edge is
+// left to the caller.
+class ReliefRows
+{
+public:
+	ReliefRows(RowSource *m_src, int m_ncols, int m_nlines, const ScaleSet &m_scales, int r0);
+
+	// compute the next row into scaleOut[k] (scale k, skipped if NULL) and avg
+	// (ncols values each)
+	void nextRow(float *const *scaleOut, float *avg);
+private:
+	RowSource *src;
+	int ncols;
+	int row;			// next output row
+	vector<double> weights;
+	double wsum;
+
+	NestedMinimum lo, hi;	// window minima of z and of -z
+	vector<float> z_max, rr;
+	vector<double> sum;
+};
+
+ReliefRows::ReliefRows(RowSource *m_src, int m_ncols, int m_nlines, const ScaleSet &m_scales, int r0)
+	: lo(m_src, m_ncols, m_nlines, m_scales, false), hi(m_src, m_ncols, m_nlines, m_scales, true)
+{
+	src = m_src;
+	ncols = m_ncols;
+	row = r0;
+	weights = m_scales.weights;
+	wsum = m_scales.weightSum();
+
+	z_max.resize(ncols);
+	rr.resize(ncols);
+	sum.resize(ncols);
+}
+
+void ReliefRows::nextRow(float *const *scaleOut, float *avg){
+	const RRKernels &kern = rrKernels();
+	int k;
+	int nscales = weights.size();
+
+	fill(sum.begin(), sum.end(), 0.0);
+
+	// the largest scale pulls the rows it needs through the smaller ones
+	lo.row(nscales-1, row);
+	hi.row(nscales-1, row);
+
+	// accumulate smallest window first
+	for(k=0; k<nscales; ++k){
+		const float *z_min = lo.row(k, row);
+		const float *nz_max = hi.row(k, row);
+		kern.minimum(nz_max, nz_max, z_max.data(), ncols, -1);
+
+		// requested scales are written straight into their output row
+		float *out = scaleOut[k] ? scaleOut[k] : rr.data();
+		const float *zr = src->row(row);
+		kern.relief(zr, z_min, z_max.data(), out, sum.data(), ncols, weights[k]);
+		if(scaleOut[k]){
+			kern.nullify(src->valid(row), out, ncols);
+		}
+	}
+
+	kern.average(src->valid(row), sum.data(), avg, ncols, wsum);
+
+	++row;
+}
+
+
+///////////////////////////////////////////////////////////////
+// SHORELINE BAND
+///////////////////////////////////////////////////////////////
+
+// columns c0 to c0+n-1 of the rows of another row source
+class ColumnWindow : public RowSource
+{
+public:
+	ColumnWindow(RowSource *m_src, int m_c0, int m_n) : bits((m_n+63)/64){ src = m_src; c0 = m_c0; n = m_n; }
+
+	const float *row(int r){ return src->row(r)+c0; }
+
+	// the validity bits of the window, shifted down to start at bit 0
+	const uint64_t *valid(int r){
+		const uint64_t *in = src->valid(r);
+		int w0 = c0>>6, sh = c0&63;
+		size_t k, last = (size_t)(c0+n-1)>>6;
+
+		for(k=0; k<bits.size(); ++k){
+			bits[k] = in[w0+k] >> sh;
+			if(sh && w0+k+1 <= last){
+				bits[k] |= in[w0+k+1] << (64-sh);
+			}
+		}
+		return bits.data();
+	}
+
+private:
+	RowSource *src;
+	int c0, n;
+	vector<uint64_t> bits;
+};
+
+// Elevations around a tile of a mosaic, taken from its neighbouring tiles:
+// `top` rows above and `bottom` rows below the tile (as wide as the tile plus
+// its halo columns), and `left` and `right` columns beside it. Each side is at
+// most the largest window radius, and 0 at the edge of the mosaic. Pixels that
+// no tile covers and NULL pixels of the neighbours are NaN.
+class TileHalo
+{
+public:
+	TileFrame frame;
+	int top, bottom, left, right;
+	int ncols, nlines;			// size of the tile
+
+	TileHalo(){ top = 0; bottom = 0; left = 0; right = 0; ncols = 0; nlines = 0; }
+
+	// the (NaN) halo of a tile of m_ncols x m_nlines placed at m_frame, for windows
+	// of up to radius pixels
+	void allocate(const TileFrame &m_frame, int m_ncols, int m_nlines, int radius){
+		frame = m_frame;
+		ncols = m_ncols;
+		nlines = m_nlines;
+		top = min(radius, frame.row0);
+		bottom = max(0, min(radius, frame.nlines-frame.row0-nlines));
+		left = min(radius, frame.col0);
+		right = max(0, min(radius, frame.ncols-frame.col0-ncols));
+
+		const float nan = numeric_limits<float>::quiet_NaN();
+		above.assign((size_t)top*width(), nan);
+		below.assign((size_t)bottom*width(), nan);
+		before.assign((size_t)nlines*left, nan);
+		after.assign((size_t)nlines*right, nan);
+	}
+
+	int width() const { return left+ncols+right; }
+	int height() const { return top+nlines+bottom; }
+	bool empty() const { return top+bottom+left+right == 0; }
+
+	// n halo values of tile row r (-top to nlines+bottom-1) from tile column c
+	// (-left to ncols+right-1) on; the values must lie within one side of the halo
+	float *at(int r, int c){
+		if(r < 0){
+			return &above[(size_t)(r+top)*width()+c+left];
+		} else if(r >= nlines){
+			return &below[(size_t)(r-nlines)*width()+c+left];
+		} else if(c < 0){
+			return &before[(size_t)r*left+c+left];
+		}
+		return &after[(size_t)r*right+c-ncols];
+	}
+	const float *at(int r, int c) const { return const_cast<TileHalo*>(this)->at(r, c); }
+
+private:
+	vector<float> above, below, before, after;
+};
+
+// rows of a tile extended by its halo: row 0 is the first halo row above the
+// tile and column 0 the first halo column left of it. The tile rows come from
+// core. NULL pixels of the tile are made NaN like those of the halo, so the
+// assembled rows have one validity rule (not NaN). The last `capacity` rows
+// assembled are kept, which covers the rows that the running minima of
+// ReliefRows request around their current row (see RunningMinimum).
+class HaloRows : public RowSource
+{
+public:
+	HaloRows(RowSource *m_core, const TileHalo *m_halo, int capacity){
+		core = m_core;
+		halo = m_halo;
+		width = halo->width();
+		words = (width+63)/64;
+		ring.resize((size_t)capacity*width);
+		ringValid.resize((size_t)capacity*words);
+		held.assign(capacity, -1);
+	}
+
+	const float *row(int r){ return &ring[(size_t)slot(r)*width]; }
+	const uint64_t *valid(int r){ return &ringValid[(size_t)slot(r)*words]; }
+
+private:
+	RowSource *core;
+	const TileHalo *halo;
+	int width, words;
+	vector<float> ring;
+	vector<uint64_t> ringValid;
+	vector<int> held;			// row held in each slot of the ring (-1 if none)
+
+	// slot of the ring that holds row r, assembling the row if needed
+	int slot(int r){
+		int s = r%held.size();
+		if(held[s] == r){
+			return s;
+		}
+
+		float *dst = &ring[(size_t)s*width];
+		int i = r-halo->top;
+		if(i < 0 || i >= halo->nlines){
+			copy(halo->at(i, -halo->left), halo->at(i, -halo->left)+width, dst);
+		} else{
+			const float nan = numeric_limits<float>::quiet_NaN();
+			const float *z = core->row(i);
+			const uint64_t *v = core->valid(i);
+			float *mid = dst+halo->left;
+
+			if(halo->left > 0){
+				copy(halo->at(i, -halo->left), halo->at(i, -halo->left)+halo->left, dst);
+			}
+			copy(z, z+halo->ncols, mid);
+			for(int j=0; j<halo->ncols; j+=64){
+				if(~v[j>>6] == 0){
+					continue;
+				}
+				int e = min(j+64, halo->ncols);
+				for(int t=j; t<e; ++t){
+					if(!((v[t>>6] >> (t&63)) & 1)){
+						mid[t] = nan;
 					}
 				}
 			}
+			if(halo->right > 0){
+				copy(halo->at(i, halo->ncols), halo->at(i, halo->ncols)+halo->right, mid+halo->ncols);
+			}
 		}
+		rrKernels().validity(dst, &ringValid[(size_t)s*words], width, -numeric_limits<float>::infinity(), -numeric_limits<float>::infinity());
 
-		// add the relative relief value to the data structure
-		tmp.push_back((Raster::z[index] - z_min)/(z_max - z_min));
-		Raster::res[index] = tmp[0];
+		held[s] = r;
+		return s;
 	}
+};
+
+// columns c0 to c1-1 of a raster row
+struct Span
+{
+	int c0, c1;
+};
+
+static bool spanBefore(const Span &a, const Span &b){ return a.c0 < b.c0; }
+
+// The pixels whose average relative relief the landform searches of main() can
+// read. Each transect's shoreline is found from z exactly as main() finds it;
+// the dune toe, crest and heel searches then only read the average within
+// tDuneDistMax+tCrestDistMax+tHeelDistMax of it, or of the start of the
+// transect when a search finds nothing (a position of 0). The band holds those
+// reaches plus one pixel each side of the transect (the searches also compare
+// neighbouring pixels).
+class ShoreBand
+{
+public:
+	ShoreBand(Params m_pm, Header m_hdr);
+
+	// W/E transects: find the shorelines of rows r0 to r1-1 (only these rows of z are read)
+	void addRows(const float *z, const ValidityMask &valid, int r0, int r1);
+
+	// N/S transects: find the shorelines of every column (all rows of z are read)
+	void addColumns(const float *z, const ValidityMask &valid);
+
+	// transects run along rows (W/E) rather than columns (N/S)
+	bool rowTransects() const { return rows; }
+
+	// sorted, disjoint spans of row r where the average is needed
+	const vector<Span> &spans(int r) const { return band[r]; }
 
-	// compute the average relative relief for all 3 scales
-	Raster::avg[index] = accumulate(tmp.begin(), tmp.end(), 0.0)/tmp.size();
+private:
+	Params pm;
+	Header hdr;
+	int buffer;			// edge buffer of main() (radius of the smallest window)
+	int reach;			// pixels the searches can read beyond a start position (0 = no search)
+	bool rows;
+	vector< vector<Span> > band;
+
+	int shoreline(const float *z, const ValidityMask &valid, int t);
+	void add(int r, int c0, int c1);
+};
+
+ShoreBand::ShoreBand(Params m_pm, Header m_hdr) : band(m_hdr.nlines)
+{
+	pm = m_pm;
+	hdr = m_hdr;
+	buffer = pm.scales.radius(0);
+	rows = (pm.transect_direction.compare("W")==0 || pm.transect_direction.compare("E")==0);
+
+	// the shoreline product runs no search on the average relative relief
+	if(pm.oProduct.compare("shoreline")==0){
+		reach = 0;
+	} else{
+		double res = rows ? hdr.xres : hdr.yres;
+		double dist = pm.tDuneDistMax + pm.tCrestDistMax + pm.tHeelDistMax;
+		reach = (dist > 0) ? (int)ceil(dist/res)+2 : 2;
+	}
+}
+
+// position of the shoreline of transect t (row t for W/E, column t for N/S),
+// or -1 if main() finds none
+int ShoreBand::shoreline(const float *z, const ValidityMask &valid, int t){
+	int n = rows ? hdr.ncols : hdr.nlines;
+	bool down = (pm.transect_direction.compare("W")==0 || pm.transect_direction.compare("S")==0);
+	int p;
+
+	for(p = down ? n : 0; down ? p>-1 : p<n; p += down ? -1 : 1){
+		int i = rows ? t : p;
+		int j = rows ? p : t;
+		size_t index1 = (size_t)i*hdr.ncols+j;
+
+		if(i>buffer && i<hdr.nlines-buffer && j>buffer+1 && j<hdr.ncols-buffer-1){
+			if((!valid(i, j+1) || z[index1+1] < pm.tShoreline) && valid(i, j) && z[index1] >= pm.tShoreline){
+				return p;
+			}
+		}
+	}
+	return -1;
+}
+
+// add columns c0 to c1-1 (clipped) to row r; spans must be added in increasing c0
+void ShoreBand::add(int r, int c0, int c1){
+	vector<Span> &s = band[r];
+
+	c0 = (c0 > 0) ? c0 : 0;
+	c1 = (c1 < hdr.ncols) ? c1 : hdr.ncols;
+	if(c0 >= c1){
+		return;
+	}
+	if(!s.empty() && s.back().c1 >= c0){
+		s.back().c1 = (s.back().c1 > c1) ? s.back().c1 : c1;
+	} else{
+		Span sp = {c0, c1};
+		s.push_back(sp);
+	}
+}
+
+void ShoreBand::addRows(const float *z, const ValidityMask &valid, int r0, int r1){
+	int i;
+
+	for(i=r0; i<r1; ++i){
+		// rows outside the edge buffer are never searched
+		if(reach == 0 || i<=buffer || i>=hdr.nlines-buffer){
+			continue;
+		}
+		int s = shoreline(z, valid, i);
+
+		add(i, 0, reach+1);
+		if(s >= 0){
+			add(i, s-reach, s+reach+1);
+		}
+	}
+}
+
+void ShoreBand::addColumns(const float *z, const ValidityMask &valid){
+	int i, j;
+
+	for(j=0; j<hdr.ncols; ++j){
+		// columns outside the edge buffer are never searched
+		if(reach == 0 || j<=buffer+1 || j>=hdr.ncols-buffer-1){
+			continue;
+		}
+		int s = shoreline(z, valid, j);
+
+		for(i=0; i<hdr.nlines; ++i){
+			if(i<=reach || (s >= 0 && i>=s-reach && i<=s+reach)){
+				add(i, j-1, j+2);
+			}
+		}
+	}
+}
+
+
+// The pixels of an incremental run (--update) whose relative relief can differ
+// from that of the previous run: the pixels that changed (in elevation or in
+// being NULL) and every pixel within the largest window radius of one. The
+// relative relief and landform lines of the other pixels, and the metrics of
+// the transects that do not cross the region, are taken from the outputs of
+// the previous run (which used the same parameters).
+class ReliefUpdate
+{
+public:
+	ReliefUpdate(Params m_pm, Header m_hdr);
+
+	// find the pixels that differ from those of the old DEM / that are non-zero
+	// in the mask raster. Returns false if the raster cannot be read.
+	bool diff(string oldName);
+	bool mask(string maskName);
+
+	// load the rasters of the previous run into data and, if metrics are written,
+	// the metrics lines of its transects from csvName. The transects crossing the
+	// region are cleared; all transects are if there is no CSV of the previous
+	// metrics or its lines do not match the shorelines of the previous run.
+	bool loadPrevious(Raster &data, bool metrics, string csvName);
+
+	// sorted, disjoint spans of row r whose relative relief is computed again
+	const vector<Span> &spans(int r) const { return region[r]; }
+
+	// transect t (row t for W/E, column t for N/S) is extracted again
+	bool touched(int t) const { return retouch[t] != 0; }
+
+	// write the metrics line that the previous run gave transect t (if any)
+	void copyMetrics(int t, MetricsWriter &out) const;
+
+	size_t changed;				// pixels that changed
+	size_t recomputed;			// pixels of the region
+	int transects;				// transects extracted again
+
+private:
+	Params pm;
+	Header hdr;
+	bool rows;					// transects run along rows (W/E)
+	vector< vector<Span> > region;
+	vector<unsigned char> retouch;
+	vector<string> previous;	// metrics line of each transect (empty if none)
+
+	// open band of raster fn, which must have the size of the DEM
+	bool openRaster(string fn, Header &h, int band, BandReader &reader);
+	// grow the changed spans of every row by the largest window radius
+	void grow(vector< vector<Span> > &rowsChanged);
+};
+
+ReliefUpdate::ReliefUpdate(Params m_pm, Header m_hdr)
+{
+	pm = m_pm;
+	hdr = m_hdr;
+	rows = (pm.transect_direction.compare("W")==0 || pm.transect_direction.compare("E")==0);
+	changed = 0;
+	recomputed = 0;
+	transects = 0;
+}
+
+bool ReliefUpdate::openRaster(string fn, Header &h, int band, BandReader &reader){
+	if(!h.Initialize(fn)){
+		return false;
+	}
+	if(h.ncols != hdr.ncols || h.nlines != hdr.nlines || band >= h.bands){
+		cout << "ERROR: '" << fn << "' is not a " << hdr.ncols << " x " << hdr.nlines << " raster with " << band+1 << " band(s)" << endl;
+		return false;
+	}
+	h.band = band;
+	if(!reader.open(h.dataFile(fn), h)){
+		cout << "ERROR: Cannot find '" << h.dataFile(fn) << "'" << endl;
+		return false;
+	}
+	return true;
+}
+
+bool ReliefUpdate::diff(string oldName){
+	const int chunk = 64;
+	Header old, cur;
+	BandReader fold, fcur;
+	vector< vector<Span> > rowsChanged(hdr.nlines);
+	int r, i, j;
+
+	if(!openRaster(oldName, old, pm.iBand-1, fold) || !openRaster(pm.iFile, cur, pm.iBand-1, fcur)){
+		return false;
+	}
+	vector<float> a((size_t)chunk*hdr.ncols), b((size_t)chunk*hdr.ncols);
+	for(r=0; r<hdr.nlines; r+=chunk){
+		int r1 = (r+chunk < hdr.nlines) ? r+chunk : hdr.nlines;
+		if(!fold.read(r, r1, a.data()) || !fcur.read(r, r1, b.data())){
+			cout << "ERROR: Cannot read '" << oldName << "' and '" << pm.iFile << "'" << endl;
+			return false;
+		}
+		for(i=r; i<r1; ++i){
+			const float *za = &a[(size_t)(i-r)*hdr.ncols];
+			const float *zb = &b[(size_t)(i-r)*hdr.ncols];
+			for(j=0; j<hdr.ncols; ++j){
+				bool va = za[j] > old.nullFloor() && za[j] != old.nodata;
+				bool vb = zb[j] > cur.nullFloor() && zb[j] != cur.nodata;
+				if(va != vb || (vb && za[j] != zb[j])){
+					Span s = {j, j+1};
+					if(!rowsChanged[i].empty() && rowsChanged[i].back().c1 == j){
+						rowsChanged[i].back().c1 = j+1;
+					} else{
+						rowsChanged[i].push_back(s);
+					}
+					++changed;
+				}
+			}
+		}
+	}
+	grow(rowsChanged);
+	return true;
+}
+
+bool ReliefUpdate::mask(string maskName){
+	const int chunk = 64;
+	Header h;
+	BandReader f;
+	vector< vector<Span> > rowsChanged(hdr.nlines);
+	int r, i, j;
+
+	if(!openRaster(maskName, h, 0, f)){
+		return false;
+	}
+	vector<float> m((size_t)chunk*hdr.ncols);
+	for(r=0; r<hdr.nlines; r+=chunk){
+		int r1 = (r+chunk < hdr.nlines) ? r+chunk : hdr.nlines;
+		if(!f.read(r, r1, m.data())){
+			cout << "ERROR: Cannot read '" << maskName << "'" << endl;
+			return false;
+		}
+		for(i=r; i<r1; ++i){
+			const float *v = &m[(size_t)(i-r)*hdr.ncols];
+			for(j=0; j<hdr.ncols; ++j){
+				if(v[j] != 0 && v[j] > h.nullFloor() && v[j] != h.nodata){
+					Span s = {j, j+1};
+					if(!rowsChanged[i].empty() && rowsChanged[i].back().c1 == j){
+						rowsChanged[i].back().c1 = j+1;
+					} else{
+						rowsChanged[i].push_back(s);
+					}
+					++changed;
+				}
+			}
+		}
+	}
+	grow(rowsChanged);
+	return true;
+}
+
+void ReliefUpdate::grow(vector< vector<Span> > &rowsChanged){
+	int radius = pm.scales.maxRadius();
+	int i, k;
+	size_t s;
+
+	region.assign(hdr.nlines, vector<Span>());
+	for(i=0; i<hdr.nlines; ++i){
+		// widen the spans of the row (merging those that meet) ...
+		vector<Span> wide;
+		for(s=0; s<rowsChanged[i].size(); ++s){
+			Span w = {max(rowsChanged[i][s].c0-radius, 0), min(rowsChanged[i][s].c1+radius, hdr.ncols)};
+			if(!wide.empty() && wide.back().c1 >= w.c0){
+				wide.back().c1 = w.c1;
+			} else{
+				wide.push_back(w);
+			}
+		}
+		// ... and add them to the rows within the radius
+		for(k=max(i-radius, 0); k<=min(i+radius, hdr.nlines-1); ++k){
+			region[k].insert(region[k].end(), wide.begin(), wide.end());
+		}
+	}
+
+	retouch.assign(rows ? hdr.nlines : hdr.ncols, 0);
+	vector<int> cover(hdr.ncols+1, 0);
+	for(i=0; i<hdr.nlines; ++i){
+		vector<Span> &sp = region[i];
+		sort(sp.begin(), sp.end(), spanBefore);
+		vector<Span> merged;
+		for(s=0; s<sp.size(); ++s){
+			if(!merged.empty() && merged.back().c1 >= sp[s].c0){
+				merged.back().c1 = max(merged.back().c1, sp[s].c1);
+			} else{
+				merged.push_back(sp[s]);
+			}
+		}
+		sp.swap(merged);
+		for(s=0; s<sp.size(); ++s){
+			recomputed += sp[s].c1-sp[s].c0;
+			// (N/S: the columns crossed, counted with a difference array)
+			++cover[sp[s].c0];
+			--cover[sp[s].c1];
+		}
+		if(rows && !sp.empty()){
+			retouch[i] = 1;
+		}
+	}
+	if(!rows){
+		int n = 0;
+		for(i=0; i<hdr.ncols; ++i){
+			n += cover[i];
+			retouch[i] = (n > 0) ? 1 : 0;
+		}
+	}
+	transects = (int)count(retouch.begin(), retouch.end(), 1);
+}
+
+bool ReliefUpdate::loadPrevious(Raster &data, bool metrics, string csvName){
+	vector<EnviProduct> products = data.enviProducts(pm.outName(), pm);
+	size_t k, t;
+	int b, r, i, j;
+
+	for(k=0; k<products.size(); ++k){
+		string fn = products[k].name + (pm.tiffOutput() ? ".tif" : "");
+		for(b=0; b<products[k].nbands; ++b){
+			Header h;
+			BandReader f;
+			if(!openRaster(fn, h, b, f)){
+				cout << "ERROR: --update needs the rasters of the previous run" << endl;
+				return false;
+			}
+			if(products[k].relief){
+				// (the products point into data)
+				float *dst = (float*)(products[k].data) + (size_t)b*hdr.npix;
+				if(!f.read(0, hdr.nlines, dst)){
+					cout << "ERROR: Cannot read '" << h.dataFile(fn) << "'" << endl;
+					return false;
+				}
+				continue;
+			}
+			// landform lines, by blocks of rows
+			vector<float> v((size_t)64*hdr.ncols);
+			for(r=0; r<hdr.nlines; r+=64){
+				int r1 = (r+64 < hdr.nlines) ? r+64 : hdr.nlines;
+				if(!f.read(r, r1, v.data())){
+					cout << "ERROR: Cannot read '" << h.dataFile(fn) << "'" << endl;
+					return false;
+				}
+				for(t=0; t<(size_t)(r1-r)*hdr.ncols; ++t){
+					data.lines[(size_t)r*hdr.ncols+t] = (unsigned char)v[t] & data.lineBits;
+				}
+			}
+		}
+	}
+	if(!data.lineBits){
+		return true;
+	}
+
+	// the previous run wrote a metrics line for every transect with a shoreline
+	vector<unsigned char> shore(retouch.size(), 0);
+	for(i=0; i<hdr.nlines; ++i){
+		for(j=0; j<hdr.ncols; ++j){
+			if(data.lines[(size_t)i*hdr.ncols+j] & SHORELINE_BIT){
+				shore[rows ? i : j] = 1;
+			}
+		}
+	}
+	if(metrics){
+		ifstream csv(csvName.c_str());
+		vector<string> lines;
+		string line;
+		getline(csv, line);		// (header)
+		while(getline(csv, line)){
+			lines.push_back(line);
+		}
+		previous.assign(retouch.size(), string());
+		if(csvName.empty() || csv.bad() || lines.size() != (size_t)count(shore.begin(), shore.end(), 1)){
+			cout << "   The CSV metrics of the previous run do not match its transects: every transect is extracted again" << endl;
+			retouch.assign(retouch.size(), 1);
+			transects = (int)retouch.size();
+		} else{
+			for(t=0, k=0; t<shore.size(); ++t){
+				if(shore[t]){
+					previous[t].swap(lines[k++]);
+				}
+			}
+		}
+	}
+
+	// the transects extracted again start without landform lines
+	for(i=0; i<hdr.nlines; ++i){
+		for(j=0; j<hdr.ncols; ++j){
+			if(retouch[rows ? i : j]){
+				data.lines[(size_t)i*hdr.ncols+j] = 0;
+			}
+		}
+	}
+	return true;
+}
+
+void ReliefUpdate::copyMetrics(int t, MetricsWriter &out) const {
+	if(!previous.empty() && !previous[t].empty()){
+		out.copyLine(previous[t]);
+	}
+}
+
+
+//function to compute the relative relief without loading the DEM into memory.
+//Only a ring of rows around the current row is held; each finished row of the
+//kept scales and of the average is written straight to its output .dat, so
+//peak memory depends on the raster width and window size, not the raster size.
+bool streamRelativeRelief(Params pm, Header hdr){
+	int i, j, k;
+	int buffer = pm.scales.radius(0);
+	int nout = pm.oScales;
+	int nbands = nout+1;
+	bool single = (pm.oBands.compare("single")==0);
+
+	// the filters of radius R read rows i-3R to i+3R+1 while producing row i
+	int radius = pm.scales.maxRadius();
+	StreamedRows rows;
+	if(!rows.open(pm.iFile, hdr, 6*radius+3)){
+		return false;
+	}
+	ReliefRows relief(&rows, hdr.ncols, hdr.nlines, pm.scales, 0);
+
+	// one output file per kept scale and the average, or one multi-band file
+	vector<string> names;
+	string bandnames;
+	if(single){
+		names.push_back(pm.outName()+"_rr");
+		for(k=0; k<nout; ++k){
+			bandnames.append("rr"+to_string(pm.scales.window(k))+", ");
+		}
+		bandnames.append("rr_avg");
+	} else{
+		for(k=0; k<nout; ++k){
+			names.push_back(pm.outName()+"_rr"+to_string(pm.scales.window(k)));
+		}
+		names.push_back(pm.outName()+"_rr_avg");
+	}
+
+	vector<ofstream> fout(names.size());
+	vector<TiffWriter> tout(pm.tiffOutput() ? names.size() : 0);
+	for(k=0; k<(int)names.size(); ++k){
+		if(pm.tiffOutput()){
+			if(!tout[k].open(names[k]+".tif", hdr, single ? nbands : 1, false, tiffCompression(pm.oCompress), pm.nThreads, bandnames)){
+				cout << "ERROR: Cannot write relative relief files!" << endl;
+				return false;
+			}
+			continue;
+		}
+		fout[k].open((names[k]+".dat").c_str(), ios::out | ios::binary);
+		if(!fout[k]){
+			cout << "ERROR: Cannot write relative relief files!" << endl;
+			return false;
+		}
+	}
+
+	// one row of every band (kept scales, then the average)
+	vector<float> rowbuf((size_t)nbands*hdr.ncols);
+	vector<float*> out(pm.scales.size(), (float*)NULL);
+	for(k=0; k<nout; ++k){
+		out[k] = &rowbuf[(size_t)k*hdr.ncols];
+	}
+
+	for(i=0; i<hdr.nlines; ++i){
+		relief.nextRow(out.data(), &rowbuf[(size_t)nout*hdr.ncols]);
+
+		for(k=0; k<nbands; ++k){
+			float *band = &rowbuf[(size_t)k*hdr.ncols];
+
+			// IF the center pixel is within the buffer distance to the image edge
+			for(j=0; j<hdr.ncols; ++j){
+				if(i<buffer || i>hdr.nlines-buffer || j<buffer || j>hdr.ncols-buffer){
+					band[j] = -9999;
+				}
+			}
+
+			if(pm.tiffOutput()){
+				tout[single ? 0 : k].writeRows(single ? k : 0, i, i+1, reinterpret_cast<char*>(band));
+			} else if(single){
+				// band sequential: row i of band k
+				fout[0].seekp((((streamoff)k*hdr.nlines)+i)*hdr.ncols*sizeof(float));
+				fout[0].write(reinterpret_cast<char*>(band), hdr.ncols*sizeof(float));
+			} else{
+				fout[k].write(reinterpret_cast<char*>(band), hdr.ncols*sizeof(float));
+			}
+		}
+	}
+
+	hdr.bands = single ? nbands : 1;
+	hdr.bandnames = bandnames;
+	for(k=0; k<(int)names.size(); ++k){
+		if(pm.tiffOutput()){
+			if(!tout[k].close()){
+				cout << "ERROR: Cannot write relative relief files!" << endl;
+				return false;
+			}
+			cout << "Successfully wrote data to GeoTIFF file: " << names[k] << ".tif" << endl;
+			continue;
+		}
+		fout[k].close();
+		hdr.writeHDR(names[k], vector<float>());
+		cout << "Successfully wrote data to binary file: " << names[k] << ".dat" << endl;
+	}
+
+	return true;
+}
+
+
+
+///////////////////////////////////////////////////////////////
+// COLUMN-MAJOR COPIES (N/S TRANSECTS)
+///////////////////////////////////////////////////////////////
+
+// side of the square tiles copied at once: a 64x64 float tile of the source and
+// of the destination (2 x 16 KB) stay in cache while the tile is transposed
+static const int TRANSPOSE_TILE = 64;
+
+// dst = src transposed: value (r, c) of a rows x cols raster goes to dst[c*rows+r],
+// so that every column of src becomes a contiguous run of dst
+static void transposeRaster(const float *src, float *dst, int rows, int cols){
+	int r0, c0, r, c;
+
+	for(r0=0; r0<rows; r0+=TRANSPOSE_TILE){
+		int r1 = (r0+TRANSPOSE_TILE < rows) ? r0+TRANSPOSE_TILE : rows;
+		for(c0=0; c0<cols; c0+=TRANSPOSE_TILE){
+			int c1 = (c0+TRANSPOSE_TILE < cols) ? c0+TRANSPOSE_TILE : cols;
+			for(c=c0; c<c1; ++c){
+				const float *s = src+(size_t)r0*cols+c;
+				float *d = dst+(size_t)c*rows;
+				for(r=r0; r<r1; ++r, s+=cols){
+					d[r] = *s;
+				}
+			}
+		}
+	}
 }
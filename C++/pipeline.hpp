@@ -0,0 +1,716 @@
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+using namespace std;
+
+///////////////////////////////////////////////////////////////
+// PIPELINE PRIMITIVES
+///////////////////////////////////////////////////////////////
+
+// back off while another stage catches up: yield at first, then sleep so that
+// waiting stages do not take CPU time from the relative relief workers
+static void pipelineWait(int &spins){
+	if(++spins < 64){
+		this_thread::yield();
+	} else{
+		this_thread::sleep_for(chrono::microseconds(100));
+	}
+}
+
+// Bounded single-producer/single-consumer queue without locks.
+template<class T>
+class BoundedQueue
+{
+public:
+	BoundedQueue(int capacity) : buf(capacity+1) { head = 0; tail = 0; }
+
+	// returns false if the queue is full / empty
+	bool push(const T &v){
+		size_t t = tail.load(memory_order_relaxed);
+		size_t n = (t+1)%buf.size();
+		if(n == head.load(memory_order_acquire)){
+			return false;
+		}
+		buf[t] = v;
+		tail.store(n, memory_order_release);
+		return true;
+	}
+	bool pop(T &v){
+		size_t h = head.load(memory_order_relaxed);
+		if(h == tail.load(memory_order_acquire)){
+			return false;
+		}
+		v = buf[h];
+		head.store((h+1)%buf.size(), memory_order_release);
+		return true;
+	}
+
+	// push, waiting while the queue is full
+	void put(const T &v){
+		int spins = 0;
+		while(!push(v)){
+			pipelineWait(spins);
+		}
+	}
+
+private:
+	vector<T> buf;
+	atomic<size_t> head;	// next slot to pop
+	atomic<size_t> tail;	// next slot to push
+};
+
+// rows r0 to r1-1 of a raster
+struct RowBlock
+{
+	int r0, r1;
+};
+
+// rows of a raster that is being loaded by the reader stage: row(r) waits until
+// the reader has published row r
+class LoadingRows : public RowSource
+{
+public:
+	LoadingRows(const float *m_z, const ValidityMask *m_mask, int m_ncols, const atomic<int> *m_loaded){ z = m_z; mask = m_mask; ncols = m_ncols; loaded = m_loaded; }
+
+	const float *row(int r){
+		int spins = 0;
+		while(loaded->load(memory_order_acquire) <= r){
+			pipelineWait(spins);
+		}
+		return z+(size_t)r*ncols;
+	}
+	const uint64_t *valid(int r){
+		row(r);
+		return mask->row(r);
+	}
+
+private:
+	const float *z;
+	const ValidityMask *mask;
+	int ncols;
+	const atomic<int> *loaded;
+};
+
+
+
+///////////////////////////////////////////////////////////////
+// WORK-STEALING POOL (BATCH MODE)
+///////////////////////////////////////////////////////////////
+
+// Runs the DEM tiles of a batch on a fixed set of worker threads. Each idle
+// worker starts the next tile; the pipeline of a tile queues its relative
+// relief row blocks on the deque of the worker that runs the tile. Workers
+// run the blocks of their own deque first and steal blocks from the other
+// deques before they start another tile, so the threads move between tiles
+// and between the row blocks of large tiles as the load requires. A worker
+// that waits for relief rows (waitRelief, finish) runs queued blocks meanwhile;
+// it never starts a tile while waiting, so the wait always ends.
+// Blocks are taken oldest first (also when stolen): the blocks of a tile are
+// queued top to bottom, which is the order its landforms and writer need them.
+class WorkPool
+{
+public:
+	WorkPool(int m_nthreads) : deques(m_nthreads > 0 ? m_nthreads : 1) { running = 0; queued = 0; }
+
+	int size() const { return deques.size(); }
+
+	// queue a tile (started in order by idle workers)
+	void addTile(function<void()> task){ tiles.push_back(task); }
+
+	// queue a row block on the deque of the calling worker
+	void addBlock(function<void()> task){
+		Tasks &d = deques[(self() >= 0) ? self() : 0];
+		lock_guard<mutex> g(d.lock);
+		d.tasks.push_back(task);
+		++queued;
+	}
+
+	// run one queued row block; returns false if none is queued
+	bool helpOne(){
+		function<void()> task;
+		int w = (self() >= 0) ? self() : 0;
+		size_t k;
+
+		for(k=0; k<deques.size(); ++k){
+			Tasks &d = deques[(w+k)%deques.size()];
+			lock_guard<mutex> g(d.lock);
+			if(!d.tasks.empty()){
+				task = d.tasks.front();
+				d.tasks.pop_front();
+				--queued;
+				break;
+			}
+		}
+		if(!task){
+			return false;
+		}
+		task();
+		return true;
+	}
+
+	// run every tile and return once all of them are finished
+	void run(){
+		vector<thread> workers;
+		size_t t;
+
+		for(t=0; t<deques.size(); ++t){
+			workers.push_back(thread(&WorkPool::worker, this, (int)t));
+		}
+		for(t=0; t<workers.size(); ++t){
+			workers[t].join();
+		}
+	}
+
+private:
+	struct Tasks
+	{
+		mutex lock;
+		deque< function<void()> > tasks;
+	};
+	vector<Tasks> deques;			// row blocks queued by each worker
+
+	mutex tileLock;
+	deque< function<void()> > tiles;
+	atomic<int> running;			// tiles started but not finished
+	atomic<int> queued;				// row blocks in the deques
+
+	// index of the calling worker thread (-1 outside the pool)
+	static int &self(){
+		static thread_local int w = -1;
+		return w;
+	}
+
+	void worker(int w){
+		int spins = 0;
+
+		self() = w;
+		while(true){
+			if(helpOne()){
+				spins = 0;
+				continue;
+			}
+
+			function<void()> tile;
+			{
+				lock_guard<mutex> g(tileLock);
+				if(!tiles.empty()){
+					tile = tiles.front();
+					tiles.pop_front();
+					++running;
+				}
+			}
+			if(tile){
+				tile();
+				--running;
+				spins = 0;
+				continue;
+			}
+
+			// nothing to start: done once no tile can queue more blocks
+			if(running.load() == 0 && queued.load() == 0){
+				break;
+			}
+			pipelineWait(spins);
+		}
+		self() = -1;
+	}
+};
+
+
+
+///////////////////////////////////////////////////////////////
+// STAGED PIPELINE (READ -> RELATIVE RELIEF -> LANDFORMS -> WRITE)
+///////////////////////////////////////////////////////////////
+
+// Runs the stages of main() concurrently on row blocks:
+//   reader      loads the DEM rows in order (reads them, or touches the mapped
+//               pages) and publishes how many rows are loaded
+//   RR workers  take blocks of rows from a shared counter and compute the
+//               relative relief of each row as soon as its window rows are loaded
+//   landforms   main() extracts the transects, waiting in waitRelief() for the
+//               RR rows it needs and handing finished rows to landformRows()
+//   writer      hands every output raster row block to the I/O threads of an
+//               AsyncWriter (or compresses its GeoTIFF tiles) as soon as it is final
+// Each block is computed by a single worker exactly as in the unpipelined
+// code, so the output does not depend on timing or on the number of threads.
+// With --shore-band the reader also finds the shoreline band of the loaded rows
+// and the workers compute the average relative relief only within it.
+// In batch mode the row blocks are tasks of the WorkPool instead of being taken
+// by RR worker threads of the pipeline. In a mosaic (halo not NULL) the relative
+// relief is computed on the rows extended by the halo of the neighbouring tiles,
+// and only the pixels near the edge of the mosaic are masked. In an incremental
+// run (update not NULL) the relative relief of the previous run is already in
+// data and the workers only compute it within the spans of the update. When
+// the relative relief is mapped from the cache (data->rr.mapped()) it is final
+// from the start and no blocks are computed.
+class Pipeline
+{
+public:
+	Pipeline(Raster *m_data, Params m_pm, Header m_hdr, WorkPool *m_tasks = NULL, const TileHalo *m_halo = NULL, const ReliefUpdate *m_update = NULL);
+
+	// start the reader, relative relief and writer stages
+	void start();
+
+	// block until the relative relief of rows 0 to r-1 is final
+	void waitRelief(int r);
+
+	// hand rows r0 to r1-1 of the landform lines to the writer (in order)
+	void landformRows(int r0, int r1){ RowBlock b = {r0, r1}; queue.put(b); }
+
+	// hand the remaining landform rows to the writer and wait for all stages to
+	// finish. Returns false if the DEM could not be read or an output raster
+	// could not be written.
+	bool finish();
+
+private:
+	Raster *data;
+	Params pm;
+	Header hdr;
+	int buffer;
+
+	// reader -> RR workers
+	atomic<int> loaded;
+	ShoreBand band;					// pixels that need relative relief (--shore-band)
+	atomic<int> banded;				// rows whose band is final
+
+	// RR workers -> landforms/writer: rows finished within each block
+	int blockRows, nblocks;
+	atomic<int> nextBlock;
+	vector< atomic<int> > blockDone;
+	atomic<int> reliefFront;		// rows 0 to reliefFront-1 are final
+
+	// landforms -> writer
+	BoundedQueue<RowBlock> queue;
+
+	vector<EnviProduct> products;	// ENVI rasters to write
+	bool landforms;					// landform lines are written
+
+	vector<thread> pool;
+	atomic<bool> failed;			// a stage hit a read or write error
+	WorkPool *tasks;				// runs the row blocks (batch mode), or NULL
+	const TileHalo *halo;			// neighbouring tiles (mosaic), or NULL
+	const ReliefUpdate *update;		// pixels to compute again (incremental run), or NULL
+
+	void reader();
+	void reliefWorker();
+	void bandWorker();
+	void reliefBlock(int b, vector<float*> &out);
+	void bandBlock(int b, vector<float*> &out, vector<float> &avg);
+	void writer();
+	int reliefReady();
+};
+
+Pipeline::Pipeline(Raster *m_data, Params m_pm, Header m_hdr, WorkPool *m_tasks, const TileHalo *m_halo, const ReliefUpdate *m_update) : band(m_pm, m_hdr), blockDone(0), queue(64)
+{
+	size_t k;
+
+	data = m_data;
+	tasks = m_tasks;
+	halo = m_halo;
+	update = m_update;
+	pm = m_pm;
+	hdr = m_hdr;
+	buffer = pm.scales.radius(0);
+
+	// about 4 blocks per worker to balance the load, but at least 2 windows tall
+	// so that the rows a block spends filling its filters stay a small fraction
+	int w = 2*pm.scales.maxRadius()+1;
+	int nthreads = (pm.nThreads > 0) ? pm.nThreads : 1;
+	blockRows = (hdr.nlines+4*nthreads-1)/(4*nthreads);
+	// (band blocks are kept short so that the band spans of their rows stay narrow)
+	int maxRows = pm.shoreBand ? 4*w : 16*w;
+	if(blockRows < 2*w){
+		blockRows = 2*w;
+	} else if(blockRows > maxRows){
+		blockRows = maxRows;
+	}
+	nblocks = (hdr.nlines+blockRows-1)/blockRows;
+	vector< atomic<int> >(nblocks).swap(blockDone);
+	for(k=0; k<blockDone.size(); ++k){
+		blockDone[k] = 0;
+	}
+	// (cached relief: every block is done and none is left to compute; the rows
+	// are final once they are loaded, see reliefReady)
+	if(data->rr.mapped()){
+		for(k=0; k<blockDone.size(); ++k){
+			blockDone[k] = min(blockRows, hdr.nlines-(int)k*blockRows);
+		}
+		nblocks = 0;
+	}
+
+	loaded = 0;
+	failed = false;
+	// (the spans of an update are known before the rows are loaded)
+	banded = update ? hdr.nlines : 0;
+	nextBlock = 0;
+	reliefFront = 0;
+
+	// output ENVI format rasters (if requested by user input)
+	if(pm.oFormat.compare("envi")==0 || pm.oFormat.compare("both")==0 || pm.oProduct.compare("rr")==0){
+		products = data->enviProducts(pm.outName(), pm);
+	}
+	landforms = false;
+	for(k=0; k<products.size(); ++k){
+		landforms = landforms || !products[k].relief;
+	}
+}
+
+void Pipeline::start(){
+	int t;
+
+	pool.push_back(thread(&Pipeline::reader, this));
+	if(tasks){
+		// one task per block (each with its own output pointers)
+		for(t=0; t<nblocks; ++t){
+			tasks->addBlock([this, t](){
+				vector<float*> out(pm.scales.size(), (float*)NULL);
+				vector<float> avg;
+				if(pm.shoreBand || update){
+					avg.resize(hdr.ncols);
+					bandBlock(t, out, avg);
+				} else{
+					reliefBlock(t, out);
+				}
+			});
+		}
+	} else{
+		for(t=0; t<pm.nThreads && nblocks>0; ++t){
+			pool.push_back(thread((pm.shoreBand || update) ? &Pipeline::bandWorker : &Pipeline::reliefWorker, this));
+		}
+	}
+	pool.push_back(thread(&Pipeline::writer, this));
+}
+
+bool Pipeline::finish(){
+	size_t t;
+
+	if(landforms){
+		// end marker: every landform row not handed over yet is final now
+		RowBlock b = {hdr.nlines, hdr.nlines};
+		queue.put(b);
+	}
+	// (in batch mode this thread helps with the blocks the writer still waits for)
+	if(tasks){
+		waitRelief(hdr.nlines);
+	}
+	for(t=0; t<pool.size(); ++t){
+		pool[t].join();
+	}
+
+	return !failed;
+}
+
+void Pipeline::reader(){
+	const int chunk = 64;
+	Header stats = hdr;
+	int r;
+
+	for(r=0; r<hdr.nlines; r+=chunk){
+		int r1 = (r+chunk < hdr.nlines) ? r+chunk : hdr.nlines;
+		// (the rows are still handed on after an error, so the other stages finish)
+		if(!data->loadRows(stats, r, r1) && !failed.exchange(true)){
+			cout << "ERROR: Cannot read rows " << r << " to " << r1-1 << " of the DEM (file too short?)" << endl;
+		}
+		loaded.store(r1, memory_order_release);
+
+		// W/E shorelines only need their own row
+		if(pm.shoreBand && band.rowTransects()){
+			band.addRows(data->z.data(), data->valid, r, r1);
+			banded.store(r1, memory_order_release);
+		}
+	}
+	if(pm.shoreBand && !band.rowTransects()){
+		band.addColumns(data->z.data(), data->valid);
+		banded.store(hdr.nlines, memory_order_release);
+	}
+	data->printInfo(stats);
+}
+
+void Pipeline::reliefWorker(){
+	vector<float*> out(pm.scales.size(), (float*)NULL);
+	int b;
+
+	while((b = nextBlock.fetch_add(1)) < nblocks){
+		reliefBlock(b, out);
+	}
+}
+
+// relative relief of the rows of block b
+void Pipeline::reliefBlock(int b, vector<float*> &out){
+	LoadingRows rows(data->z.data(), &data->valid, hdr.ncols, &loaded);
+	int r0 = b*blockRows;
+	int r1 = (r0+blockRows < hdr.nlines) ? r0+blockRows : hdr.nlines;
+	int i, k;
+
+	if(halo){
+		// the relief of the extended rows goes to row buffers, from which the
+		// columns of the tile are copied
+		HaloRows ext(&rows, halo, 6*pm.scales.maxRadius()+4);
+		ReliefRows relief(&ext, halo->width(), halo->height(), pm.scales, r0+halo->top);
+		int nk = data->rr.nscales();
+		size_t w = halo->width();
+		vector<float> line((nk+1)*w);
+
+		for(k=0; k<nk; ++k){
+			out[k] = &line[k*w];
+		}
+		for(i=r0; i<r1; ++i){
+			size_t index = (size_t)i*hdr.ncols;
+			relief.nextRow(out.data(), &line[nk*w]);
+			for(k=0; k<=nk; ++k){
+				const float *src = &line[k*w+halo->left];
+				copy(src, src+hdr.ncols, ((k < nk) ? data->rr.scale(k) : data->rr.average())+index);
+			}
+			data->maskReliefEdges(buffer, hdr, i, i+1, &halo->frame);
+
+			blockDone[b].store(i+1-r0, memory_order_release);
+		}
+		return;
+	}
+
+	ReliefRows relief(&rows, hdr.ncols, hdr.nlines, pm.scales, r0);
+	for(i=r0; i<r1; ++i){
+		size_t index = (size_t)i*hdr.ncols;
+		for(k=0; k<data->rr.nscales(); ++k){
+			out[k] = data->rr.scale(k)+index;
+		}
+		relief.nextRow(out.data(), data->rr.average()+index);
+		data->maskReliefEdges(buffer, hdr, i, i+1);
+
+		blockDone[b].store(i+1-r0, memory_order_release);
+	}
+}
+
+// same as reliefWorker, but only the average relative relief within the shoreline
+// band is computed; every other pixel of the average is NULL (-9999). Each span of
+// the band is computed on a column window widened by the largest window radius,
+// which gives exactly the values of the full computation.
+void Pipeline::bandWorker(){
+	vector<float*> out(pm.scales.size(), (float*)NULL);
+	vector<float> avg(hdr.ncols);
+	int b;
+
+	while((b = nextBlock.fetch_add(1)) < nblocks){
+		bandBlock(b, out, avg);
+	}
+}
+
+// relative relief within the shoreline band (only the average) or within the
+// spans of the update of the rows of block b
+void Pipeline::bandBlock(int b, vector<float*> &out, vector<float> &avg){
+	LoadingRows rows(data->z.data(), &data->valid, hdr.ncols, &loaded);
+	int halo_w = pm.scales.maxRadius();
+	int r0 = b*blockRows;
+	int r1 = (r0+blockRows < hdr.nlines) ? r0+blockRows : hdr.nlines;
+	int i, k;
+	int nk = data->rr.nscales();
+	size_t s;
+
+	// the rows the windows read: the tile's, or in a mosaic the rows extended by
+	// the halo (dx columns left and dy rows above the tile)
+	HaloRows *ext = halo ? new HaloRows(&rows, halo, 6*halo_w+4) : NULL;
+	RowSource *src = halo ? (RowSource*)ext : (RowSource*)&rows;
+	int width = halo ? halo->width() : hdr.ncols;
+	int height = halo ? halo->height() : hdr.nlines;
+	int dx = halo ? halo->left : 0;
+	int dy = halo ? halo->top : 0;
+	if(halo && (int)avg.size() < width){
+		avg.resize(width);
+	}
+
+	int spins = 0;
+	while(banded.load(memory_order_acquire) < r1){
+		pipelineWait(spins);
+	}
+
+	// the spans of every row of the block, merged where computing the gap
+	// costs less than computing a second halo
+	vector<Span> spans;
+	for(i=r0; i<r1; ++i){
+		const vector<Span> &sp = update ? update->spans(i) : band.spans(i);
+		spans.insert(spans.end(), sp.begin(), sp.end());
+	}
+	sort(spans.begin(), spans.end(), spanBefore);
+	vector<Span> merged;
+	for(s=0; s<spans.size(); ++s){
+		if(!merged.empty() && spans[s].c0 <= merged.back().c1+2*halo_w){
+			merged.back().c1 = (merged.back().c1 > spans[s].c1) ? merged.back().c1 : spans[s].c1;
+		} else{
+			merged.push_back(spans[s]);
+		}
+	}
+
+	float *average = data->rr.average();
+	if(!update){
+		fill(average+(size_t)r0*hdr.ncols, average+(size_t)r1*hdr.ncols, -9999.0f);
+	}
+
+	for(s=0; s<merged.size(); ++s){
+		int c0 = merged[s].c0+dx, c1 = merged[s].c1+dx;
+		int a = (c0-halo_w > 0) ? c0-halo_w : 0;
+		int e = (c1+halo_w < width) ? c1+halo_w : width;
+		ColumnWindow win(src, a, e-a);
+		ReliefRows relief(&win, e-a, height, pm.scales, r0+dy);
+		vector<float> kept((size_t)nk*(e-a));
+
+		for(k=0; k<nk; ++k){
+			out[k] = &kept[(size_t)k*(e-a)];
+		}
+		for(i=r0; i<r1; ++i){
+			size_t index = (size_t)i*hdr.ncols+merged[s].c0;
+			relief.nextRow(out.data(), avg.data());
+			copy(avg.begin()+(c0-a), avg.begin()+(c1-a), average+index);
+			for(k=0; k<nk; ++k){
+				copy(out[k]+(c0-a), out[k]+(c1-a), data->rr.scale(k)+index);
+			}
+		}
+	}
+	data->maskReliefEdges(buffer, hdr, r0, r1, halo ? &halo->frame : NULL);
+	delete ext;
+
+	blockDone[b].store(r1-r0, memory_order_release);
+}
+
+// rows 0 to n-1 whose relative relief is final
+int Pipeline::reliefReady(){
+	int front = reliefFront.load(memory_order_acquire);
+
+	while(front < hdr.nlines){
+		int b = front/blockRows;
+		int done = b*blockRows + blockDone[b].load(memory_order_acquire);
+		if(done <= front){
+			break;
+		}
+		front = done;
+	}
+	// cached relief goes with the elevations the landforms read
+	if(data->rr.mapped()){
+		int rows = loaded.load(memory_order_acquire);
+		front = (front < rows) ? front : rows;
+	}
+	// several threads may advance the front; it only ever grows
+	int cur = reliefFront.load(memory_order_relaxed);
+	while(cur < front && !reliefFront.compare_exchange_weak(cur, front)){}
+
+	return front;
+}
+
+void Pipeline::waitRelief(int r){
+	int spins = 0;
+
+	while(reliefReady() < r){
+		if(tasks && tasks->helpOne()){
+			spins = 0;
+			continue;
+		}
+		pipelineWait(spins);
+	}
+}
+
+void Pipeline::writer(){
+	AsyncWriter fout;
+	vector<TiffWriter> tout(pm.tiffOutput() ? products.size() : 0);
+	vector<string> names;
+	int rrDone = 0, lfDone = landforms ? 0 : hdr.nlines;
+	int spins = 0;
+	size_t k;
+	int b;
+
+	for(k=0; k<products.size(); ++k){
+		if(pm.tiffOutput()){
+			// the tiles are compressed on as many threads as relative relief uses
+			// (on one per tile in batch mode, where the tiles run in parallel)
+			if(!tout[k].open(products[k].name+".tif", hdr, products[k].nbands, !products[k].relief, tiffCompression(pm.oCompress), tasks ? 1 : pm.nThreads, products[k].bandnames)){
+				cout << "ERROR: Cannot write " << products[k].name << ".tif" << endl;
+				failed = true;
+			}
+		} else{
+			names.push_back(products[k].name+".dat");
+		}
+	}
+	// the row blocks are handed to a few I/O threads (they mostly wait on the
+	// disk), so this stage goes straight back to polling for finished rows
+	if(!pm.tiffOutput() && !fout.open(names, (names.size() < 4) ? names.size() : 4)){
+		cout << "ERROR: Cannot write ENVI data files!" << endl;
+		failed = true;
+	}
+
+	while(rrDone < hdr.nlines || lfDone < hdr.nlines){
+		RowBlock blk;
+		bool relief = false;
+
+		// newly finished relative relief rows, otherwise landform rows
+		int ready = reliefReady();
+		if(ready > rrDone){
+			blk.r0 = rrDone;
+			blk.r1 = ready;
+			rrDone = ready;
+			relief = true;
+		} else if(queue.pop(blk)){
+			if(blk.r0 >= hdr.nlines){
+				blk.r0 = lfDone;
+				blk.r1 = hdr.nlines;
+			}
+			lfDone = blk.r1;
+		} else{
+			pipelineWait(spins);
+			continue;
+		}
+		spins = 0;
+
+		// after an error the rows are still taken (the landform stage waits for
+		// room in the queue) but no longer written
+		if(failed){
+			continue;
+		}
+		for(k=0; k<products.size(); ++k){
+			if(products[k].relief != relief){
+				continue;
+			}
+			for(b=0; b<products[k].nbands; ++b){
+				// band sequential: rows r0 to r1-1 of band b
+				size_t off = ((size_t)b*hdr.nlines+blk.r0)*hdr.ncols*products[k].valueSize();
+				if(pm.tiffOutput()){
+					tout[k].writeRows(b, blk.r0, blk.r1, products[k].data+off);
+					continue;
+				}
+				fout.write(k, off, products[k].data+off, (size_t)(blk.r1-blk.r0)*hdr.ncols*products[k].valueSize());
+			}
+		}
+	}
+
+	if(!pm.tiffOutput() && !fout.finish() && !failed.exchange(true)){
+		cout << "ERROR: Cannot write ENVI data files!" << endl;
+	}
+	if(failed){
+		return;
+	}
+	for(k=0; k<products.size(); ++k){
+		if(pm.tiffOutput()){
+			if(!tout[k].close()){
+				cout << "ERROR: Cannot write " << products[k].name << ".tif" << endl;
+				failed = true;
+				continue;
+			}
+			cout << "Successfully wrote data to GeoTIFF file: " << products[k].name << ".tif" << endl;
+			cout << endl;
+			continue;
+		}
+		// multi-band products describe their own bands
+		hdr.bands = products[k].nbands;
+		hdr.bandnames = products[k].bandnames;
+		if(products[k].relief){
+			hdr.writeHDR(products[k].name, vector<float>());
+		} else{
+			hdr.writeHDR(products[k].name, vector<unsigned int>());
+		}
+		cout << "Successfully wrote data to binary file: " << products[k].name << ".dat" << endl;
+		cout << endl;
+	}
+}
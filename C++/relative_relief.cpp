@@ -1,16 +1,22 @@
 /*
  * The purpose of this program is to import a DEM and perform simple statistical
  * and geospatial analysis. The program requires the following inputs:
- * 		1) Input filename (excluding extension)
+ * 		1) Input filename (excluding extension, or a .tif GeoTIFF)
+ * 			(optionally "iBand" picks the band of a multi-band file)
  *
  * 		2) window size to calculate statistics
+ * 			(optionally "iScales" lists every window size and "iWeights" the
+ * 			weight of each in the average; by default 9 scales are used:
+ * 			window size, window size + 2, ..., window size + 16, equally weighted)
  *
  * 		3) desired product:
- * 			rr --> outputs relative relief at 3 scales:
+ * 			rr --> outputs relative relief at the first 3 scales ("oScales"):
  * 							initial window size
  *							initial window size + 2
  *							initial window size + 4
- *							average relative relief of all 3 scales
+ *							average relative relief of all scales
+ * 					as one ENVI file per scale, or as one multi-band
+ * 					ENVI file with "oBands single"
  *
  * 			shoreline --> outputs shoreline
  * 			dunetoe --> outputs dune toe
@@ -18,6 +24,8 @@
  * 			duneheel --> outputs dune heel
  * 			backbarrier --> outputs backbarrier
  * 			landforms --> outputs all geomorphic feature parameters
+ * 					(the ENVI landform lines are one uint8 raster with one
+ * 					bit per landform, see LandformBit)
  *
  * 			all --> outputs all products
  *
@@ -27,6 +35,32 @@
  *
  * 			both --> output both ascii and ENVI files
  *
+ * 			(the rasters are written as tiled GeoTIFFs instead of ENVI files
+ * 			with "oRaster gtiff", compressed as set by "oCompress"; the ascii
+ * 			metrics are written as an Apache Arrow file, with nulls for missing
+ * 			values, instead of or next to the CSV with "oMetrics arrow" or "both")
+ *
+ * 	The relative relief is computed on all CPU cores by default; use
+ * 	"--threads N" to limit the number of threads. With "--stream" (rr product
+ * 	only) the DEM is read row by row instead of being loaded into memory. With
+ * 	"--shore-band" (landform products only) the relative relief is only computed
+ * 	within reach of each transect's shoreline. "--batch tiles.txt" (or a quoted
+ * 	file name pattern) processes every listed DEM with the same parameters in
+ * 	one run and merges their landform metrics into one file; with "--mosaic"
+ * 	the tiles are placed by their map info and the relative relief is computed
+ * 	across the tile edges as if the tiles were one raster.
+ * 	"--update old_DEM" (or "--update-mask mask") updates the outputs of the
+ * 	previous run after the DEM was patched: only the relative relief near the
+ * 	changed pixels and the transects crossing them are computed again.
+ * 	"--rr-cache dir" keeps the relative relief of each DEM in dir, keyed by a
+ * 	hash of the DEM and the window sizes, and reuses it in later runs.
+ * 	"--sweep sets.txt" computes the relative relief once and extracts the
+ * 	landforms for every threshold set of the file, writing one line of mean
+ * 	metrics per set.
+ * 	"--check-kernels" (on its own) runs every SIMD kernel set the CPU supports
+ * 	on synthetic rows and reports whether each matches the scalar kernels bit
+ * 	for bit.
+ *
  * 	Example Usage:
  * 		program.exe sample_ENVI_raster_filename 25 all both
  *		program.exe sample_ENVI_raster_filename 11 rr envi
@@ -40,12 +74,14 @@
 
 // include the appropriate libraries
 #include <algorithm>
+#include <chrono>
 #include <iostream>
 #include <fstream>
 #include <stdlib.h>
 #include <math.h>
 #include <string.h>
 #include <vector>
+#include <thread>
 
 // library with data structure objects
 #include "data_structures.hpp"
@@ -53,91 +89,311 @@
 // library with miscellaneous functions
 #include "misc_funct.hpp"
 
+// staged pipeline (reader, relative relief, writer)
+#include "pipeline.hpp"
+
+// batch mode (many DEM tiles on a work-stealing pool)
+#include "batch.hpp"
+
+// threshold sweep (many parameter sets over one relative relief)
+#include "sweep.hpp"
+
 using namespace std;
 
+static bool processDEM(Params prms, BatchTile *tile);
+static int runBatch(Params prms, string spec, bool mosaic);
+
+// add the landform metrics columns of the requested product and write the header line
+static void metricsColumns(MetricsWriter &metrics, const Params &prms){
+	metrics.column("ycoordinate");
+	if(prms.oProduct.compare("landforms")==0 || prms.oProduct.compare("all")==0){
+		metrics.landformColumns("shoreline");
+		metrics.landformColumns("dunetoe");
+		metrics.landformColumns("dunecrest");
+		metrics.landformColumns("duneheel");
+		metrics.landformColumns("backbarrier");
+		metrics.column("beach_width", true);
+		metrics.column("beach_vol", true);
+		metrics.column("dune_height", true);
+		metrics.column("dune_vol", true);
+		metrics.column("island_width", true);
+		metrics.column("island_volume", true);
+	} else{
+		metrics.landformColumns(prms.oProduct);
+	}
+	metrics.header();
+}
+
 // MAIN PROGRAM
-int main (){
+int main (int argc, char *argv[]){
 	Params prms;
-	Header hdr;
 
 	//indexing variables
-	register int i, j, k;
+	register int i;
 
-	//projection information
-	double utm_east, utm_north;
-	int utm_zone;
+	// manifest or glob of the DEM tiles (batch mode), processed as one mosaic
+	string batch;
+	bool mosaic = false;
+
+	// compare the SIMD kernels with the scalar ones (needs no parameters)
+	if(argc == 2 && strcmp(argv[1], "--check-kernels")==0){
+		return rrKernelsCheck() ? 0 : 1;
+	}
 
 	//load in the parameters for the program
 	if (!prms.Initialize()) return false;
 
+	//command line options
+	for(i=1; i<argc; ++i){
+		if(strcmp(argv[i], "--threads")==0 && i+1<argc){
+			prms.nThreads = atoi(argv[++i]);
+		} else if(strcmp(argv[i], "--stream")==0){
+			prms.stream = true;
+		} else if(strcmp(argv[i], "--no-mmap")==0){
+			prms.mmapInput = false;
+		} else if(strcmp(argv[i], "--shore-band")==0){
+			prms.shoreBand = true;
+		} else if(strcmp(argv[i], "--batch")==0 && i+1<argc){
+			batch = argv[++i];
+		} else if(strcmp(argv[i], "--mosaic")==0){
+			mosaic = true;
+		} else if(strcmp(argv[i], "--update")==0 && i+1<argc){
+			prms.updateDEM = argv[++i];
+		} else if(strcmp(argv[i], "--update-mask")==0 && i+1<argc){
+			prms.updateMask = argv[++i];
+		} else if(strcmp(argv[i], "--rr-cache")==0 && i+1<argc){
+			prms.rrCache = argv[++i];
+		} else if(strcmp(argv[i], "--sweep")==0 && i+1<argc){
+			prms.sweep = argv[++i];
+		} else{
+			cout << "ERROR: Unknown option '" << argv[i] << "'" << endl;
+			cout << "Usage: " << argv[0] << " [--threads N] [--stream] [--no-mmap] [--shore-band] [--batch MANIFEST|'GLOB' [--mosaic]] [--update OLD_DEM|--update-mask MASK] [--rr-cache DIR] [--sweep SETS] | --check-kernels" << endl;
+			exit(1);
+		}
+	}
+	if(prms.nThreads <= 0){
+		prms.nThreads = thread::hardware_concurrency();
+		if(prms.nThreads <= 0) prms.nThreads = 1;
+	}
+
+	// an incremental run reads the relative relief rasters of the previous run
+	if(prms.incremental()){
+		if(!prms.updateDEM.empty() && !prms.updateMask.empty()){
+			cout << "ERROR: --update and --update-mask cannot be used together" << endl;
+			exit(1);
+		}
+		if(prms.stream || prms.shoreBand || !batch.empty()){
+			cout << "ERROR: --update is not available with --stream, --shore-band or --batch" << endl;
+			exit(1);
+		}
+		if(!prms.reliefOutput() || (prms.oProduct.compare("all")==0 && prms.oFormat.compare("ascii")==0)){
+			cout << "ERROR: --update needs the relative relief rasters: oProduct 'rr', or 'all' with oFormat 'envi' or 'both'" << endl;
+			exit(1);
+		}
+	}
+
+	// cache entries hold the relative relief of a whole DEM on its own
+	if(!prms.rrCache.empty() && (prms.stream || prms.incremental() || mosaic)){
+		cout << "ERROR: --rr-cache is not available with --stream, --update or --mosaic" << endl;
+		exit(1);
+	}
+
+	// a sweep extracts every landform for each set and writes only its table
+	if(!prms.sweep.empty()){
+		if(prms.stream || prms.shoreBand || prms.incremental() || !batch.empty()){
+			cout << "ERROR: --sweep is not available with --stream, --shore-band, --update or --batch" << endl;
+			exit(1);
+		}
+		if(prms.transect_direction.compare("W")!=0 && prms.transect_direction.compare("E")!=0
+				&& prms.transect_direction.compare("N")!=0 && prms.transect_direction.compare("S")!=0){
+			cout << "ERROR: --sweep needs a transect_direction of W, E, N or S" << endl;
+			exit(1);
+		}
+		prms.oProduct = "landforms";
+		prms.oFormat = "ascii";
+	}
+
+	if(!batch.empty()){
+		if(prms.stream){
+			cout << "ERROR: --stream is not available with --batch" << endl;
+			exit(1);
+		}
+		return runBatch(prms, batch, mosaic);
+	}
+	if(mosaic){
+		cout << "ERROR: --mosaic needs --batch" << endl;
+		exit(1);
+	}
+
+	return processDEM(prms, NULL) ? 0 : 1;
+}
+
+// process the DEM prms.iFile. In batch mode (tile not NULL) the relative relief
+// row blocks are tasks of the batch pool and the landform metrics are kept in
+// tile->metrics. Returns false if the DEM cannot be processed.
+static bool processDEM(Params prms, BatchTile *tile){
+	Header hdr;
+
 	//load in the header information from the input file (pulled from the Params info
 	if (!hdr.Initialize(prms.iFile)) return false;
 
-	// based on the specified window size, determine the buffer radius
-	int buffer = (prms.iWindowSize-1)/2;
+	// band of the input file that holds the elevations
+	if(prms.iBand < 1 || prms.iBand > hdr.bands){
+		cout << "ERROR: Invalid iBand --> " << prms.iFile << " has " << hdr.bands << " band(s)!" << endl;
+		return false;
+	}
+	hdr.band = prms.iBand-1;
+	if(tile){
+		tile->ncols = hdr.ncols;
+		tile->nlines = hdr.nlines;
+	}
+
+	// based on the smallest window size, determine the buffer radius
+	int buffer = prms.scales.radius(0);
+
+	// out-of-core mode: stream the DEM row by row and write the RR rasters as rows finish
+	if(prms.stream){
+		if(prms.oProduct.compare("rr")!=0){
+			cout << "ERROR: --stream is only available when oProduct is 'rr'" << endl;
+			exit(1);
+		}
+		cout << "Streaming relative relief (kernels: " << rrKernels().name << ")" << endl;
+		if(!streamRelativeRelief(prms, hdr)) return false;
+		cout << "   Processing successful!\n" << endl;
+		return true;
+	}
+
+	// the relative relief rasters need every pixel
+	if(prms.shoreBand && prms.reliefOutput()){
+		cout << "ERROR: --shore-band is not available when oProduct is 'rr' or 'all'" << endl;
+		exit(1);
+	}
+
+	// threshold sweep: the parameter sets evaluated over the relative relief
+	ThresholdSweep sweep;
+	if(!prms.sweep.empty() && !sweep.load(prms.sweep, prms)){
+		return false;
+	}
 
-	// Import DEM as Raster object
+	// Import DEM as Raster object (the rows are loaded by the pipeline)
 	Raster data;
-	data.Initialize(prms, hdr);
+	// (only the average relative relief is kept unless the RR rasters are written)
+	data.Init(hdr.npix, prms.reliefOutput() ? prms.oScales : 0, prms.landformBits());
+	if(!data.openDAT(prms.iFile, hdr, prms.mmapInput)){
+		cout << "Input filename: " << prms.iFile << endl;
+		cout << "ERROR: Cannot find '" << hdr.dataFile(prms.iFile) << "'" << endl;
+		return false;
+	}
 
 	// Define threshold values
 	string shoreline_indicator, default_threshold_values;
 
-	// output ASCII file pointer
-	FILE *landforms_metrics;
+	// output ASCII file (kept in memory for the merged batch file)
+	MetricsWriter own_metrics;
+	MetricsWriter &landforms_metrics = tile ? tile->metrics : own_metrics;
 
 	////////////////////////////////////////////////////////
 	cout << "Processing the input data" << endl;
+
+	// load the DEM, compute relative relief (all scales + average) and write the
+	// ENVI rasters in background stages while the transects are extracted below
+	cout << "Relative relief kernels: " << rrKernels().name << ", threads: " << prms.nThreads << endl;
+	// in a mosaic the windows reach into the neighbouring tiles
+	TileHalo halo;
+	int m = (tile && tile->mosaic) ? tile->mosaic->find(prms.iFile) : -1;
+	if(m >= 0 && !tile->mosaic->halo(m, prms.scales.maxRadius(), halo)){
+		return false;
+	}
+	// incremental run: the outputs of the previous run are kept outside the
+	// pixels within reach of a change
+	ReliefUpdate update(prms, hdr);
+	if(prms.incremental()){
+		bool metrics = prms.oProduct.compare("rr")!=0 && (prms.oFormat.compare("ascii")==0 || prms.oFormat.compare("both")==0);
+		string csv_previous = prms.csvMetrics() ? prms.iFile.substr(0, prms.iFile.find_last_of(".")) + "_ISLAND_METRICS.csv" : "";
+
+		if(!(prms.updateMask.empty() ? update.diff(prms.updateDEM) : update.mask(prms.updateMask))
+				|| !update.loadPrevious(data, metrics, csv_previous)){
+			return false;
+		}
+		cout << "Incremental update: " << update.changed << " pixel(s) changed, relative relief of "
+			<< update.recomputed << " of " << hdr.npix << " pixels computed again";
+		if(prms.oProduct.compare("rr")!=0){
+			cout << ", " << update.transects << " transect(s) extracted again";
+		}
+		cout << endl;
+	}
+	// relative relief cache: map the bands of an earlier run on the same DEM and
+	// scales, or store the bands computed by this run
+	ReliefCache cache;
+	bool cached = false;
+	if(!prms.rrCache.empty()){
+		if(!cache.open(prms.rrCache, hdr.dataFile(prms.iFile), hdr, prms, data.rr.nscales())){
+			return false;
+		}
+		cached = cache.load(data);
+		cout << "Relative relief cache: " << (cached ? "using " : "no entry, computing ") << cache.path() << endl;
+	}
+	Pipeline pipe(&data, prms, hdr, tile ? tile->pool : NULL, (m >= 0) ? &halo : NULL, prms.incremental() ? &update : NULL);
+	pipe.start();
+
+	if(!prms.sweep.empty()){
+		cout << "Threshold sweep: " << sweep.size() << " parameter set(s)" << endl;
+		pipe.waitRelief(hdr.nlines);
+		chrono::steady_clock::time_point t0 = chrono::steady_clock::now();
+		sweep.run(data, hdr, prms.transect_direction, buffer, prms.nThreads);
+		cout << "Transects of every set extracted in " << chrono::duration<double>(chrono::steady_clock::now()-t0).count() << " s" << endl;
+	}
 	
 	////////////////////////////////////////////////////////
-	if(prms.oProduct.compare("rr")!=0){
+	if(prms.oProduct.compare("rr")!=0 && prms.sweep.empty()){
 		if(prms.oFormat.compare("ascii")==0 || prms.oFormat.compare("both")==0){
-			string ascii_outname = prms.iFile.substr(0, prms.iFile.find_last_of("."));
-			ascii_outname.append("_ISLAND_METRICS.csv");
-
-			landforms_metrics = fopen(ascii_outname.c_str(), "w+");
-			if(!landforms_metrics){
-				cout << "ERROR: Cannot write ascii data file: " << ascii_outname << endl;
+			string metrics_base = prms.iFile.substr(0, prms.iFile.find_last_of("."));
+			string csv_outname = prms.csvMetrics() ? metrics_base + "_ISLAND_METRICS.csv" : "";
+			string arrow_outname = prms.arrowMetrics() ? metrics_base + "_ISLAND_METRICS.arrow" : "";
+
+			if(tile){
+				landforms_metrics.openMemory(prms.csvMetrics(), prms.arrowMetrics());
+			} else if(!landforms_metrics.open(csv_outname, arrow_outname)){
+				cout << "ERROR: Cannot write ascii data file: " << (csv_outname.empty() ? arrow_outname : csv_outname) << endl;
 				exit(1);
 			} else{
-				cout << "Creating/writing ascii data file: " << ascii_outname << "\n" << endl;
+				if(!csv_outname.empty()){
+					cout << "Creating/writing ascii data file: " << csv_outname << "\n" << endl;
+				}
+				if(!arrow_outname.empty()){
+					cout << "Creating/writing Arrow data file: " << arrow_outname << "\n" << endl;
+				}
 			}
 
 			// write the hdr_info
-			(void) fprintf(landforms_metrics, "ycoordinate, ");
-			if(prms.oProduct.compare("shoreline")==0){
-				(void) fprintf(landforms_metrics, "shorelineX, shorelineZ\n");
-			}
-			if(prms.oProduct.compare("dunetoe")==0){
-				(void) fprintf(landforms_metrics, "dunetoeX, dunetoeZ\n");
-			}
-			if(prms.oProduct.compare("dunecrest")==0){
-				(void) fprintf(landforms_metrics, "dunecrestX, dunecrestZ\n");
-			}
-			if(prms.oProduct.compare("duneheel")==0){
-				(void) fprintf(landforms_metrics, "duneheelX, duneheelZ\n");
-			}
-			if(prms.oProduct.compare("backbarrier")==0){
-				(void) fprintf(landforms_metrics, "backbarrierX, backbarrierZ\n");
-			}
-			if(prms.oProduct.compare("landforms")==0 || prms.oProduct.compare("all")==0){
-				(void) fprintf(landforms_metrics, "shorelineX, shorelineZ, ");
-				(void) fprintf(landforms_metrics, "dunetoeX, dunetoeZ, ");
-				(void) fprintf(landforms_metrics, "dunecrestX, dunecrestZ, ");
-				(void) fprintf(landforms_metrics, "duneheelX, duneheelZ, ");
-				(void) fprintf(landforms_metrics, "backbarrierX, backbarrierZ, ");
-				(void) fprintf(landforms_metrics, "beach_width, beach_vol, dune_height, dune_vol, island_width, island_volume\n");
-			}
+			metricsColumns(landforms_metrics, prms);
 		}
 
 		////////////////////////////////////////////
 		// Calculate DEM stats (including RR values) for every pixel
 		///////////////////////////////////////////
 		if(prms.transect_direction.compare("W")==0 || prms.transect_direction.compare("E")==0){
-			for(i=0; i<hdr.nlines; ++i){
-				// define variables for extraction
-				float shorelinex, dunetoex, dunecrestx, duneheelx, backbarrierx;
-				double shorelinez, dunetoez, dunecrestz, duneheelz, backbarrierz;
+			int handed = 0;		// landform rows handed to the writer
+
+			for(int i=0; i<hdr.nlines; ++i){
+				// wait for the relative relief of this row
+				pipe.waitRelief(i+1);
+
+				// (incremental run: a row the change does not reach keeps the landforms
+				// and metrics of the previous run)
+				if(prms.incremental() && !update.touched(i)){
+					update.copyMetrics(i, landforms_metrics);
+					if(i+1-handed >= 64 || i+1 == hdr.nlines){
+						pipe.landformRows(handed, i+1);
+						handed = i+1;
+					}
+					continue;
+				}
+
+				// define variables for extraction (0 until the landform is found: the
+				// CSV line is written even if a search does not reach a landform)
+				double shorelinex = 0, dunetoex = 0, dunecrestx = 0, duneheelx = 0, backbarrierx = 0;
+				double shorelinez = 0, dunetoez = 0, dunecrestz = 0, duneheelz = 0, backbarrierz = 0;
 
 				// variables used to track feature position
 				float shoreline_pos = 0;
@@ -153,70 +409,23 @@ int main (){
 				int index1;			// index for analyzing the data
 				double ycoord = 0;
 				
-				// iterate through row to compute relative relief and other metrics given buffer size
-				for(j=0; j<hdr.ncols; ++j){
-					index1 = (i*hdr.ncols)+j;
-					// cout << index1 << endl;
-
-					// IF the center pixel is within the buffer distance to the image edge
-					if(i<buffer || i>hdr.nlines-buffer || j<buffer || j>hdr.ncols-buffer){
-						data.res[index1] = -9999;
-						data.res_plus1[index1] = -9999;
-						data.res_plus2[index1] = -9999;
-						data.avg[index1] = -9999;
-
-						data.shoreline[index1] = 0;
-						data.dune_toe_line[index1] = 0;
-						data.dune_ridge_line[index1] = 0;
-						data.dune_heel_line[index1] = 0;
-						data.backbarrier_line[index1] = 0;
-					}
-
-					// IF the center pixel is NOT NULL, then continue...
-					else if(data.z[index1] > -100){
-						// compute relative relief
-						data.computeRelativeRelief(i, j, buffer, hdr);
-
-						// set the landform indices to zero (i.e. edge of raster)
-						data.shoreline[index1] = 0;
-						data.dune_toe_line[index1] = 0;
-						data.dune_ridge_line[index1] = 0;
-						data.dune_heel_line[index1] = 0;
-						data.backbarrier_line[index1] = 0;
-					}
-
-					// IF the center pixel contains a NULL value, then set all the calculated attributes to NULL.
-					else{
-						data.res[index1] = -9999;
-						data.res_plus1[index1] = -9999;
-						data.res_plus2[index1] = -9999;
-						data.avg[index1] = -9999;
-
-						data.shoreline[index1] = 0;
-						data.dune_toe_line[index1] = 0;
-						data.dune_ridge_line[index1] = 0;
-						data.dune_heel_line[index1] = 0;
-						data.backbarrier_line[index1] = 0;
-					}
-				}
-					
 				if(prms.transect_direction.compare("E")==0){
 					///////////////////////
 					// extract SHORELINE
 					///////////////////////
-					for(j=0; j<hdr.ncols; ++j){		// read RIGHT to LEFT starting at edge of the image
+					for(int j=0; j<hdr.ncols; ++j){		// read RIGHT to LEFT starting at edge of the image
 						index1 = (i*hdr.ncols)+j;
 
 						// IF the center pixel is within the limits of the image...
 						if(i>buffer && i<hdr.nlines-buffer && j>buffer+1 && j<hdr.ncols-buffer-1){
 							// search for a location along the transect where criteria is met
-							if(data.z[index1+1] < prms.tShoreline
-									&& data.z[index1] >= prms.tShoreline){
-								data.shoreline[index1] = 1;
+							if((!data.valid(i, j+1) || data.z[index1+1] < prms.tShoreline)
+									&& data.valid(i, j) && data.z[index1] >= prms.tShoreline){
+								data.mark(index1, SHORELINE_BIT);
 								shoreline_pos = j;
-								shorelinex = data.x[index1];
+								shorelinex = hdr.xcoord(j);
 								shorelinez = data.z[index1];
-								ycoord = data.y[index1];
+								ycoord = hdr.ycoord(i);
 								break;
 							} else{
 								////////////////////////////////////////////////////////
@@ -237,7 +446,7 @@ int main (){
 					// extract DUNE TOE
 					//////////////////////
 					if(prms.oProduct.compare("dunetoe")==0 || prms.oProduct.compare("dunecrest")==0 || prms.oProduct.compare("duneheel")==0 || prms.oProduct.compare("backbarrier")==0 || prms.oProduct.compare("landforms")==0 || prms.oProduct.compare("all")==0){
-						for(j=shoreline_pos; j<hdr.ncols; ++j){		// read RIGHT to LEFT starting at shoreline
+						for(int j=shoreline_pos; j<hdr.ncols; ++j){		// read RIGHT to LEFT starting at shoreline
 							index1 = (i*hdr.ncols)+j;
 
 							// IF the center pixel is within the limits of the image...
@@ -249,9 +458,9 @@ int main (){
 								// search for a location along the transect where criteria is met
 								if(data.avg[index1+1] < prms.tDT
 										&& data.avg[index1] >= prms.tDT){
-									data.dune_toe_line[index1] = 1;
+									data.mark(index1, DUNE_TOE_BIT);
 									dunetoe_pos = j;
-									dunetoex = data.x[index1];
+									dunetoex = hdr.xcoord(j);
 									dunetoez = data.z[index1];
 									break;
 								} else{
@@ -267,7 +476,7 @@ int main (){
 					// extract DUNE CREST
 					////////////////////////
 					if(prms.oProduct.compare("dunecrest")==0 || prms.oProduct.compare("duneheel")==0 || prms.oProduct.compare("backbarrier")==0 || prms.oProduct.compare("landforms")==0 || prms.oProduct.compare("all")==0){
-						for(j=dunetoe_pos; j<hdr.ncols; ++j){		// read RIGHT to LEFT starting at shoreline
+						for(int j=dunetoe_pos; j<hdr.ncols; ++j){		// read RIGHT to LEFT starting at shoreline
 							index1 = (i*hdr.ncols)+j;
 
 							// IF the center pixel is within the limits of the image...
@@ -277,16 +486,16 @@ int main (){
 										&& data.avg[index1-1] < prms.tDC
 										&& data.avg[index1-1]!=-9999
 										&& data.avg[index1]!=-9999
-										&& data.z[index1]!=-9999
+										&& data.valid(i, j)
 										// if pixel is greater than minimum distance back from the dune toe
 										&& (dunetoe_pos-j)*hdr.xres > prms.tCrestDistMin
 										// if pixel is less than maximum distance back from the dune toe
 										&& (dunetoe_pos-j)*hdr.xres < prms.tCrestDistMax
 										// If pixel is higher than dune toe
 										&& dunetoez<data.z[index1]){
-									data.dune_ridge_line[index1] = 1;
+									data.mark(index1, DUNE_CREST_BIT);
 									dunecrest_pos = j;
-									dunecrestx = data.x[index1];
+									dunecrestx = hdr.xcoord(j);
 									dunecrestz = data.z[index1];
 									break;
 								} else{
@@ -302,7 +511,7 @@ int main (){
 					// extract DUNE HEEL
 					///////////////////////
 					if(prms.oProduct.compare("duneheel")==0 || prms.oProduct.compare("backbarrier")==0 || prms.oProduct.compare("landforms")==0 || prms.oProduct.compare("all")==0){
-						for(j=dunecrest_pos; j<hdr.ncols; ++j){		// read RIGHT to LEFT starting at shoreline
+						for(int j=dunecrest_pos; j<hdr.ncols; ++j){		// read RIGHT to LEFT starting at shoreline
 							index1 = (i*hdr.ncols)+j;
 
 							// IF the center pixel is within the limits of the image...
@@ -311,14 +520,14 @@ int main (){
 										&& data.avg[index1-1] < prms.tDH
 										&& data.avg[index1-1]!=-9999
 										&& data.avg[index1]!=-9999
-										&& data.z[index1]!=-9999
+										&& data.valid(i, j)
 										// if pixel is greater than minimum distance back from the dune crest
 										&& (dunecrest_pos-j)*hdr.xres > prms.tHeelDistMin
 										// if pixel is less than maximum distance back from the dune crest
 										&& (dunecrest_pos-j)*hdr.xres < prms.tHeelDistMax){
-									data.dune_heel_line[index1] = 1;
+									data.mark(index1, DUNE_HEEL_BIT);
 									duneheel_pos = j;
-									duneheelx = data.x[index1];
+									duneheelx = hdr.xcoord(j);
 									duneheelz = data.z[index1];
 									break;
 								} else{
@@ -345,18 +554,18 @@ int main (){
 							backstart = shoreline_pos;
 						}
 
-						for(j=backstart; j<hdr.ncols; ++j){		// read RIGHT to LEFT starting at shoreline
+						for(int j=backstart; j<hdr.ncols; ++j){		// read RIGHT to LEFT starting at shoreline
 							index1 = (i*hdr.ncols)+j;
 
 							// IF the center pixel is within the limits of the image...
 							if(i>buffer && i<hdr.nlines-buffer && j>buffer+1 && j<hdr.ncols-buffer-1){
 								//cout << j << " - " << index1 << " - " << data[index1-1].z << endl;
-								if(data.z[index1-1] < prms.tBB
+								if((!data.valid(i, j-1) || data.z[index1-1] < prms.tBB)
 										&& data.z[index1] >= prms.tBB
-										&& data.z[index1]!=-9999){
-									data.backbarrier_line[index1] = 1;
+										&& data.valid(i, j)){
+									data.mark(index1, BACKBARRIER_BIT);
 									backbarrier_pos = j;
-									backbarrierx = data.x[index1];
+									backbarrierx = hdr.xcoord(j);
 									backbarrierz = data.z[index1];
 									break;
 								} else{
@@ -371,7 +580,7 @@ int main (){
 					//////////////////////
 					// calculate VOLUMES
 					//////////////////////
-					for(j=0; j<hdr.ncols; ++j){		// read RIGHT to LEFT starting at shoreline
+					for(int j=0; j<hdr.ncols; ++j){		// read RIGHT to LEFT starting at shoreline
 						index1 = (i*hdr.ncols)+j;
 						int a = 0;
 						///////////////////////////
@@ -381,7 +590,7 @@ int main (){
 							if(j<=shoreline_pos
 									&& j>=dunetoe_pos
 									&& dunetoe_pos!=0
-									&& data.z[index1]>=prms.tShoreline){
+									&& data.valid(i, j) && data.z[index1]>=prms.tShoreline){
 								if(a<=(shorelinex-dunetoex)*hdr.xres){
 									beach_vol += (data.z[index1]-prms.tShoreline)*hdr.xres*hdr.yres;
 								}
@@ -398,7 +607,7 @@ int main (){
 							if(j<=dunetoe_pos
 									&& j>=duneheel_pos
 									&& duneheel_pos!=0
-									&& data.z[index1]>=prms.tShoreline){
+									&& data.valid(i, j) && data.z[index1]>=prms.tShoreline){
 								dune_vol += (data.z[index1]-prms.tShoreline)*hdr.xres*hdr.yres;
 							} else{
 								dune_vol += 0;
@@ -414,7 +623,7 @@ int main (){
 									&& j>=backbarrier_pos
 									&& backbarrierz!=-99999
 									&& shoreline_pos!=0
-									&& data.z[index1]>=prms.tShoreline){
+									&& data.valid(i, j) && data.z[index1]>=prms.tShoreline){
 								island_vol += (data.z[index1]-prms.tShoreline)*hdr.xres*hdr.yres;
 							} else{
 								island_vol += 0;
@@ -426,19 +635,19 @@ int main (){
 					///////////////////////
 					// extract SHORELINE
 					///////////////////////
-					for(j=hdr.ncols; j>-1; --j){		// read RIGHT to LEFT starting at edge of the image
+					for(int j=hdr.ncols; j>-1; --j){		// read RIGHT to LEFT starting at edge of the image
 						index1 = (i*hdr.ncols)+j;
 
 						// IF the center pixel is within the limits of the image...
 						if(i>buffer && i<hdr.nlines-buffer && j>buffer+1 && j<hdr.ncols-buffer-1){
 							// search for a location along the transect where criteria is met
-							if(data.z[index1+1] < prms.tShoreline
-									&& data.z[index1] >= prms.tShoreline){
-								data.shoreline[index1] = 1;
+							if((!data.valid(i, j+1) || data.z[index1+1] < prms.tShoreline)
+									&& data.valid(i, j) && data.z[index1] >= prms.tShoreline){
+								data.mark(index1, SHORELINE_BIT);
 								shoreline_pos = j;
-								shorelinex = data.x[index1];
+								shorelinex = hdr.xcoord(j);
 								shorelinez = data.z[index1];
-								ycoord = data.y[index1];
+								ycoord = hdr.ycoord(i);
 								break;
 							} else{
 								////////////////////////////////////////////////////////
@@ -459,7 +668,7 @@ int main (){
 					// extract DUNE TOE
 					//////////////////////
 					if(prms.oProduct.compare("dunetoe")==0 || prms.oProduct.compare("dunecrest")==0 || prms.oProduct.compare("duneheel")==0 || prms.oProduct.compare("backbarrier")==0 || prms.oProduct.compare("landforms")==0 || prms.oProduct.compare("all")==0){
-						for(j=shoreline_pos; j>-1; --j){		// read RIGHT to LEFT starting at shoreline
+						for(int j=shoreline_pos; j>-1; --j){		// read RIGHT to LEFT starting at shoreline
 							index1 = (i*hdr.ncols)+j;
 
 							// IF the center pixel is within the limits of the image...
@@ -471,9 +680,9 @@ int main (){
 								// search for a location along the transect where criteria is met
 								if(data.avg[index1+1] < prms.tDT
 										&& data.avg[index1] >= prms.tDT){
-									data.dune_toe_line[index1] = 1;
+									data.mark(index1, DUNE_TOE_BIT);
 									dunetoe_pos = j;
-									dunetoex = data.x[index1];
+									dunetoex = hdr.xcoord(j);
 									dunetoez = data.z[index1];
 									break;
 								} else{
@@ -489,7 +698,7 @@ int main (){
 					// extract DUNE CREST
 					////////////////////////
 					if(prms.oProduct.compare("dunecrest")==0 || prms.oProduct.compare("duneheel")==0 || prms.oProduct.compare("backbarrier")==0 || prms.oProduct.compare("landforms")==0 || prms.oProduct.compare("all")==0){
-						for(j=dunetoe_pos; j>-1; --j){		// read RIGHT to LEFT starting at shoreline
+						for(int j=dunetoe_pos; j>-1; --j){		// read RIGHT to LEFT starting at shoreline
 							index1 = (i*hdr.ncols)+j;
 
 							// IF the center pixel is within the limits of the image...
@@ -499,16 +708,16 @@ int main (){
 										&& data.avg[index1-1] < prms.tDC
 										&& data.avg[index1-1]!=-9999
 										&& data.avg[index1]!=-9999
-										&& data.z[index1]!=-9999
+										&& data.valid(i, j)
 										// if pixel is greater than minimum distance back from the dune toe
 										&& (dunetoe_pos-j)*hdr.xres > prms.tCrestDistMin
 										// if pixel is less than maximum distance back from the dune toe
 										&& (dunetoe_pos-j)*hdr.xres < prms.tCrestDistMax
 										// If pixel is higher than dune toe
 										&& dunetoez<data.z[index1]){
-									data.dune_ridge_line[index1] = 1;
+									data.mark(index1, DUNE_CREST_BIT);
 									dunecrest_pos = j;
-									dunecrestx = data.x[index1];
+									dunecrestx = hdr.xcoord(j);
 									dunecrestz = data.z[index1];
 									break;
 								} else{
@@ -524,7 +733,7 @@ int main (){
 					// extract DUNE HEEL
 					///////////////////////
 					if(prms.oProduct.compare("duneheel")==0 || prms.oProduct.compare("backbarrier")==0 || prms.oProduct.compare("landforms")==0 || prms.oProduct.compare("all")==0){
-						for(j=dunecrest_pos; j>-1; --j){		// read RIGHT to LEFT starting at shoreline
+						for(int j=dunecrest_pos; j>-1; --j){		// read RIGHT to LEFT starting at shoreline
 							index1 = (i*hdr.ncols)+j;
 
 							// IF the center pixel is within the limits of the image...
@@ -533,14 +742,14 @@ int main (){
 										&& data.avg[index1-1] < prms.tDH
 										&& data.avg[index1-1]!=-9999
 										&& data.avg[index1]!=-9999
-										&& data.z[index1]!=-9999
+										&& data.valid(i, j)
 										// if pixel is greater than minimum distance back from the dune crest
 										&& (dunecrest_pos-j)*hdr.xres > prms.tHeelDistMin
 										// if pixel is less than maximum distance back from the dune crest
 										&& (dunecrest_pos-j)*hdr.xres < prms.tHeelDistMax){
-									data.dune_heel_line[index1] = 1;
+									data.mark(index1, DUNE_HEEL_BIT);
 									duneheel_pos = j;
-									duneheelx = data.x[index1];
+									duneheelx = hdr.xcoord(j);
 									duneheelz = data.z[index1];
 									break;
 								} else{
@@ -567,18 +776,18 @@ int main (){
 							backstart = shoreline_pos;
 						}
 
-						for(j=backstart; j>-1; --j){		// read RIGHT to LEFT starting at shoreline
+						for(int j=backstart; j>-1; --j){		// read RIGHT to LEFT starting at shoreline
 							index1 = (i*hdr.ncols)+j;
 
 							// IF the center pixel is within the limits of the image...
 							if(i>buffer && i<hdr.nlines-buffer && j>buffer+1 && j<hdr.ncols-buffer-1){
 								//cout << j << " - " << index1 << " - " << data[index1-1].z << endl;
-								if(data.z[index1-1] < prms.tBB
+								if((!data.valid(i, j-1) || data.z[index1-1] < prms.tBB)
 										&& data.z[index1] >= prms.tBB
-										&& data.z[index1]!=-9999){
-									data.backbarrier_line[index1] = 1;
+										&& data.valid(i, j)){
+									data.mark(index1, BACKBARRIER_BIT);
 									backbarrier_pos = j;
-									backbarrierx = data.x[index1];
+									backbarrierx = hdr.xcoord(j);
 									backbarrierz = data.z[index1];
 									break;
 								} else{
@@ -593,7 +802,7 @@ int main (){
 					//////////////////////
 					// calculate VOLUMES
 					//////////////////////
-					for(j=hdr.ncols; j>-1; --j){		// read RIGHT to LEFT starting at shoreline
+					for(int j=hdr.ncols; j>-1; --j){		// read RIGHT to LEFT starting at shoreline
 						index1 = (i*hdr.ncols)+j;
 						int a = 0;
 						///////////////////////////
@@ -603,7 +812,7 @@ int main (){
 							if(j<=shoreline_pos
 									&& j>=dunetoe_pos
 									&& dunetoe_pos!=0
-									&& data.z[index1]>=prms.tShoreline){
+									&& data.valid(i, j) && data.z[index1]>=prms.tShoreline){
 								if(a<=(shorelinex-dunetoex)*hdr.xres){
 									beach_vol += (data.z[index1]-prms.tShoreline)*hdr.xres*hdr.yres;
 								}
@@ -620,7 +829,7 @@ int main (){
 							if(j<=dunetoe_pos
 									&& j>=duneheel_pos
 									&& duneheel_pos!=0
-									&& data.z[index1]>=prms.tShoreline){
+									&& data.valid(i, j) && data.z[index1]>=prms.tShoreline){
 								dune_vol += (data.z[index1]-prms.tShoreline)*hdr.xres*hdr.yres;
 							} else{
 								dune_vol += 0;
@@ -636,7 +845,7 @@ int main (){
 									&& j>=backbarrier_pos
 									&& backbarrierz!=-99999
 									&& shoreline_pos!=0
-									&& data.z[index1]>=prms.tShoreline){
+									&& data.valid(i, j) && data.z[index1]>=prms.tShoreline){
 								island_vol += (data.z[index1]-prms.tShoreline)*hdr.xres*hdr.yres;
 							} else{
 								island_vol += 0;
@@ -651,19 +860,19 @@ int main (){
 				if(prms.oFormat.compare("ascii")==0 || prms.oFormat.compare("both")==0){
 					// write out the desired products to the ascii file
 					if(prms.oProduct.compare("shoreline")==0 && shorelinez>=hdr.zmin && shorelinex>hdr.ulx && shorelinex<=hdr.xmax){
-						(void) fprintf(landforms_metrics, "%lf.10, %lf.10, %lf.10\n", (i*hdr.yres)+hdr.ulx, (float)shorelinex, (float)shorelinez);
+						landforms_metrics.line((i*hdr.yres)+hdr.ulx, shorelinex, (float)shorelinez);
 					}
 					if(prms.oProduct.compare("dunetoe")==0 && dunetoez>=hdr.zmin && dunetoex>hdr.ulx && dunetoex<hdr.xmax){
-						(void) fprintf(landforms_metrics, "%lf.10, %lf.10, %lf.10\n", (i*hdr.yres)+hdr.ulx, (float)dunetoex, (float)dunetoez);
+						landforms_metrics.line((i*hdr.yres)+hdr.ulx, dunetoex, (float)dunetoez);
 					}
 					if(prms.oProduct.compare("dunecrest")==0 && dunecrestz>=hdr.zmin && dunecrestx>hdr.ulx && dunecrestx<hdr.xmax){
-						(void) fprintf(landforms_metrics, "%lf.10, %lf.10, %lf.10\n", (i*hdr.yres)+hdr.ulx, (float)dunecrestx, (float)dunecrestz);
+						landforms_metrics.line((i*hdr.yres)+hdr.ulx, dunecrestx, (float)dunecrestz);
 					}
 					if(prms.oProduct.compare("duneheel")==0 && duneheelz>=hdr.zmin && duneheelx>hdr.ulx && duneheelx<hdr.xmax){
-						(void) fprintf(landforms_metrics, "%lf.10, %lf.10, %lf.10\n", (i*hdr.yres)+hdr.ulx, (float)duneheelx, (float)duneheelz);
+						landforms_metrics.line((i*hdr.yres)+hdr.ulx, duneheelx, (float)duneheelz);
 					}
 					if(prms.oProduct.compare("backbarrier")==0 && backbarrierz>=hdr.zmin && backbarrierx>=hdr.ulx && backbarrierx<hdr.xmax){
-						(void) fprintf(landforms_metrics, "%lf.10, %lf.10, %lf.10\n", (i*hdr.yres)+hdr.ulx, (float)backbarrierx, (float)backbarrierz);
+						landforms_metrics.line((i*hdr.yres)+hdr.ulx, backbarrierx, (float)backbarrierz);
 					}
 					if((prms.oProduct.compare("landforms")==0 || prms.oProduct.compare("all")==0) && ycoord!=0){
 							double dh, bw, iw;
@@ -700,13 +909,13 @@ int main (){
 							}
 							
 							// write values to the log file
-							(void) fprintf(landforms_metrics, "%lf.10, ", (float)ycoord);
-							(void) fprintf(landforms_metrics, "%lf.10, %lf.10, ", (float)shorelinex, (float)shorelinez);
-							(void) fprintf(landforms_metrics, "%lf.10, %lf.10, ", (float)dunetoex, (float)dunetoez);
-							(void) fprintf(landforms_metrics, "%lf.10, %lf.10, ", (float)dunecrestx, (float)dunecrestz);
-							(void) fprintf(landforms_metrics, "%lf.10, %lf.10, ", (float)duneheelx, (float)duneheelz);
-							(void) fprintf(landforms_metrics, "%lf.10, %lf.10, ", (float)backbarrierx, (float)backbarrierz);
-							(void) fprintf(landforms_metrics, "%lf.10, %lf.10, %lf.10, %lf.10, %lf.10, %lf.10\n",
+							landforms_metrics.fields(ycoord);
+							landforms_metrics.fields(shorelinex, (float)shorelinez);
+							landforms_metrics.fields(dunetoex, (float)dunetoez);
+							landforms_metrics.fields(dunecrestx, (float)dunecrestz);
+							landforms_metrics.fields(duneheelx, (float)duneheelz);
+							landforms_metrics.fields(backbarrierx, (float)backbarrierz);
+							landforms_metrics.line(
 								(float)bw,
 								(float)beach_vol,
 								(float)dh,
@@ -715,13 +924,37 @@ int main (){
 								(float)island_vol);
 					}
 				}
+
+				// the landform lines of this row are final
+				if(i+1-handed >= 64 || i+1 == hdr.nlines){
+					pipe.landformRows(handed, i+1);
+					handed = i+1;
+				}
 			}
 		}
 		else if(prms.transect_direction.compare("S")==0 || prms.transect_direction.compare("N")==0){
-			for(j=0; j<hdr.ncols; ++j){
-				// define variables for extraction
-				float shoreliney, dunetoey, dunecresty, duneheely, backbarriery;
-				double shorelinez, dunetoez, dunecrestz, duneheelz, backbarrierz;
+			// column transects need the relative relief of every row
+			pipe.waitRelief(hdr.nlines);
+
+			// transects walk down the columns: copy the elevations and the average
+			// relative relief into column-major rasters (tile by tile, reading the DEM
+			// sequentially) so that every transect reads contiguous memory
+			vector<float> zt(hdr.npix), avgt(hdr.npix);
+			transposeRaster(data.z.data(), zt.data(), hdr.nlines, hdr.ncols);
+			transposeRaster(data.avg, avgt.data(), hdr.nlines, hdr.ncols);
+
+			for(int j=0; j<hdr.ncols; ++j){
+				// (incremental run: a column the change does not reach keeps the
+				// landforms and metrics of the previous run)
+				if(prms.incremental() && !update.touched(j)){
+					update.copyMetrics(j, landforms_metrics);
+					continue;
+				}
+
+				// define variables for extraction (0 until the landform is found: the
+				// CSV line is written even if a search does not reach a landform)
+				double shoreliney = 0, dunetoey = 0, dunecresty = 0, duneheely = 0, backbarriery = 0;
+				double shorelinez = 0, dunetoez = 0, dunecrestz = 0, duneheelz = 0, backbarrierz = 0;
 
 				// variables used to track feature position
 				float shoreline_pos = 0;
@@ -735,72 +968,27 @@ int main (){
 				double island_vol = 0;
 
 				int index1;			// index for analyzing the data
+				int tindex;			// same pixel in the column-major copies
 				double xcoord = 0;
 				
-				// iterate through row to compute relative relief and other metrics given buffer size
-				for(i=0; i<hdr.nlines; ++i){
-					index1 = (i*hdr.ncols)+j;
-					// cout << index1 << endl;
-
-					// IF the center pixel is within the buffer distance to the image edge
-					if(i<buffer || i>hdr.nlines-buffer || j<buffer || j>hdr.ncols-buffer){
-						data.res[index1] = -9999;
-						data.res_plus1[index1] = -9999;
-						data.res_plus2[index1] = -9999;
-						data.avg[index1] = -9999;
-
-						data.shoreline[index1] = 0;
-						data.dune_toe_line[index1] = 0;
-						data.dune_ridge_line[index1] = 0;
-						data.dune_heel_line[index1] = 0;
-						data.backbarrier_line[index1] = 0;
-					}
-
-					// IF the center pixel is NOT NULL, then continue...
-					else if(data.z[index1] > -100){
-						// compute relative relief
-						data.computeRelativeRelief(i, j, buffer, hdr);
-
-						// set the landform indices to zero (i.e. edge of raster)
-						data.shoreline[index1] = 0;
-						data.dune_toe_line[index1] = 0;
-						data.dune_ridge_line[index1] = 0;
-						data.dune_heel_line[index1] = 0;
-						data.backbarrier_line[index1] = 0;
-					}
-
-					// IF the center pixel contains a NULL value, then set all the calculated attributes to NULL.
-					else{
-						data.res[index1] = -9999;
-						data.res_plus1[index1] = -9999;
-						data.res_plus2[index1] = -9999;
-						data.avg[index1] = -9999;
-
-						data.shoreline[index1] = 0;
-						data.dune_toe_line[index1] = 0;
-						data.dune_ridge_line[index1] = 0;
-						data.dune_heel_line[index1] = 0;
-						data.backbarrier_line[index1] = 0;
-					}
-				}
-					
 				if(prms.transect_direction.compare("N")==0){
 					///////////////////////
 					// extract SHORELINE
 					///////////////////////
-					for(i=0; i<hdr.nlines; ++i){		// read BOTTOM to TOP starting at edge of the image
+					for(int i=0; i<hdr.nlines; ++i){		// read BOTTOM to TOP starting at edge of the image
 						index1 = (i*hdr.ncols)+j;
+						tindex = (j*hdr.nlines)+i;
 
 						// IF the center pixel is within the limits of the image...
 						if(i>buffer && i<hdr.nlines-buffer && j>buffer+1 && j<hdr.ncols-buffer-1){
 							// search for a location along the transect where criteria is met
-							if(data.z[index1+1] < prms.tShoreline
-									&& data.z[index1] >= prms.tShoreline){
-								data.shoreline[index1] = 1;
+							if((!data.valid(i, j+1) || zt[tindex+hdr.nlines] < prms.tShoreline)
+									&& data.valid(i, j) && zt[tindex] >= prms.tShoreline){
+								data.mark(index1, SHORELINE_BIT);
 								shoreline_pos = i;
-								shoreliney = data.x[index1];
-								shorelinez = data.z[index1];
-								xcoord = data.y[index1];
+								shoreliney = hdr.xcoord(j);
+								shorelinez = zt[tindex];
+								xcoord = hdr.ycoord(i);
 								break;
 							} else{
 								////////////////////////////////////////////////////////
@@ -821,8 +1009,9 @@ int main (){
 					// extract DUNE TOE
 					//////////////////////
 					if(prms.oProduct.compare("dunetoe")==0 || prms.oProduct.compare("dunecrest")==0 || prms.oProduct.compare("duneheel")==0 || prms.oProduct.compare("backbarrier")==0 || prms.oProduct.compare("landforms")==0 || prms.oProduct.compare("all")==0){
-						for(i=shoreline_pos; i<hdr.nlines; ++i){		// read BOTTOM to TOP starting at shoreline
+						for(int i=shoreline_pos; i<hdr.nlines; ++i){		// read BOTTOM to TOP starting at shoreline
 							index1 = (i*hdr.ncols)+j;
+							tindex = (j*hdr.nlines)+i;
 
 							// IF the center pixel is within the limits of the image...
 							if(i>buffer && i<hdr.nlines-buffer && j>buffer+1 && j<hdr.ncols-buffer-1
@@ -831,12 +1020,12 @@ int main (){
 									// if pixel is less than maximum distance back from the shoreline
 									&& abs(shoreline_pos-i)*hdr.yres < prms.tDuneDistMax){
 								// search for a location along the transect where criteria is met
-								if(data.avg[index1+1] < prms.tDT
-										&& data.avg[index1] >= prms.tDT){
-									data.dune_toe_line[index1] = 1;
+								if(avgt[tindex+hdr.nlines] < prms.tDT
+										&& avgt[tindex] >= prms.tDT){
+									data.mark(index1, DUNE_TOE_BIT);
 									dunetoe_pos = i;
-									dunetoey = data.y[index1];
-									dunetoez = data.z[index1];
+									dunetoey = hdr.ycoord(i);
+									dunetoez = zt[tindex];
 									break;
 								} else{
 									dunetoe_pos = 0;
@@ -851,27 +1040,28 @@ int main (){
 					// extract DUNE CREST
 					////////////////////////
 					if(prms.oProduct.compare("dunecrest")==0 || prms.oProduct.compare("duneheel")==0 || prms.oProduct.compare("backbarrier")==0 || prms.oProduct.compare("landforms")==0 || prms.oProduct.compare("all")==0){
-						for(i=dunetoe_pos; i<hdr.nlines; ++i){		// read BOTTOM to TOP starting at shoreline
+						for(int i=dunetoe_pos; i<hdr.nlines; ++i){		// read BOTTOM to TOP starting at shoreline
 							index1 = (i*hdr.ncols)+j;
+							tindex = (j*hdr.nlines)+i;
 
 							// IF the center pixel is within the limits of the image...
 							if(i>buffer && i<hdr.nlines-buffer && j>buffer+1 && j<hdr.ncols-buffer-1 && i>dunetoe_pos){
 								// search for a location along the transect where criteria is met
-								if(data.avg[index1] >= prms.tDC
-										&& data.avg[index1-1] < prms.tDC
-										&& data.avg[index1-1]!=-9999
-										&& data.avg[index1]!=-9999
-										&& data.z[index1]!=-9999
+								if(avgt[tindex] >= prms.tDC
+										&& avgt[tindex-hdr.nlines] < prms.tDC
+										&& avgt[tindex-hdr.nlines]!=-9999
+										&& avgt[tindex]!=-9999
+										&& data.valid(i, j)
 										// if pixel is greater than minimum distance back from the dune toe
 										&& abs(dunetoe_pos-i)*hdr.yres > prms.tCrestDistMin
 										// if pixel is less than maximum distance back from the dune toe
 										&& abs(dunetoe_pos-i)*hdr.yres < prms.tCrestDistMax
 										// If pixel is higher than dune toe
-										&& dunetoez<data.z[index1]){
-									data.dune_ridge_line[index1] = 1;
+										&& dunetoez<zt[tindex]){
+									data.mark(index1, DUNE_CREST_BIT);
 									dunecrest_pos = i;
-									dunecresty = data.y[index1];
-									dunecrestz = data.z[index1];
+									dunecresty = hdr.ycoord(i);
+									dunecrestz = zt[tindex];
 									break;
 								} else{
 									dunecrest_pos = 0;
@@ -886,24 +1076,25 @@ int main (){
 					// extract DUNE HEEL
 					///////////////////////
 					if(prms.oProduct.compare("duneheel")==0 || prms.oProduct.compare("backbarrier")==0 || prms.oProduct.compare("landforms")==0 || prms.oProduct.compare("all")==0){
-						for(i=dunecrest_pos; i<hdr.nlines; ++i){		// read BOTTOM to TOP starting at shoreline
+						for(int i=dunecrest_pos; i<hdr.nlines; ++i){		// read BOTTOM to TOP starting at shoreline
 							index1 = (i*hdr.ncols)+j;
+							tindex = (j*hdr.nlines)+i;
 
 							// IF the center pixel is within the limits of the image...
 							if(i>buffer && i<hdr.nlines-buffer && j>buffer+1 && j<hdr.ncols-buffer-1 && i>dunecrest_pos){
-								if(data.avg[index1] >= prms.tDH
-										&& data.avg[index1-1] < prms.tDH
-										&& data.avg[index1-1]!=-9999
-										&& data.avg[index1]!=-9999
-										&& data.z[index1]!=-9999
+								if(avgt[tindex] >= prms.tDH
+										&& avgt[tindex-hdr.nlines] < prms.tDH
+										&& avgt[tindex-hdr.nlines]!=-9999
+										&& avgt[tindex]!=-9999
+										&& data.valid(i, j)
 										// if pixel is greater than minimum distance back from the dune crest
 										&& abs(dunecrest_pos-i)*hdr.yres > prms.tHeelDistMin
 										// if pixel is less than maximum distance back from the dune crest
 										&& abs(dunecrest_pos-i)*hdr.yres < prms.tHeelDistMax){
-									data.dune_heel_line[index1] = 1;
+									data.mark(index1, DUNE_HEEL_BIT);
 									duneheel_pos = i;
-									duneheely = data.y[index1];
-									duneheelz = data.z[index1];
+									duneheely = hdr.ycoord(i);
+									duneheelz = zt[tindex];
 									break;
 								} else{
 									duneheel_pos = 0;
@@ -929,19 +1120,20 @@ int main (){
 							backstart = shoreline_pos;
 						}
 
-						for(i=backstart; i<hdr.nlines; ++i){		// read BOTTOM to TOP starting at shoreline
+						for(int i=backstart; i<hdr.nlines; ++i){		// read BOTTOM to TOP starting at shoreline
 							index1 = (i*hdr.ncols)+j;
+							tindex = (j*hdr.nlines)+i;
 
 							// IF the center pixel is within the limits of the image...
 							if(i>buffer && i<hdr.nlines-buffer && j>buffer+1 && j<hdr.ncols-buffer-1){
 								//cout << j << " - " << index1 << " - " << data[index1-1].z << endl;
-								if(data.z[index1-1] < prms.tBB
-										&& data.z[index1] >= prms.tBB
-										&& data.z[index1]!=-9999){
-									data.backbarrier_line[index1] = 1;
+								if((!data.valid(i, j-1) || zt[tindex-hdr.nlines] < prms.tBB)
+										&& zt[tindex] >= prms.tBB
+										&& data.valid(i, j)){
+									data.mark(index1, BACKBARRIER_BIT);
 									backbarrier_pos = i;
-									backbarriery = data.y[index1];
-									backbarrierz = data.z[index1];
+									backbarriery = hdr.ycoord(i);
+									backbarrierz = zt[tindex];
 									break;
 								} else{
 									backbarrier_pos = 0;
@@ -955,8 +1147,9 @@ int main (){
 					//////////////////////
 					// calculate VOLUMES
 					//////////////////////
-					for(i=0; i<hdr.nlines; ++i){
+					for(int i=0; i<hdr.nlines; ++i){
 						index1 = (i*hdr.ncols)+j;
+						tindex = (j*hdr.nlines)+i;
 						int a = 0;
 						///////////////////////////
 						// calculate BEACH VOLUME
@@ -965,9 +1158,9 @@ int main (){
 							if(i>=shoreline_pos
 									&& i<=dunetoe_pos
 									&& dunetoe_pos!=0
-									&& data.z[index1]>=prms.tShoreline){
+									&& data.valid(i, j) && zt[tindex]>=prms.tShoreline){
 								if(a<=(shoreliney-dunetoey)*hdr.xres){
-									beach_vol += (data.z[index1]-prms.tShoreline)*hdr.xres*hdr.yres;
+									beach_vol += (zt[tindex]-prms.tShoreline)*hdr.xres*hdr.yres;
 								}
 							} else{
 								beach_vol += 0;
@@ -982,8 +1175,8 @@ int main (){
 							if(i>=dunetoe_pos
 									&& i<=duneheel_pos
 									&& duneheel_pos!=0
-									&& data.z[index1]>=prms.tShoreline){
-								dune_vol += (data.z[index1]-prms.tShoreline)*hdr.xres*hdr.yres;
+									&& data.valid(i, j) && zt[tindex]>=prms.tShoreline){
+								dune_vol += (zt[tindex]-prms.tShoreline)*hdr.xres*hdr.yres;
 							} else{
 								dune_vol += 0;
 							}
@@ -998,8 +1191,8 @@ int main (){
 									&& i<=backbarrier_pos
 									&& backbarrierz!=-99999
 									&& shoreline_pos!=0
-									&& data.z[index1]>=prms.tShoreline){
-								island_vol += (data.z[index1]-prms.tShoreline)*hdr.xres*hdr.yres;
+									&& data.valid(i, j) && zt[tindex]>=prms.tShoreline){
+								island_vol += (zt[tindex]-prms.tShoreline)*hdr.xres*hdr.yres;
 							} else{
 								island_vol += 0;
 							}
@@ -1010,19 +1203,20 @@ int main (){
 					///////////////////////
 					// extract SHORELINE
 					///////////////////////
-					for(i=hdr.nlines; i>-1; --i){		// read TOP to BOTTOM starting at edge of the image
+					for(int i=hdr.nlines; i>-1; --i){		// read TOP to BOTTOM starting at edge of the image
 						index1 = (i*hdr.ncols)+j;
+						tindex = (j*hdr.nlines)+i;
 
 						// IF the center pixel is within the limits of the image...
 						if(i>buffer && i<hdr.nlines-buffer && j>buffer+1 && j<hdr.ncols-buffer-1){
 							// search for a location along the transect where criteria is met
-							if(data.z[index1+1] < prms.tShoreline
-									&& data.z[index1] >= prms.tShoreline){
-								data.shoreline[index1] = 1;
+							if((!data.valid(i, j+1) || zt[tindex+hdr.nlines] < prms.tShoreline)
+									&& data.valid(i, j) && zt[tindex] >= prms.tShoreline){
+								data.mark(index1, SHORELINE_BIT);
 								shoreline_pos = i;
-								shoreliney = data.y[index1];
-								shorelinez = data.z[index1];
-								xcoord = data.x[index1];
+								shoreliney = hdr.ycoord(i);
+								shorelinez = zt[tindex];
+								xcoord = hdr.xcoord(j);
 								break;
 							} else{
 								////////////////////////////////////////////////////////
@@ -1043,8 +1237,9 @@ int main (){
 					// extract DUNE TOE
 					//////////////////////
 					if(prms.oProduct.compare("dunetoe")==0 || prms.oProduct.compare("dunecrest")==0 || prms.oProduct.compare("duneheel")==0 || prms.oProduct.compare("backbarrier")==0 || prms.oProduct.compare("landforms")==0 || prms.oProduct.compare("all")==0){
-						for(i=shoreline_pos; i>-1; --i){		// read TOP to BOTTOM starting at shoreline
+						for(int i=shoreline_pos; i>-1; --i){		// read TOP to BOTTOM starting at shoreline
 							index1 = (i*hdr.ncols)+j;
+							tindex = (j*hdr.nlines)+i;
 
 							// IF the center pixel is within the limits of the image...
 							if(i>buffer && i<hdr.nlines-buffer && j>buffer+1 && j<hdr.ncols-buffer-1
@@ -1053,12 +1248,12 @@ int main (){
 									// if pixel is less than maximum distance back from the shoreline
 									&& abs(shoreline_pos-i)*hdr.yres < prms.tDuneDistMax){
 								// search for a location along the transect where criteria is met
-								if(data.avg[index1+1] < prms.tDT
-										&& data.avg[index1] >= prms.tDT){
-									data.dune_toe_line[index1] = 1;
+								if(avgt[tindex+hdr.nlines] < prms.tDT
+										&& avgt[tindex] >= prms.tDT){
+									data.mark(index1, DUNE_TOE_BIT);
 									dunetoe_pos = i;
-									dunetoey = data.y[index1];
-									dunetoez = data.z[index1];
+									dunetoey = hdr.ycoord(i);
+									dunetoez = zt[tindex];
 									break;
 								} else{
 									dunetoe_pos = 0;
@@ -1073,27 +1268,28 @@ int main (){
 					// extract DUNE CREST
 					////////////////////////
 					if(prms.oProduct.compare("dunecrest")==0 || prms.oProduct.compare("duneheel")==0 || prms.oProduct.compare("backbarrier")==0 || prms.oProduct.compare("landforms")==0 || prms.oProduct.compare("all")==0){
-						for(i=dunetoe_pos; i>-1; --i){		// read TOP to BOTTOM starting at shoreline
+						for(int i=dunetoe_pos; i>-1; --i){		// read TOP to BOTTOM starting at shoreline
 							index1 = (i*hdr.ncols)+j;
+							tindex = (j*hdr.nlines)+i;
 
 							// IF the center pixel is within the limits of the image...
 							if(i>buffer && i<hdr.nlines-buffer && j>buffer+1 && j<hdr.ncols-buffer-1 && i>dunetoe_pos){
 								// search for a location along the transect where criteria is met
-								if(data.avg[index1] >= prms.tDC
-										&& data.avg[index1-1] < prms.tDC
-										&& data.avg[index1-1]!=-9999
-										&& data.avg[index1]!=-9999
-										&& data.z[index1]!=-9999
+								if(avgt[tindex] >= prms.tDC
+										&& avgt[tindex-hdr.nlines] < prms.tDC
+										&& avgt[tindex-hdr.nlines]!=-9999
+										&& avgt[tindex]!=-9999
+										&& data.valid(i, j)
 										// if pixel is greater than minimum distance back from the dune toe
 										&& abs(dunetoe_pos-i)*hdr.yres > prms.tCrestDistMin
 										// if pixel is less than maximum distance back from the dune toe
 										&& abs(dunetoe_pos-i)*hdr.yres < prms.tCrestDistMax
 										// If pixel is higher than dune toe
-										&& dunetoez<data.z[index1]){
-									data.dune_ridge_line[index1] = 1;
+										&& dunetoez<zt[tindex]){
+									data.mark(index1, DUNE_CREST_BIT);
 									dunecrest_pos = i;
-									dunecresty = data.y[index1];
-									dunecrestz = data.z[index1];
+									dunecresty = hdr.ycoord(i);
+									dunecrestz = zt[tindex];
 									break;
 								} else{
 									dunecrest_pos = 0;
@@ -1108,24 +1304,25 @@ int main (){
 					// extract DUNE HEEL
 					///////////////////////
 					if(prms.oProduct.compare("duneheel")==0 || prms.oProduct.compare("backbarrier")==0 || prms.oProduct.compare("landforms")==0 || prms.oProduct.compare("all")==0){
-						for(i=dunecrest_pos; i>-1; --i){		// read TOP to BOTTOM starting at shoreline
+						for(int i=dunecrest_pos; i>-1; --i){		// read TOP to BOTTOM starting at shoreline
 							index1 = (i*hdr.ncols)+j;
+							tindex = (j*hdr.nlines)+i;
 
 							// IF the center pixel is within the limits of the image...
 							if(i>buffer && i<hdr.nlines-buffer && j>buffer+1 && j<hdr.ncols-buffer-1 && i>dunecrest_pos){
-								if(data.avg[index1] >= prms.tDH
-										&& data.avg[index1-1] < prms.tDH
-										&& data.avg[index1-1]!=-9999
-										&& data.avg[index1]!=-9999
-										&& data.z[index1]!=-9999
+								if(avgt[tindex] >= prms.tDH
+										&& avgt[tindex-hdr.nlines] < prms.tDH
+										&& avgt[tindex-hdr.nlines]!=-9999
+										&& avgt[tindex]!=-9999
+										&& data.valid(i, j)
 										// if pixel is greater than minimum distance back from the dune crest
 										&& abs(dunecrest_pos-i)*hdr.yres > prms.tHeelDistMin
 										// if pixel is less than maximum distance back from the dune crest
 										&& abs(dunecrest_pos-i)*hdr.yres < prms.tHeelDistMax){
-									data.dune_heel_line[index1] = 1;
+									data.mark(index1, DUNE_HEEL_BIT);
 									duneheel_pos = i;
-									duneheely = data.y[index1];
-									duneheelz = data.z[index1];
+									duneheely = hdr.ycoord(i);
+									duneheelz = zt[tindex];
 									break;
 								} else{
 									duneheel_pos = 0;
@@ -1151,19 +1348,20 @@ int main (){
 							backstart = shoreline_pos;
 						}
 
-						for(i=backstart; i>-1; --i){		// read TOP to BOTTOM starting at shoreline
+						for(int i=backstart; i>-1; --i){		// read TOP to BOTTOM starting at shoreline
 							index1 = (i*hdr.ncols)+j;
+							tindex = (j*hdr.nlines)+i;
 
 							// IF the center pixel is within the limits of the image...
 							if(i>buffer && i<hdr.nlines-buffer && j>buffer+1 && j<hdr.ncols-buffer-1){
 								//cout << j << " - " << index1 << " - " << data[index1-1].z << endl;
-								if(data.z[index1-1] < prms.tBB
-										&& data.z[index1] >= prms.tBB
-										&& data.z[index1]!=-9999){
-									data.backbarrier_line[index1] = 1;
+								if((!data.valid(i, j-1) || zt[tindex-hdr.nlines] < prms.tBB)
+										&& zt[tindex] >= prms.tBB
+										&& data.valid(i, j)){
+									data.mark(index1, BACKBARRIER_BIT);
 									backbarrier_pos = i;
-									backbarriery = data.y[index1];
-									backbarrierz = data.z[index1];
+									backbarriery = hdr.ycoord(i);
+									backbarrierz = zt[tindex];
 									break;
 								} else{
 									backbarrier_pos = 0;
@@ -1176,8 +1374,9 @@ int main (){
 					//////////////////////
 					// calculate VOLUMES
 					//////////////////////
-					for(i=0; i<hdr.nlines; ++i){
+					for(int i=0; i<hdr.nlines; ++i){
 						index1 = (i*hdr.ncols)+j;
+						tindex = (j*hdr.nlines)+i;
 						int a = 0;
 						///////////////////////////
 						// calculate BEACH VOLUME
@@ -1186,9 +1385,9 @@ int main (){
 							if(i<=shoreline_pos
 									&& i>=dunetoe_pos
 									&& dunetoe_pos!=0
-									&& data.z[index1]>=prms.tShoreline){
+									&& data.valid(i, j) && zt[tindex]>=prms.tShoreline){
 								if(a<=(shoreliney-dunetoey)*hdr.yres){
-									beach_vol += (data.z[index1]-prms.tShoreline)*hdr.xres*hdr.yres;
+									beach_vol += (zt[tindex]-prms.tShoreline)*hdr.xres*hdr.yres;
 								}
 							} else{
 								beach_vol += 0;
@@ -1203,8 +1402,8 @@ int main (){
 							if(i<=dunetoe_pos
 									&& i>=duneheel_pos
 									&& duneheel_pos!=0
-									&& data.z[index1]>=prms.tShoreline){
-								dune_vol += (data.z[index1]-prms.tShoreline)*hdr.xres*hdr.yres;
+									&& data.valid(i, j) && zt[tindex]>=prms.tShoreline){
+								dune_vol += (zt[tindex]-prms.tShoreline)*hdr.xres*hdr.yres;
 							} else{
 								dune_vol += 0;
 							}
@@ -1219,8 +1418,8 @@ int main (){
 								&& i>=backbarrier_pos
 								&& backbarrierz!=-99999
 								&& shoreline_pos!=0
-								&& data.z[index1]>=prms.tShoreline){
-							island_vol += (data.z[index1]-prms.tShoreline)*hdr.xres*hdr.yres;
+								&& data.valid(i, j) && zt[tindex]>=prms.tShoreline){
+							island_vol += (zt[tindex]-prms.tShoreline)*hdr.xres*hdr.yres;
 						} else{
 							island_vol += 0;
 						}
@@ -1231,21 +1430,22 @@ int main (){
 				// output ASCII format text files (if requested by user input)
 				/////////////////////////////////////////////////////
 				if(prms.oFormat.compare("ascii")==0 || prms.oFormat.compare("both")==0){
-					// write out the desired products to the ascii file
+					// write out the desired products to the ascii file (the first column is
+					// computed from the row index the volume loop ends on, hdr.nlines)
 					if(prms.oProduct.compare("shoreline")==0 && shorelinez>=hdr.zmin && shoreliney<hdr.uly && shoreliney>hdr.ymin){
-						(void) fprintf(landforms_metrics, "%lf.10, %lf.10, %lf.10\n", (i*hdr.yres)+hdr.ulx, (float)shoreliney, (float)shorelinez);
+						landforms_metrics.line((hdr.nlines*hdr.yres)+hdr.ulx, shoreliney, (float)shorelinez);
 					}
 					if(prms.oProduct.compare("dunetoe")==0 && dunetoez>=hdr.zmin && dunetoey<hdr.uly && dunetoey>hdr.ymin){
-						(void) fprintf(landforms_metrics, "%lf.10, %lf.10, %lf.10\n", (i*hdr.yres)+hdr.ulx, (float)dunetoey, (float)dunetoez);
+						landforms_metrics.line((hdr.nlines*hdr.yres)+hdr.ulx, dunetoey, (float)dunetoez);
 					}
 					if(prms.oProduct.compare("dunecrest")==0 && dunecrestz>=hdr.zmin && dunecresty<hdr.uly && dunecresty>hdr.ymin){
-						(void) fprintf(landforms_metrics, "%lf.10, %lf.10, %lf.10\n", (i*hdr.yres)+hdr.ulx, (float)dunecresty, (float)dunecrestz);
+						landforms_metrics.line((hdr.nlines*hdr.yres)+hdr.ulx, dunecresty, (float)dunecrestz);
 					}
 					if(prms.oProduct.compare("duneheel")==0 && duneheelz>=hdr.zmin && duneheely<hdr.uly && duneheely>hdr.ymin){
-						(void) fprintf(landforms_metrics, "%lf.10, %lf.10, %lf.10\n", (i*hdr.yres)+hdr.ulx, (float)duneheely, (float)duneheelz);
+						landforms_metrics.line((hdr.nlines*hdr.yres)+hdr.ulx, duneheely, (float)duneheelz);
 					}
 					if(prms.oProduct.compare("backbarrier")==0 && backbarrierz>=hdr.zmin && backbarriery<hdr.uly && backbarriery>hdr.ymin){
-						(void) fprintf(landforms_metrics, "%lf.10, %lf.10, %lf.10\n", (i*hdr.yres)+hdr.ulx, (float)backbarriery, (float)backbarrierz);
+						landforms_metrics.line((hdr.nlines*hdr.yres)+hdr.ulx, backbarriery, (float)backbarrierz);
 					}
 					if((prms.oProduct.compare("landforms")==0 || prms.oProduct.compare("all")==0) && xcoord!=0){
 							double dh, bw, iw;
@@ -1282,13 +1482,13 @@ int main (){
 							}
 							
 							// write values to the log file
-							(void) fprintf(landforms_metrics, "%lf.10, ", (float)xcoord);
-							(void) fprintf(landforms_metrics, "%lf.10, %lf.10, ", (float)shoreliney, (float)shorelinez);
-							(void) fprintf(landforms_metrics, "%lf.10, %lf.10, ", (float)dunetoey, (float)dunetoez);
-							(void) fprintf(landforms_metrics, "%lf.10, %lf.10, ", (float)dunecresty, (float)dunecrestz);
-							(void) fprintf(landforms_metrics, "%lf.10, %lf.10, ", (float)duneheely, (float)duneheelz);
-							(void) fprintf(landforms_metrics, "%lf.10, %lf.10, ", (float)backbarriery, (float)backbarrierz);
-							(void) fprintf(landforms_metrics, "%lf.10, %lf.10, %lf.10, %lf.10, %lf.10, %lf.10\n",
+							landforms_metrics.fields(xcoord);
+							landforms_metrics.fields(shoreliney, (float)shorelinez);
+							landforms_metrics.fields(dunetoey, (float)dunetoez);
+							landforms_metrics.fields(dunecresty, (float)dunecrestz);
+							landforms_metrics.fields(duneheely, (float)duneheelz);
+							landforms_metrics.fields(backbarriery, (float)backbarrierz);
+							landforms_metrics.line(
 								(float)bw,
 								(float)beach_vol,
 								(float)dh,
@@ -1301,62 +1501,157 @@ int main (){
 			}
 		}
 	}
-	// if output Products is specified as "rr" only, then no need to compute all landform metrics
-	// the following block only computes the relative relief values for 3 scales + an average value
-	else if(prms.oProduct.compare("rr")==0){
-		////////////////////////////////////////////
-		// Calculate Relative Relief
-		///////////////////////////////////////////
-		// iterate through all columns from top to bottom
-		for(i=0; i<hdr.nlines; ++i){
-			int index1;			// index for analyzing the data
-			double ycoord = 0;
-
-			// iterate through all rows from left to right
-			for(j=0; j<hdr.ncols; ++j){
-				index1 = (i*hdr.ncols)+j;
-
-				// IF the center pixel is within the buffer distance to the image edge
-				if(i<buffer || i>hdr.nlines-buffer || j<buffer || j>hdr.ncols-buffer){
-					data.res[index1] = -9999;
-					data.res_plus1[index1] = -9999;
-					data.res_plus2[index1] = -9999;
-					data.avg[index1] = -9999;
-				}
+	// if output Products is specified as "rr" only, then no need to compute all landform metrics:
+	// the pipeline masks the relative relief at the raster edges and writes it out
 
-				// IF the center pixel is NOT NULL, then continue...
-				else if(data.z[index1] > -100){
-					// compute relative relief
-					data.computeRelativeRelief(i, j, buffer, hdr);
-				}
+	/////////////////////////////////////////////////////
+	// output ENVI format rasters (if requested by user input)
+	/////////////////////////////////////////////////////
+	if(prms.oFormat.compare("envi")==0 || prms.oFormat.compare("both")==0 || prms.oProduct.compare("rr")==0){
+		cout << "Writing out ENVI format products." << endl;
+	}
 
-				// IF the center pixel contains a NULL value, then set all the calculated attributes to NULL.
-				else{
-					data.res[index1] = -9999;
-					data.res_plus1[index1] = -9999;
-					data.res_plus2[index1] = -9999;
-					data.avg[index1] = -9999;
-				}
-			}
+	// wait for the relative relief and the ENVI rasters to be finished
+	if(!pipe.finish()){
+		return false;
+	}
+
+	// (the shore band leaves the relative relief outside the band uncomputed)
+	if(!prms.rrCache.empty() && !cached && !prms.shoreBand){
+		if(cache.store(data)){
+			cout << "Stored the relative relief in the cache: " << cache.path() << endl;
+		} else{
+			cout << "WARNING: Cannot write the relative relief cache entry " << cache.path() << endl;
+		}
+	}
+
+	// one line of metrics per parameter set of the sweep
+	if(!prms.sweep.empty()){
+		string csv_outname = prms.csvMetrics() ? prms.outName() + "_SWEEP.csv" : "";
+		string arrow_outname = prms.arrowMetrics() ? prms.outName() + "_SWEEP.arrow" : "";
+		if(!sweep.write(csv_outname, arrow_outname)){
+			cout << "ERROR: Cannot write the sweep metrics: " << (csv_outname.empty() ? arrow_outname : csv_outname) << endl;
+			return false;
 		}
+		cout << "Successfully wrote the metrics of the sweep to " << (csv_outname.empty() ? arrow_outname : csv_outname)
+			<< ((csv_outname.empty() || arrow_outname.empty()) ? "" : " and " + arrow_outname) << endl;
 	}
 
 	cout << "   Processing successful!\n" << endl;
 
-	if(prms.oFormat.compare("ascii")==0 || prms.oFormat.compare("both")==0){
+	if(!tile && landforms_metrics.is_open()){
 		// close the output ascii file
-		fclose(landforms_metrics);
-		cout << "Successfully wrote landform metrics to CSV file." << endl;
+		if(!landforms_metrics.close()){
+			cout << "ERROR: Cannot write ascii data file!" << endl;
+			return false;
+		}
+		if(prms.csvMetrics()){
+			cout << "Successfully wrote landform metrics to CSV file." << endl;
+		}
+		if(prms.arrowMetrics()){
+			cout << "Successfully wrote landform metrics to Arrow file." << endl;
+		}
 	}
 
-	/////////////////////////////////////////////////////
-	// output ENVI format rasters (if requested by user input)
-	/////////////////////////////////////////////////////
-	if(prms.oFormat.compare("envi")==0 || prms.oFormat.compare("both")==0 || prms.oProduct.compare("rr")==0){
-		cout << "Writing out ENVI format products." << endl;
+	return true;
+}
+
 
-		//write out the ENVI products specified
-		data.writeENVIs(prms.iFile, hdr, prms);
+// process every DEM of spec (a manifest file or a glob pattern) with the shared
+// parameters on one work-stealing pool, then write the landform metrics of all
+// tiles to one merged file and a summary of the batch
+static int runBatch(Params prms, string spec, bool mosaic){
+	vector<string> names;
+	size_t t;
+
+	if(!listBatchTiles(spec, names)) return 1;
+	string base = batchBaseName(spec);
+
+	// the tiles as one raster: the relative relief is seamless across tiles
+	Mosaic grid;
+	if(mosaic){
+		if(!grid.build(names, prms)) return 1;
+		cout << "Mosaic of " << grid.ncols << " x " << grid.nlines << " pixels" << endl;
+	}
+
+	WorkPool pool(prms.nThreads);
+	vector<BatchTile> tiles(names.size());
+
+	cout << "Batch of " << names.size() << " DEM tile(s) on " << pool.size() << " thread(s)\n" << endl;
+	for(t=0; t<tiles.size(); ++t){
+		tiles[t].name = names[t];
+		tiles[t].pool = &pool;
+		tiles[t].mosaic = mosaic ? &grid : NULL;
+		pool.addTile([&prms, &tiles, t](){
+			Params tp = prms;
+			tp.iFile = tiles[t].name;
+			chrono::steady_clock::time_point t0 = chrono::steady_clock::now();
+			tiles[t].ok = processDEM(tp, &tiles[t]);
+			tiles[t].seconds = chrono::duration<double>(chrono::steady_clock::now()-t0).count();
+		});
+	}
+	chrono::steady_clock::time_point start = chrono::steady_clock::now();
+	pool.run();
+	double seconds = chrono::duration<double>(chrono::steady_clock::now()-start).count();
+
+	size_t failed = 0, transects = 0;
+	for(t=0; t<tiles.size(); ++t){
+		failed += tiles[t].ok ? 0 : 1;
+		transects += tiles[t].metrics.rows();
 	}
-	return 0;
+
+	// the landform metrics of every tile, in the order of the batch
+	if(prms.oProduct.compare("rr")!=0 && (prms.oFormat.compare("ascii")==0 || prms.oFormat.compare("both")==0)){
+		string csv_outname = prms.csvMetrics() ? base + "_ISLAND_METRICS.csv" : "";
+		string arrow_outname = prms.arrowMetrics() ? base + "_ISLAND_METRICS.arrow" : "";
+		MetricsWriter merged;
+
+		if(!merged.open(csv_outname, arrow_outname)){
+			cout << "ERROR: Cannot write ascii data file: " << (csv_outname.empty() ? arrow_outname : csv_outname) << endl;
+			return 1;
+		}
+		merged.textColumn("tile");
+		metricsColumns(merged, prms);
+		for(t=0; t<tiles.size(); ++t){
+			if(tiles[t].ok){
+				merged.append(tiles[t].metrics, tiles[t].name);
+			}
+		}
+		if(!merged.close()){
+			cout << "ERROR: Cannot write ascii data file!" << endl;
+			return 1;
+		}
+		if(!csv_outname.empty()){
+			cout << "Successfully wrote the landform metrics of the batch to " << csv_outname << endl;
+		}
+		if(!arrow_outname.empty()){
+			cout << "Successfully wrote the landform metrics of the batch to " << arrow_outname << endl;
+		}
+	}
+
+	// one line per tile
+	string summary_outname = base + "_BATCH_SUMMARY.csv";
+	ofstream summary(summary_outname.c_str());
+	summary << "tile, status, ncols, nlines, transects, seconds\n";
+	for(t=0; t<tiles.size(); ++t){
+		summary << tiles[t].name << ", " << (tiles[t].ok ? "ok" : "failed") << ", " << tiles[t].ncols << ", " << tiles[t].nlines << ", " << tiles[t].metrics.rows() << ", " << tiles[t].seconds << "\n";
+	}
+	summary.close();
+	if(!summary){
+		cout << "ERROR: Cannot write " << summary_outname << endl;
+		return 1;
+	}
+
+	cout << "\nBATCH SUMMARY:" << endl;
+	cout << "Tiles processed: " << tiles.size()-failed << " of " << tiles.size() << endl;
+	for(t=0; t<tiles.size(); ++t){
+		if(!tiles[t].ok){
+			cout << "   FAILED: " << tiles[t].name << endl;
+		}
+	}
+	cout << "Transects with landform metrics: " << transects << endl;
+	cout << "Elapsed time: " << seconds << " s" << endl;
+	cout << "Tile summary: " << summary_outname << endl;
+
+	return failed ? 1 : 0;
 }
@@ -0,0 +1,838 @@
+#include "rr_kernels.hpp"
+#include <stdlib.h>
+#include <string.h>
+#include <iostream>
+#include <limits>
+#include <string>
+#include <vector>
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define RR_X86_KERNELS 1
+#include <immintrin.h>
+#endif
+
+using namespace std;
+
+///////////////////////////////////////////////////////////////
+// SCALAR KERNELS (reference, and tails of the SIMD kernels)
+///////////////////////////////////////////////////////////////
+// validity bit of pixel j
+static inline bool validBit(const uint64_t *valid, int j){
+	return (valid[j>>6] >> (j&63)) & 1;
+}
+
+// the scalar kernels from pixel j on (also the tails of the SIMD kernels, whose
+// validity bits cannot be offset by a pointer)
+static void maskRange(const float *src, const uint64_t *valid, float *out, int j, int n, float sign){
+	const float inf = numeric_limits<float>::infinity();
+
+	for(; j<n; ++j){
+		out[j] = validBit(valid, j) ? sign*src[j] : inf;
+	}
+}
+
+static void maskScalar(const float *src, const uint64_t *valid, float *out, int n, float sign){
+	maskRange(src, valid, out, 0, n, sign);
+}
+
+static void minimumScalar(const float *a, const float *b, float *out, int n, float sign){
+	int j;
+
+	for(j=0; j<n; ++j){
+		out[j] = sign*((a[j] < b[j]) ? a[j] : b[j]);
+	}
+}
+
+static void reliefScalar(const float *z, const float *z_min, const float *z_max, float *rr, double *sum, int n, double weight){
+	int j;
+
+	for(j=0; j<n; ++j){
+		rr[j] = (z[j] - z_min[j])/(z_max[j] - z_min[j]);
+		sum[j] += weight*rr[j];
+	}
+}
+
+static void averageRange(const uint64_t *valid, const double *sum, float *avg, int j, int n, double wsum){
+	for(; j<n; ++j){
+		avg[j] = validBit(valid, j) ? (float)(sum[j]/wsum) : -9999;
+	}
+}
+
+static void averageScalar(const uint64_t *valid, const double *sum, float *avg, int n, double wsum){
+	averageRange(valid, sum, avg, 0, n, wsum);
+}
+
+static void nullifyRange(const uint64_t *valid, float *out, int j, int n){
+	for(; j<n; ++j){
+		if(!validBit(valid, j)){
+			out[j] = -9999;
+		}
+	}
+}
+
+static void nullifyScalar(const uint64_t *valid, float *out, int n){
+	nullifyRange(valid, out, 0, n);
+}
+
+// clear the validity words of n pixels
+static void clearBits(uint64_t *bits, int n){
+	memset(bits, 0, (size_t)((n+63)/64)*sizeof(uint64_t));
+}
+
+static void validityRange(const float *z, uint64_t *bits, int j, int n, float floor, float nodata){
+	for(; j<n; ++j){
+		if(z[j] > floor && z[j] != nodata){
+			bits[j>>6] |= (uint64_t)1 << (j&63);
+		}
+	}
+}
+
+static void validityScalar(const float *z, uint64_t *bits, int n, float floor, float nodata){
+	clearBits(bits, n);
+	validityRange(z, bits, 0, n, floor, nodata);
+}
+
+// values j to n-1 of type T (the raw values need not be aligned)
+template <class T>
+static void convertValues(const unsigned char *src, float *dst, int j, int n, bool swap){
+	unsigned char b[sizeof(T)];
+	size_t k;
+	T v;
+
+	for(; j<n; ++j){
+		memcpy(b, src+(size_t)j*sizeof(T), sizeof(T));
+		if(swap){
+			for(k=0; k<sizeof(T)/2; ++k){
+				unsigned char t = b[k];
+				b[k] = b[sizeof(T)-1-k];
+				b[sizeof(T)-1-k] = t;
+			}
+		}
+		memcpy(&v, b, sizeof(T));
+		dst[j] = (float)v;
+	}
+}
+
+static void convertRange(const void *src, float *dst, int j, int n, int datatype, bool swap){
+	const unsigned char *p = (const unsigned char*)src;
+
+	switch(datatype){
+		case 1: convertValues<uint8_t>(p, dst, j, n, swap); break;
+		case 2: convertValues<int16_t>(p, dst, j, n, swap); break;
+		case 3: convertValues<int32_t>(p, dst, j, n, swap); break;
+		case 4: convertValues<float>(p, dst, j, n, swap); break;
+		case 5: convertValues<double>(p, dst, j, n, swap); break;
+		case 12: convertValues<uint16_t>(p, dst, j, n, swap); break;
+		case 13: convertValues<uint32_t>(p, dst, j, n, swap); break;
+		case 14: convertValues<int64_t>(p, dst, j, n, swap); break;
+		case 15: convertValues<uint64_t>(p, dst, j, n, swap); break;
+	}
+}
+
+static void convertScalar(const void *src, float *dst, int n, int datatype, bool swap){
+	convertRange(src, dst, 0, n, datatype, swap);
+}
+
+static int crossingRange(float z, float zn, bool okn, int j, int step, const float *t, const int *from, int *pos, int *done, int k, int n){
+	int open = 0;
+
+	for(; k<n; ++k){
+		int hit = !done[k] & ((j-from[k])*step >= 0) & (z >= t[k]) & (!okn | (zn < t[k]));
+		pos[k] = hit ? j : pos[k];
+		done[k] |= hit;
+		open += !done[k];
+	}
+	return open;
+}
+
+static int crossingScalar(float z, float zn, bool okn, int j, int step, const float *t, const int *from, int *pos, int *done, int n){
+	return crossingRange(z, zn, okn, j, step, t, from, pos, done, 0, n);
+}
+
+static void volumeRange(float z, int j, float xres, float yres, const float *t, const int *lo, const int *hi, double *sum, int k, int n){
+	for(; k<n; ++k){
+		float v = (z-t[k])*xres*yres;
+		sum[k] += (z >= t[k] && lo[k] <= j && j <= hi[k]) ? v : 0;
+	}
+}
+
+static void volumeScalar(float z, int j, float xres, float yres, const float *t, const int *lo, const int *hi, double *sum, int n){
+	volumeRange(z, j, xres, yres, t, lo, hi, sum, 0, n);
+}
+
+#ifdef RR_X86_KERNELS
+
+///////////////////////////////////////////////////////////////
+// SSE4.1 KERNELS (4 pixels per instruction)
+///////////////////////////////////////////////////////////////
+// lane mask of the 4 validity bits of pixels j to j+3
+__attribute__((target("sse4.1")))
+static inline __m128 validSSE4(const uint64_t *valid, int j){
+	const __m128i lanes = _mm_setr_epi32(1, 2, 4, 8);
+	__m128i b = _mm_set1_epi32((int)((valid[j>>6] >> (j&63)) & 0xF));
+	return _mm_castsi128_ps(_mm_cmpeq_epi32(_mm_and_si128(b, lanes), lanes));
+}
+
+__attribute__((target("sse4.1")))
+static void maskSSE4(const float *src, const uint64_t *valid, float *out, int n, float sign){
+	const __m128 inf = _mm_set1_ps(numeric_limits<float>::infinity());
+	const __m128 s = _mm_set1_ps(sign);
+	int j;
+
+	for(j=0; j+4<=n; j+=4){
+		__m128 v = _mm_loadu_ps(src+j);
+		_mm_storeu_ps(out+j, _mm_blendv_ps(inf, _mm_mul_ps(s, v), validSSE4(valid, j)));
+	}
+	maskRange(src, valid, out, j, n, sign);
+}
+
+__attribute__((target("sse4.1")))
+static void minimumSSE4(const float *a, const float *b, float *out, int n, float sign){
+	const __m128 s = _mm_set1_ps(sign);
+	int j;
+
+	for(j=0; j+4<=n; j+=4){
+		// _mm_min_ps(a, b) == (a < b) ? a : b, matching the scalar kernel exactly
+		__m128 v = _mm_min_ps(_mm_loadu_ps(a+j), _mm_loadu_ps(b+j));
+		_mm_storeu_ps(out+j, _mm_mul_ps(s, v));
+	}
+	minimumScalar(a+j, b+j, out+j, n-j, sign);
+}
+
+__attribute__((target("sse4.1")))
+static void reliefSSE4(const float *z, const float *z_min, const float *z_max, float *rr, double *sum, int n, double weight){
+	const __m128d wt = _mm_set1_pd(weight);
+	int j;
+
+	for(j=0; j+4<=n; j+=4){
+		__m128 mn = _mm_loadu_ps(z_min+j);
+		__m128 r = _mm_div_ps(_mm_sub_ps(_mm_loadu_ps(z+j), mn), _mm_sub_ps(_mm_loadu_ps(z_max+j), mn));
+		_mm_storeu_ps(rr+j, r);
+		_mm_storeu_pd(sum+j, _mm_add_pd(_mm_loadu_pd(sum+j), _mm_mul_pd(wt, _mm_cvtps_pd(r))));
+		_mm_storeu_pd(sum+j+2, _mm_add_pd(_mm_loadu_pd(sum+j+2), _mm_mul_pd(wt, _mm_cvtps_pd(_mm_movehl_ps(r, r)))));
+	}
+	reliefScalar(z+j, z_min+j, z_max+j, rr+j, sum+j, n-j, weight);
+}
+
+__attribute__((target("sse4.1")))
+static void averageSSE4(const uint64_t *valid, const double *sum, float *avg, int n, double wsum){
+	const __m128 fill = _mm_set1_ps(-9999);
+	const __m128d ws = _mm_set1_pd(wsum);
+	int j;
+
+	for(j=0; j+4<=n; j+=4){
+		__m128 lo = _mm_cvtpd_ps(_mm_div_pd(_mm_loadu_pd(sum+j), ws));
+		__m128 hi = _mm_cvtpd_ps(_mm_div_pd(_mm_loadu_pd(sum+j+2), ws));
+		_mm_storeu_ps(avg+j, _mm_blendv_ps(fill, _mm_movelh_ps(lo, hi), validSSE4(valid, j)));
+	}
+	averageRange(valid, sum, avg, j, n, wsum);
+}
+
+__attribute__((target("sse4.1")))
+static void nullifySSE4(const uint64_t *valid, float *out, int n){
+	const __m128 fill = _mm_set1_ps(-9999);
+	int j;
+
+	for(j=0; j+4<=n; j+=4){
+		_mm_storeu_ps(out+j, _mm_blendv_ps(fill, _mm_loadu_ps(out+j), validSSE4(valid, j)));
+	}
+	nullifyRange(valid, out, j, n);
+}
+
+__attribute__((target("sse4.1")))
+static void validitySSE4(const float *z, uint64_t *bits, int n, float floor, float nodata){
+	const __m128 fl = _mm_set1_ps(floor);
+	const __m128 nd = _mm_set1_ps(nodata);
+	int j;
+
+	clearBits(bits, n);
+	for(j=0; j+4<=n; j+=4){
+		__m128 v = _mm_loadu_ps(z+j);
+		__m128 m = _mm_and_ps(_mm_cmpgt_ps(v, fl), _mm_cmpneq_ps(v, nd));
+		bits[j>>6] |= (uint64_t)_mm_movemask_ps(m) << (j&63);
+	}
+	validityRange(z, bits, j, n, floor, nodata);
+}
+
+// pshufb order that reverses the bytes of every value of `size` bytes
+__attribute__((target("sse4.1")))
+static inline __m128i byteOrderSSE4(int size){
+	if(size == 2) return _mm_setr_epi8(1, 0, 3, 2, 5, 4, 7, 6, 9, 8, 11, 10, 13, 12, 15, 14);
+	if(size == 4) return _mm_setr_epi8(3, 2, 1, 0, 7, 6, 5, 4, 11, 10, 9, 8, 15, 14, 13, 12);
+	return _mm_setr_epi8(7, 6, 5, 4, 3, 2, 1, 0, 15, 14, 13, 12, 11, 10, 9, 8);
+}
+
+// 16 raw bytes, byte-swapped with order if swap
+__attribute__((target("sse4.1")))
+static inline __m128i loadSSE4(const unsigned char *p, bool swap, __m128i order){
+	__m128i v = _mm_loadu_si128((const __m128i*)p);
+	return swap ? _mm_shuffle_epi8(v, order) : v;
+}
+
+// 8-bit, 16-bit, 32-bit and float64 values are converted 4 at a time; the
+// 32/64-bit integer types use the scalar kernel
+__attribute__((target("sse4.1")))
+static void convertSSE4(const void *src, float *dst, int n, int datatype, bool swap){
+	const unsigned char *p = (const unsigned char*)src;
+	int j = 0;
+
+	if(datatype == 1){
+		for(; j+4<=n; j+=4){
+			int32_t b;
+			memcpy(&b, p+j, 4);
+			_mm_storeu_ps(dst+j, _mm_cvtepi32_ps(_mm_cvtepu8_epi32(_mm_cvtsi32_si128(b))));
+		}
+	} else if(datatype == 2 || datatype == 12){
+		const __m128i order = byteOrderSSE4(2);
+		for(; j+8<=n; j+=8){
+			__m128i v = loadSSE4(p+(size_t)j*2, swap, order);
+			__m128i hi = _mm_srli_si128(v, 8);
+			__m128i a = (datatype == 2) ? _mm_cvtepi16_epi32(v) : _mm_cvtepu16_epi32(v);
+			__m128i b = (datatype == 2) ? _mm_cvtepi16_epi32(hi) : _mm_cvtepu16_epi32(hi);
+			_mm_storeu_ps(dst+j, _mm_cvtepi32_ps(a));
+			_mm_storeu_ps(dst+j+4, _mm_cvtepi32_ps(b));
+		}
+	} else if(datatype == 3 || datatype == 4){
+		const __m128i order = byteOrderSSE4(4);
+		for(; j+4<=n; j+=4){
+			__m128i v = loadSSE4(p+(size_t)j*4, swap, order);
+			_mm_storeu_ps(dst+j, (datatype == 3) ? _mm_cvtepi32_ps(v) : _mm_castsi128_ps(v));
+		}
+	} else if(datatype == 5){
+		const __m128i order = byteOrderSSE4(8);
+		for(; j+4<=n; j+=4){
+			__m128 a = _mm_cvtpd_ps(_mm_castsi128_pd(loadSSE4(p+(size_t)j*8, swap, order)));
+			__m128 b = _mm_cvtpd_ps(_mm_castsi128_pd(loadSSE4(p+(size_t)j*8+16, swap, order)));
+			_mm_storeu_ps(dst+j, _mm_movelh_ps(a, b));
+		}
+	}
+	convertRange(src, dst, j, n, datatype, swap);
+}
+
+__attribute__((target("sse4.1")))
+static int crossingSSE4(float z, float zn, bool okn, int j, int step, const float *t, const int *from, int *pos, int *done, int n){
+	const __m128 zv = _mm_set1_ps(z), znv = _mm_set1_ps(zn);
+	const __m128 nullNext = _mm_castsi128_ps(_mm_set1_epi32(okn ? 0 : -1));
+	const __m128i jv = _mm_set1_epi32(j), sv = _mm_set1_epi32(step);
+	const __m128i zero = _mm_setzero_si128(), one = _mm_set1_epi32(1);
+	int k, open = 0;
+
+	for(k=0; k+4<=n; k+=4){
+		__m128 tv = _mm_loadu_ps(t+k);
+		__m128i d = _mm_loadu_si128((const __m128i*)(done+k));
+		__m128i behind = _mm_cmpgt_epi32(zero, _mm_mullo_epi32(_mm_sub_epi32(jv, _mm_loadu_si128((const __m128i*)(from+k))), sv));
+		__m128 cross = _mm_and_ps(_mm_cmple_ps(tv, zv), _mm_or_ps(_mm_cmplt_ps(znv, tv), nullNext));
+		__m128i hit = _mm_and_si128(_mm_andnot_si128(behind, _mm_cmpeq_epi32(d, zero)), _mm_castps_si128(cross));
+		d = _mm_or_si128(d, _mm_and_si128(hit, one));
+		_mm_storeu_si128((__m128i*)(pos+k), _mm_blendv_epi8(_mm_loadu_si128((const __m128i*)(pos+k)), jv, hit));
+		_mm_storeu_si128((__m128i*)(done+k), d);
+		open += __builtin_popcount(_mm_movemask_ps(_mm_castsi128_ps(_mm_cmpeq_epi32(d, zero))));
+	}
+	return open + crossingRange(z, zn, okn, j, step, t, from, pos, done, k, n);
+}
+
+__attribute__((target("sse4.1")))
+static void volumeSSE4(float z, int j, float xres, float yres, const float *t, const int *lo, const int *hi, double *sum, int n){
+	const __m128 zv = _mm_set1_ps(z), xr = _mm_set1_ps(xres), yr = _mm_set1_ps(yres);
+	const __m128i jv = _mm_set1_epi32(j);
+	int k;
+
+	for(k=0; k+4<=n; k+=4){
+		__m128 tv = _mm_loadu_ps(t+k);
+		__m128i out = _mm_or_si128(_mm_cmpgt_epi32(_mm_loadu_si128((const __m128i*)(lo+k)), jv), _mm_cmpgt_epi32(jv, _mm_loadu_si128((const __m128i*)(hi+k))));
+		__m128 m = _mm_andnot_ps(_mm_castsi128_ps(out), _mm_cmple_ps(tv, zv));
+		// (the lanes left out add +0, as the scalar kernel does)
+		__m128 v = _mm_and_ps(m, _mm_mul_ps(_mm_mul_ps(_mm_sub_ps(zv, tv), xr), yr));
+		_mm_storeu_pd(sum+k, _mm_add_pd(_mm_loadu_pd(sum+k), _mm_cvtps_pd(v)));
+		_mm_storeu_pd(sum+k+2, _mm_add_pd(_mm_loadu_pd(sum+k+2), _mm_cvtps_pd(_mm_movehl_ps(v, v))));
+	}
+	volumeRange(z, j, xres, yres, t, lo, hi, sum, k, n);
+}
+
+///////////////////////////////////////////////////////////////
+// AVX2 KERNELS (8 pixels per instruction)
+///////////////////////////////////////////////////////////////
+// lane mask of the 8 validity bits of pixels j to j+7
+__attribute__((target("avx2")))
+static inline __m256 validAVX2(const uint64_t *valid, int j){
+	const __m256i lanes = _mm256_setr_epi32(1, 2, 4, 8, 16, 32, 64, 128);
+	__m256i b = _mm256_set1_epi32((int)((valid[j>>6] >> (j&63)) & 0xFF));
+	return _mm256_castsi256_ps(_mm256_cmpeq_epi32(_mm256_and_si256(b, lanes), lanes));
+}
+
+__attribute__((target("avx2")))
+static void maskAVX2(const float *src, const uint64_t *valid, float *out, int n, float sign){
+	const __m256 inf = _mm256_set1_ps(numeric_limits<float>::infinity());
+	const __m256 s = _mm256_set1_ps(sign);
+	int j;
+
+	for(j=0; j+8<=n; j+=8){
+		__m256 v = _mm256_loadu_ps(src+j);
+		_mm256_storeu_ps(out+j, _mm256_blendv_ps(inf, _mm256_mul_ps(s, v), validAVX2(valid, j)));
+	}
+	maskRange(src, valid, out, j, n, sign);
+}
+
+__attribute__((target("avx2")))
+static void minimumAVX2(const float *a, const float *b, float *out, int n, float sign){
+	const __m256 s = _mm256_set1_ps(sign);
+	int j;
+
+	for(j=0; j+8<=n; j+=8){
+		__m256 v = _mm256_min_ps(_mm256_loadu_ps(a+j), _mm256_loadu_ps(b+j));
+		_mm256_storeu_ps(out+j, _mm256_mul_ps(s, v));
+	}
+	minimumScalar(a+j, b+j, out+j, n-j, sign);
+}
+
+__attribute__((target("avx2")))
+static void reliefAVX2(const float *z, const float *z_min, const float *z_max, float *rr, double *sum, int n, double weight){
+	const __m256d wt = _mm256_set1_pd(weight);
+	int j;
+
+	for(j=0; j+8<=n; j+=8){
+		__m256 mn = _mm256_loadu_ps(z_min+j);
+		__m256 r = _mm256_div_ps(_mm256_sub_ps(_mm256_loadu_ps(z+j), mn), _mm256_sub_ps(_mm256_loadu_ps(z_max+j), mn));
+		_mm256_storeu_ps(rr+j, r);
+		_mm256_storeu_pd(sum+j, _mm256_add_pd(_mm256_loadu_pd(sum+j), _mm256_mul_pd(wt, _mm256_cvtps_pd(_mm256_castps256_ps128(r)))));
+		_mm256_storeu_pd(sum+j+4, _mm256_add_pd(_mm256_loadu_pd(sum+j+4), _mm256_mul_pd(wt, _mm256_cvtps_pd(_mm256_extractf128_ps(r, 1)))));
+	}
+	reliefScalar(z+j, z_min+j, z_max+j, rr+j, sum+j, n-j, weight);
+}
+
+__attribute__((target("avx2")))
+static void averageAVX2(const uint64_t *valid, const double *sum, float *avg, int n, double wsum){
+	const __m256 fill = _mm256_set1_ps(-9999);
+	const __m256d ws = _mm256_set1_pd(wsum);
+	int j;
+
+	for(j=0; j+8<=n; j+=8){
+		__m128 lo = _mm256_cvtpd_ps(_mm256_div_pd(_mm256_loadu_pd(sum+j), ws));
+		__m128 hi = _mm256_cvtpd_ps(_mm256_div_pd(_mm256_loadu_pd(sum+j+4), ws));
+		__m256 v = _mm256_insertf128_ps(_mm256_castps128_ps256(lo), hi, 1);
+		_mm256_storeu_ps(avg+j, _mm256_blendv_ps(fill, v, validAVX2(valid, j)));
+	}
+	averageRange(valid, sum, avg, j, n, wsum);
+}
+
+__attribute__((target("avx2")))
+static void nullifyAVX2(const uint64_t *valid, float *out, int n){
+	const __m256 fill = _mm256_set1_ps(-9999);
+	int j;
+
+	for(j=0; j+8<=n; j+=8){
+		_mm256_storeu_ps(out+j, _mm256_blendv_ps(fill, _mm256_loadu_ps(out+j), validAVX2(valid, j)));
+	}
+	nullifyRange(valid, out, j, n);
+}
+
+__attribute__((target("avx2")))
+static void validityAVX2(const float *z, uint64_t *bits, int n, float floor, float nodata){
+	const __m256 fl = _mm256_set1_ps(floor);
+	const __m256 nd = _mm256_set1_ps(nodata);
+	int j;
+
+	clearBits(bits, n);
+	for(j=0; j+8<=n; j+=8){
+		__m256 v = _mm256_loadu_ps(z+j);
+		__m256 m = _mm256_and_ps(_mm256_cmp_ps(v, fl, _CMP_GT_OQ), _mm256_cmp_ps(v, nd, _CMP_NEQ_UQ));
+		bits[j>>6] |= (uint64_t)_mm256_movemask_ps(m) << (j&63);
+	}
+	validityRange(z, bits, j, n, floor, nodata);
+}
+
+// 32 raw bytes, byte-swapped with order (per 16-byte lane) if swap
+__attribute__((target("avx2")))
+static inline __m256i loadAVX2(const unsigned char *p, bool swap, __m256i order){
+	__m256i v = _mm256_loadu_si256((const __m256i*)p);
+	return swap ? _mm256_shuffle_epi8(v, order) : v;
+}
+
+// as convertSSE4, 8 values at a time (also used by the AVX-512 kernels)
+__attribute__((target("avx2")))
+static void convertAVX2(const void *src, float *dst, int n, int datatype, bool swap){
+	const unsigned char *p = (const unsigned char*)src;
+	int j = 0;
+
+	if(datatype == 1){
+		for(; j+8<=n; j+=8){
+			__m128i b = _mm_loadl_epi64((const __m128i*)(p+j));
+			_mm256_storeu_ps(dst+j, _mm256_cvtepi32_ps(_mm256_cvtepu8_epi32(b)));
+		}
+	} else if(datatype == 2 || datatype == 12){
+		const __m128i order = byteOrderSSE4(2);
+		for(; j+8<=n; j+=8){
+			__m128i v = loadSSE4(p+(size_t)j*2, swap, order);
+			__m256i a = (datatype == 2) ? _mm256_cvtepi16_epi32(v) : _mm256_cvtepu16_epi32(v);
+			_mm256_storeu_ps(dst+j, _mm256_cvtepi32_ps(a));
+		}
+	} else if(datatype == 3 || datatype == 4){
+		const __m256i order = _mm256_broadcastsi128_si256(byteOrderSSE4(4));
+		for(; j+8<=n; j+=8){
+			__m256i v = loadAVX2(p+(size_t)j*4, swap, order);
+			_mm256_storeu_ps(dst+j, (datatype == 3) ? _mm256_cvtepi32_ps(v) : _mm256_castsi256_ps(v));
+		}
+	} else if(datatype == 5){
+		const __m256i order = _mm256_broadcastsi128_si256(byteOrderSSE4(8));
+		for(; j+8<=n; j+=8){
+			__m128 a = _mm256_cvtpd_ps(_mm256_castsi256_pd(loadAVX2(p+(size_t)j*8, swap, order)));
+			__m128 b = _mm256_cvtpd_ps(_mm256_castsi256_pd(loadAVX2(p+(size_t)j*8+32, swap, order)));
+			_mm256_storeu_ps(dst+j, _mm256_set_m128(b, a));
+		}
+	}
+	convertRange(src, dst, j, n, datatype, swap);
+}
+
+__attribute__((target("avx2")))
+static int crossingAVX2(float z, float zn, bool okn, int j, int step, const float *t, const int *from, int *pos, int *done, int n){
+	const __m256 zv = _mm256_set1_ps(z), znv = _mm256_set1_ps(zn);
+	const __m256 nullNext = _mm256_castsi256_ps(_mm256_set1_epi32(okn ? 0 : -1));
+	const __m256i jv = _mm256_set1_epi32(j), sv = _mm256_set1_epi32(step);
+	const __m256i zero = _mm256_setzero_si256(), one = _mm256_set1_epi32(1);
+	int k, open = 0;
+
+	for(k=0; k+8<=n; k+=8){
+		__m256 tv = _mm256_loadu_ps(t+k);
+		__m256i d = _mm256_loadu_si256((const __m256i*)(done+k));
+		__m256i behind = _mm256_cmpgt_epi32(zero, _mm256_mullo_epi32(_mm256_sub_epi32(jv, _mm256_loadu_si256((const __m256i*)(from+k))), sv));
+		__m256 cross = _mm256_and_ps(_mm256_cmp_ps(zv, tv, _CMP_GE_OQ), _mm256_or_ps(_mm256_cmp_ps(znv, tv, _CMP_LT_OQ), nullNext));
+		__m256i hit = _mm256_and_si256(_mm256_andnot_si256(behind, _mm256_cmpeq_epi32(d, zero)), _mm256_castps_si256(cross));
+		d = _mm256_or_si256(d, _mm256_and_si256(hit, one));
+		_mm256_storeu_si256((__m256i*)(pos+k), _mm256_blendv_epi8(_mm256_loadu_si256((const __m256i*)(pos+k)), jv, hit));
+		_mm256_storeu_si256((__m256i*)(done+k), d);
+		open += __builtin_popcount(_mm256_movemask_ps(_mm256_castsi256_ps(_mm256_cmpeq_epi32(d, zero))));
+	}
+	return open + crossingRange(z, zn, okn, j, step, t, from, pos, done, k, n);
+}
+
+__attribute__((target("avx2")))
+static void volumeAVX2(float z, int j, float xres, float yres, const float *t, const int *lo, const int *hi, double *sum, int n){
+	const __m256 zv = _mm256_set1_ps(z), xr = _mm256_set1_ps(xres), yr = _mm256_set1_ps(yres);
+	const __m256i jv = _mm256_set1_epi32(j);
+	int k;
+
+	for(k=0; k+8<=n; k+=8){
+		__m256 tv = _mm256_loadu_ps(t+k);
+		__m256i out = _mm256_or_si256(_mm256_cmpgt_epi32(_mm256_loadu_si256((const __m256i*)(lo+k)), jv), _mm256_cmpgt_epi32(jv, _mm256_loadu_si256((const __m256i*)(hi+k))));
+		__m256 m = _mm256_andnot_ps(_mm256_castsi256_ps(out), _mm256_cmp_ps(zv, tv, _CMP_GE_OQ));
+		__m256 v = _mm256_and_ps(m, _mm256_mul_ps(_mm256_mul_ps(_mm256_sub_ps(zv, tv), xr), yr));
+		_mm256_storeu_pd(sum+k, _mm256_add_pd(_mm256_loadu_pd(sum+k), _mm256_cvtps_pd(_mm256_castps256_ps128(v))));
+		_mm256_storeu_pd(sum+k+4, _mm256_add_pd(_mm256_loadu_pd(sum+k+4), _mm256_cvtps_pd(_mm256_extractf128_ps(v, 1))));
+	}
+	volumeRange(z, j, xres, yres, t, lo, hi, sum, k, n);
+}
+
+///////////////////////////////////////////////////////////////
+// AVX-512 KERNELS (16 pixels per instruction)
+///////////////////////////////////////////////////////////////
+// lane mask of the 16 validity bits of pixels j to j+15
+static inline __mmask16 validAVX512(const uint64_t *valid, int j){
+	return (__mmask16)(valid[j>>6] >> (j&63));
+}
+
+__attribute__((target("avx512f")))
+static void maskAVX512(const float *src, const uint64_t *valid, float *out, int n, float sign){
+	const __m512 inf = _mm512_set1_ps(numeric_limits<float>::infinity());
+	const __m512 s = _mm512_set1_ps(sign);
+	int j;
+
+	for(j=0; j+16<=n; j+=16){
+		__m512 v = _mm512_loadu_ps(src+j);
+		_mm512_storeu_ps(out+j, _mm512_mask_blend_ps(validAVX512(valid, j), inf, _mm512_mul_ps(s, v)));
+	}
+	maskRange(src, valid, out, j, n, sign);
+}
+
+__attribute__((target("avx512f")))
+static void minimumAVX512(const float *a, const float *b, float *out, int n, float sign){
+	const __m512 s = _mm512_set1_ps(sign);
+	int j;
+
+	for(j=0; j+16<=n; j+=16){
+		__m512 v = _mm512_min_ps(_mm512_loadu_ps(a+j), _mm512_loadu_ps(b+j));
+		_mm512_storeu_ps(out+j, _mm512_mul_ps(s, v));
+	}
+	minimumScalar(a+j, b+j, out+j, n-j, sign);
+}
+
+// avx512f implies FMA: keep the compiler from fusing sum += weight*rr (here
+// and in the inlined scalar tail), which would round once instead of twice
+__attribute__((target("avx512f"), optimize("fp-contract=off")))
+static void reliefAVX512(const float *z, const float *z_min, const float *z_max, float *rr, double *sum, int n, double weight){
+	const __m512d wt = _mm512_set1_pd(weight);
+	int j;
+
+	for(j=0; j+16<=n; j+=16){
+		__m512 mn = _mm512_loadu_ps(z_min+j);
+		__m512 r = _mm512_div_ps(_mm512_sub_ps(_mm512_loadu_ps(z+j), mn), _mm512_sub_ps(_mm512_loadu_ps(z_max+j), mn));
+		__m256 lo = _mm512_castps512_ps256(r);
+		__m256 hi = _mm256_castpd_ps(_mm512_extractf64x4_pd(_mm512_castps_pd(r), 1));
+		_mm512_storeu_ps(rr+j, r);
+		_mm512_storeu_pd(sum+j, _mm512_add_pd(_mm512_loadu_pd(sum+j), _mm512_mul_pd(wt, _mm512_cvtps_pd(lo))));
+		_mm512_storeu_pd(sum+j+8, _mm512_add_pd(_mm512_loadu_pd(sum+j+8), _mm512_mul_pd(wt, _mm512_cvtps_pd(hi))));
+	}
+	reliefScalar(z+j, z_min+j, z_max+j, rr+j, sum+j, n-j, weight);
+}
+
+__attribute__((target("avx512f")))
+static void averageAVX512(const uint64_t *valid, const double *sum, float *avg, int n, double wsum){
+	const __m512 fill = _mm512_set1_ps(-9999);
+	const __m512d ws = _mm512_set1_pd(wsum);
+	int j;
+
+	for(j=0; j+16<=n; j+=16){
+		__m256 lo = _mm512_cvtpd_ps(_mm512_div_pd(_mm512_loadu_pd(sum+j), ws));
+		__m256 hi = _mm512_cvtpd_ps(_mm512_div_pd(_mm512_loadu_pd(sum+j+8), ws));
+		__m512 v = _mm512_castpd_ps(_mm512_insertf64x4(_mm512_castps_pd(_mm512_castps256_ps512(lo)), _mm256_castps_pd(hi), 1));
+		_mm512_storeu_ps(avg+j, _mm512_mask_blend_ps(validAVX512(valid, j), fill, v));
+	}
+	averageRange(valid, sum, avg, j, n, wsum);
+}
+
+__attribute__((target("avx512f")))
+static void nullifyAVX512(const uint64_t *valid, float *out, int n){
+	const __m512 fill = _mm512_set1_ps(-9999);
+	int j;
+
+	for(j=0; j+16<=n; j+=16){
+		_mm512_storeu_ps(out+j, _mm512_mask_blend_ps(validAVX512(valid, j), fill, _mm512_loadu_ps(out+j)));
+	}
+	nullifyRange(valid, out, j, n);
+}
+
+__attribute__((target("avx512f")))
+static void validityAVX512(const float *z, uint64_t *bits, int n, float floor, float nodata){
+	const __m512 fl = _mm512_set1_ps(floor);
+	const __m512 nd = _mm512_set1_ps(nodata);
+	int j;
+
+	clearBits(bits, n);
+	for(j=0; j+16<=n; j+=16){
+		__m512 v = _mm512_loadu_ps(z+j);
+		__mmask16 m = _mm512_cmp_ps_mask(v, fl, _CMP_GT_OQ) & _mm512_cmp_ps_mask(v, nd, _CMP_NEQ_UQ);
+		bits[j>>6] |= (uint64_t)m << (j&63);
+	}
+	validityRange(z, bits, j, n, floor, nodata);
+}
+
+__attribute__((target("avx512f")))
+static int crossingAVX512(float z, float zn, bool okn, int j, int step, const float *t, const int *from, int *pos, int *done, int n){
+	const __m512 zv = _mm512_set1_ps(z), znv = _mm512_set1_ps(zn);
+	const __m512i jv = _mm512_set1_epi32(j), sv = _mm512_set1_epi32(step);
+	const __m512i zero = _mm512_setzero_si512(), one = _mm512_set1_epi32(1);
+	int k, open = 0;
+
+	for(k=0; k+16<=n; k+=16){
+		__m512 tv = _mm512_loadu_ps(t+k);
+		__mmask16 idle = _mm512_cmpeq_epi32_mask(_mm512_loadu_si512(done+k), zero);
+		__mmask16 reached = _mm512_cmpge_epi32_mask(_mm512_mullo_epi32(_mm512_sub_epi32(jv, _mm512_loadu_si512(from+k)), sv), zero);
+		__mmask16 cross = _mm512_cmp_ps_mask(zv, tv, _CMP_GE_OQ) & (okn ? _mm512_cmp_ps_mask(znv, tv, _CMP_LT_OQ) : (__mmask16)0xFFFF);
+		__mmask16 hit = idle & reached & cross;
+		_mm512_mask_storeu_epi32(pos+k, hit, jv);
+		_mm512_mask_storeu_epi32(done+k, hit, one);
+		open += __builtin_popcount(idle & ~hit);
+	}
+	return open + crossingRange(z, zn, okn, j, step, t, from, pos, done, k, n);
+}
+
+__attribute__((target("avx512f")))
+static void volumeAVX512(float z, int j, float xres, float yres, const float *t, const int *lo, const int *hi, double *sum, int n){
+	const __m512 zv = _mm512_set1_ps(z), xr = _mm512_set1_ps(xres), yr = _mm512_set1_ps(yres);
+	const __m512i jv = _mm512_set1_epi32(j);
+	int k;
+
+	for(k=0; k+16<=n; k+=16){
+		__m512 tv = _mm512_loadu_ps(t+k);
+		__mmask16 m = _mm512_cmp_ps_mask(zv, tv, _CMP_GE_OQ) & _mm512_cmple_epi32_mask(_mm512_loadu_si512(lo+k), jv) & _mm512_cmple_epi32_mask(jv, _mm512_loadu_si512(hi+k));
+		__m512 v = _mm512_maskz_mov_ps(m, _mm512_mul_ps(_mm512_mul_ps(_mm512_sub_ps(zv, tv), xr), yr));
+		__m256 vhi = _mm256_castpd_ps(_mm512_extractf64x4_pd(_mm512_castps_pd(v), 1));
+		_mm512_storeu_pd(sum+k, _mm512_add_pd(_mm512_loadu_pd(sum+k), _mm512_cvtps_pd(_mm512_castps512_ps256(v))));
+		_mm512_storeu_pd(sum+k+8, _mm512_add_pd(_mm512_loadu_pd(sum+k+8), _mm512_cvtps_pd(vhi)));
+	}
+	volumeRange(z, j, xres, yres, t, lo, hi, sum, k, n);
+}
+
+#endif
+
+///////////////////////////////////////////////////////////////
+// RUNTIME DISPATCH
+///////////////////////////////////////////////////////////////
+static const RRKernels scalarKernels = {"scalar", maskScalar, minimumScalar, reliefScalar, averageScalar, nullifyScalar, validityScalar, convertScalar, crossingScalar, volumeScalar};
+#ifdef RR_X86_KERNELS
+static const RRKernels sse4Kernels = {"SSE4.1", maskSSE4, minimumSSE4, reliefSSE4, averageSSE4, nullifySSE4, validitySSE4, convertSSE4, crossingSSE4, volumeSSE4};
+static const RRKernels avx2Kernels = {"AVX2", maskAVX2, minimumAVX2, reliefAVX2, averageAVX2, nullifyAVX2, validityAVX2, convertAVX2, crossingAVX2, volumeAVX2};
+static const RRKernels avx512Kernels = {"AVX-512", maskAVX512, minimumAVX512, reliefAVX512, averageAVX512, nullifyAVX512, validityAVX512, convertAVX2, crossingAVX512, volumeAVX512};
+#endif
+
+// pick the widest kernels the CPU supports. Setting the environment variable
+// RR_KERNELS to scalar, sse4, avx2 or avx512 caps the choice (for comparisons).
+static RRKernels selectKernels(){
+	const char *cap = getenv("RR_KERNELS");
+	int level = 3;
+
+	if(cap){
+		if(strcmp(cap, "scalar") == 0) level = 0;
+		else if(strcmp(cap, "sse4") == 0) level = 1;
+		else if(strcmp(cap, "avx2") == 0) level = 2;
+	}
+
+#ifdef RR_X86_KERNELS
+	__builtin_cpu_init();
+	if(level >= 3 && __builtin_cpu_supports("avx512f")) return avx512Kernels;
+	if(level >= 2 && __builtin_cpu_supports("avx2")) return avx2Kernels;
+	if(level >= 1 && __builtin_cpu_supports("sse4.1")) return sse4Kernels;
+#endif
+	return scalarKernels;
+}
+
+const RRKernels &rrKernels(){
+	static const RRKernels kernels = selectKernels();
+	return kernels;
+}
+
+
+///////////////////////////////////////////////////////////////
+// PARITY CHECK
+///////////////////////////////////////////////////////////////
+static const int CHECK_KERNELS = 9;
+static const char *checkNames[CHECK_KERNELS] = {"mask", "minimum", "relief", "average", "nullify", "validity", "convert", "crossing", "volume"};
+
+// deterministic pseudo-random numbers, so every set sees the same inputs
+static uint32_t checkRandom(uint32_t &state){
+	state = state*1664525u + 1013904223u;
+	return state >> 8;
+}
+
+static float checkUniform(uint32_t &state, float lo, float hi){
+	return lo + (hi-lo)*(checkRandom(state)/16777216.0f);
+}
+
+template<class T>
+static void checkKeep(vector<unsigned char> &out, const T *v, int n){
+	const unsigned char *p = (const unsigned char*)v;
+	out.insert(out.end(), p, p+(size_t)n*sizeof(T));
+}
+
+// the bytes written by each kernel of kern on the check inputs
+static void checkRun(const RRKernels &kern, vector< vector<unsigned char> > &out){
+	const int n = 1037;				// not a multiple of any vector width
+	const int lanes = 45;
+	const float nodata = -9999, floor = 0.5f;
+	const double weights[3] = {0.35, 1.6, 2.75};
+	const int types[9] = {1, 2, 3, 4, 5, 12, 13, 14, 15};
+	int words = (n+63)/64;
+	uint32_t state = 20260;
+	int j, k;
+
+	out.assign(CHECK_KERNELS, vector<unsigned char>());
+
+	vector<float> z(n), z_min(n), z_max(n), a(n), b(n), f(n), rr(n), avg(n);
+	vector<uint64_t> valid(words), bits(words);
+	vector<double> sum(n, 0.0);
+	for(j=0; j<n; ++j){
+		z_min[j] = checkUniform(state, -5, 30);
+		z_max[j] = z_min[j] + checkUniform(state, 0.01f, 12);
+		z[j] = checkUniform(state, z_min[j], z_max[j]);
+		a[j] = checkUniform(state, -40, 40);
+		b[j] = checkUniform(state, -40, 40);
+		if(checkRandom(state)%10 != 0){
+			valid[j>>6] |= (uint64_t)1 << (j&63);
+		}
+	}
+
+	kern.mask(z.data(), valid.data(), f.data(), n, 1);
+	checkKeep(out[0], f.data(), n);
+	kern.mask(z.data(), valid.data(), f.data(), n, -1);
+	checkKeep(out[0], f.data(), n);
+
+	kern.minimum(a.data(), b.data(), f.data(), n, 1);
+	checkKeep(out[1], f.data(), n);
+	kern.minimum(a.data(), b.data(), f.data(), n, -1);
+	checkKeep(out[1], f.data(), n);
+
+	// the weighted sum accumulates over several scales, as in ReliefRows
+	for(k=0; k<3; ++k){
+		kern.relief(z.data(), z_min.data(), z_max.data(), rr.data(), sum.data(), n, weights[k]);
+		checkKeep(out[2], rr.data(), n);
+	}
+	checkKeep(out[2], sum.data(), n);
+
+	kern.average(valid.data(), sum.data(), avg.data(), n, weights[0]+weights[1]+weights[2]);
+	checkKeep(out[3], avg.data(), n);
+
+	kern.nullify(valid.data(), rr.data(), n);
+	checkKeep(out[4], rr.data(), n);
+
+	// elevations on, below and above the floor and at nodata
+	for(j=0; j<n; ++j){
+		f[j] = (j%7 == 0) ? nodata : ((j%11 == 0) ? floor : a[j]);
+	}
+	kern.validity(f.data(), bits.data(), n, floor, nodata);
+	checkKeep(out[5], bits.data(), words);
+
+	vector<unsigned char> raw((size_t)n*8);
+	for(j=0; j<(int)raw.size(); ++j){
+		raw[j] = checkRandom(state) & 0xFF;
+	}
+	for(k=0; k<9; ++k){
+		kern.convert(raw.data(), f.data(), n, types[k], false);
+		checkKeep(out[6], f.data(), n);
+		kern.convert(raw.data(), f.data(), n, types[k], true);
+		checkKeep(out[6], f.data(), n);
+	}
+
+	vector<float> t(lanes);
+	vector<int> from(lanes), pos(lanes, -1), done(lanes), lo(lanes), hi(lanes);
+	vector<double> vol(lanes, 0.0);
+	for(k=0; k<lanes; ++k){
+		t[k] = checkUniform(state, -2, 8);
+		from[k] = checkRandom(state)%64;
+		done[k] = (checkRandom(state)%5 == 0);
+		lo[k] = checkRandom(state)%64;
+		hi[k] = lo[k] + checkRandom(state)%64 - 16;
+	}
+	for(j=0; j<96; ++j){
+		float zj = checkUniform(state, -3, 10);
+		float zn = checkUniform(state, -3, 10);
+		int open = kern.crossing(zj, zn, j%5 != 0, j, (j < 48) ? 1 : -1, t.data(), from.data(), pos.data(), done.data(), lanes);
+		checkKeep(out[7], &open, 1);
+		kern.volume(zj, j%64, 0.7f, 1.3f, t.data(), lo.data(), hi.data(), vol.data(), lanes);
+	}
+	checkKeep(out[7], pos.data(), lanes);
+	checkKeep(out[7], done.data(), lanes);
+	checkKeep(out[8], vol.data(), lanes);
+}
+
+bool rrKernelsCheck(){
+	vector<const RRKernels*> sets;
+	vector< vector<unsigned char> > ref, out;
+	bool ok = true;
+	int s, k;
+
+#ifdef RR_X86_KERNELS
+	__builtin_cpu_init();
+	if(__builtin_cpu_supports("sse4.1")) sets.push_back(&sse4Kernels);
+	if(__builtin_cpu_supports("avx2")) sets.push_back(&avx2Kernels);
+	if(__builtin_cpu_supports("avx512f")) sets.push_back(&avx512Kernels);
+#endif
+	if(sets.empty()){
+		cout << "Kernel check: only the scalar kernels are available" << endl;
+		return true;
+	}
+
+	checkRun(scalarKernels, ref);
+	for(s=0; s<(int)sets.size(); ++s){
+		string bad;
+		checkRun(*sets[s], out);
+		for(k=0; k<CHECK_KERNELS; ++k){
+			if(out[k] != ref[k]) bad += string(" ")+checkNames[k];
+		}
+		if(bad.empty()){
+			cout << "Kernel check: " << sets[s]->name << " matches scalar" << endl;
+		} else{
+			cout << "ERROR: " << sets[s]->name << " kernels differ from scalar:" << bad << endl;
+			ok = false;
+		}
+	}
+	return ok;
+}
@@ -0,0 +1,64 @@
+#ifndef RR_KERNELS_HPP
+#define RR_KERNELS_HPP
+
+#include <stdint.h>
+
+///////////////////////////////////////////////////////////////
+// RELATIVE RELIEF ROW KERNELS
+///////////////////////////////////////////////////////////////
+
+// Element-wise row operations used by the running min/max engine. Pixel
+// validity comes from packed bits (bit j%64 of valid[j/64] is set when pixel j
+// holds data), expanded to SIMD lane masks without per-pixel branches. Each
+// instruction set provides the same kernels; the best one supported by
+// the CPU is picked once at startup (see rrKernels()), so one binary runs on
+// any x86-64 machine. Every variant performs the same IEEE operations in the
+// same order, so the output is bit-identical whichever kernel is used.
+struct RRKernels
+{
+	const char *name;
+
+	// out = valid ? sign*src : +inf   (NULL pixels can never win a minimum)
+	void (*mask)(const float *src, const uint64_t *valid, float *out, int n, float sign);
+
+	// out = sign*((a < b) ? a : b)
+	void (*minimum)(const float *a, const float *b, float *out, int n, float sign);
+
+	// rr = (z - z_min)/(z_max - z_min); sum += weight*rr
+	void (*relief)(const float *z, const float *z_min, const float *z_max, float *rr, double *sum, int n, double weight);
+
+	// avg = sum/wsum for valid pixels, -9999 for NULL pixels
+	void (*average)(const uint64_t *valid, const double *sum, float *avg, int n, double wsum);
+
+	// out = -9999 for NULL pixels (valid pixels are left unchanged)
+	void (*nullify)(const uint64_t *valid, float *out, int n);
+
+	// validity bits of n elevations: set where z > floor and z != nodata
+	void (*validity)(const float *z, uint64_t *bits, int n, float floor, float nodata);
+
+	// dst = n raw ENVI values of data type datatype (1, 2, 3, 4, 5, 12, 13, 14 or
+	// 15) as floats, reversing the bytes of each value first if swap
+	void (*convert)(const void *src, float *dst, int n, int datatype, bool swap);
+
+	// Threshold sweep lanes (one lane k per parameter set, see sweep.hpp)
+
+	// edge search at pixel j of a transect: the open lanes (done[k] == 0) whose
+	// search has reached j ((j-from[k])*step >= 0) and whose threshold z crosses
+	// (z >= t[k], and zn < t[k] or the next pixel is NULL) get pos[k] = j and
+	// done[k] = 1. Returns the lanes left open.
+	int (*crossing)(float z, float zn, bool okn, int j, int step, const float *t, const int *from, int *pos, int *done, int n);
+
+	// sum[k] += (z-t[k])*xres*yres for the lanes with lo[k] <= j <= hi[k] and z >= t[k]
+	void (*volume)(float z, int j, float xres, float yres, const float *t, const int *lo, const int *hi, double *sum, int n);
+};
+
+// kernels for the running CPU (selected from CPUID on first use)
+const RRKernels &rrKernels();
+
+// run every kernel set the CPU supports on the same synthetic rows (non-unit
+// weights and resolutions, NULL pixels, ragged tails) and compare the outputs
+// bit for bit with the scalar kernels, printing one line per set. Returns
+// false if any set differs.
+bool rrKernelsCheck();
+
+#endif
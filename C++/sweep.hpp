@@ -0,0 +1,605 @@
+#include <algorithm>
+#include <fstream>
+#include <functional>
+#include <math.h>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "rr_kernels.hpp"
+
+using namespace std;
+
+///////////////////////////////////////////////////////////////
+// THRESHOLD SWEEP (MANY PARAMETER SETS OVER ONE RELATIVE RELIEF)
+///////////////////////////////////////////////////////////////
+
+// the thresholds a sweep can vary, with their params_rr.ini names
+static const struct { const char *name; float Params::*value; } SWEEP_KEYS[] = {
+	{ "tShoreline", &Params::tShoreline },
+	{ "tDT", &Params::tDT },
+	{ "tDC", &Params::tDC },
+	{ "tDH", &Params::tDH },
+	{ "tBB", &Params::tBB },
+	{ "tDuneDistMin", &Params::tDuneDistMin },
+	{ "tDuneDistMax", &Params::tDuneDistMax },
+	{ "tCrestDistMin", &Params::tCrestDistMin },
+	{ "tCrestDistMax", &Params::tCrestDistMax },
+	{ "tHeelDistMin", &Params::tHeelDistMin },
+	{ "tHeelDistMax", &Params::tHeelDistMax }
+};
+enum { SW_SHORE, SW_DT, SW_DC, SW_DH, SW_BB, SW_DUNE_MIN, SW_DUNE_MAX, SW_CREST_MIN, SW_CREST_MAX, SW_HEEL_MIN, SW_HEEL_MAX, SW_NKEYS };
+
+// the metrics averaged per set, in the order of the landform metrics columns
+enum { SW_BEACH_WIDTH, SW_BEACH_VOL, SW_DUNE_HEIGHT, SW_DUNE_VOL, SW_ISLAND_WIDTH, SW_ISLAND_VOL, SW_NMEANS };
+
+// fewest parameter sets given to a thread (the sets are the SIMD lanes of the
+// transect searches, so a thread needs enough of them to fill its vectors)
+static const int SWEEP_LANES = 16;
+
+// How the transects of one direction run through the raster. The four
+// directions of the landform extraction differ in more than their scan order
+// (which neighbour a search compares with, which resolution a distance uses,
+// which coordinate a landform gets), and the sweep reproduces each of them.
+struct SweepDirection
+{
+	int ntransects, length;		// transects, pixels along each transect
+	int lo, hi;					// searches only look at lo < t < hi
+	int flo, fhi;				// ... of the transects flo < f < fhi
+	int step;					// scan direction along a transect
+	int behind;					// crest and heel lie at t < pos (-1) or t > pos (+1)
+	bool columns;				// transects are columns (N, S)
+	bool absDist;				// distances are abs(pos - t)
+	bool volumeUp;				// volumes run from the shoreline up to the landform (N)
+	float res;					// resolution of the distances and the widths
+	float beachRes;				// resolution of the beach volume check
+	double dhMax;				// largest dune height
+	const Header *hdr;
+
+	SweepDirection(string dir, const Header &h, int buffer){
+		hdr = &h;
+		columns = dir.compare("N")==0 || dir.compare("S")==0;
+		step = (dir.compare("E")==0 || dir.compare("N")==0) ? 1 : -1;
+		ntransects = columns ? h.ncols : h.nlines;
+		length = columns ? h.nlines : h.ncols;
+		// the image limits of the extraction: i>buffer && i<nlines-buffer && j>buffer+1 && j<ncols-buffer-1
+		lo = columns ? buffer : buffer+1;
+		hi = columns ? h.nlines-buffer : h.ncols-buffer-1;
+		flo = columns ? buffer+1 : buffer;
+		fhi = columns ? h.ncols-buffer-1 : h.nlines-buffer;
+		behind = columns ? 1 : -1;
+		absDist = columns;
+		volumeUp = dir.compare("N")==0;
+		res = columns ? h.yres : h.xres;
+		beachRes = (dir.compare("S")==0) ? h.yres : h.xres;
+		dhMax = columns ? 500 : 300;
+	}
+
+	// distance from landform position p to pixel t
+	float distance(int p, int t) const {
+		float d = (float)(p-t);
+		return (absDist ? fabsf(d) : d)*res;
+	}
+	// distances grow along the scan (all but E, where they shrink below 0)
+	bool grows() const { return absDist || step < 0; }
+
+	// coordinate of a landform found at t of transect f
+	double along(int t) const { return columns ? hdr->ycoord(t) : hdr->xcoord(t); }
+	// ... of the shoreline (N transects give it the x coordinate of the column)
+	double shoreline(int f, int t) const { return (columns && step > 0) ? hdr->xcoord(f) : along(t); }
+	// coordinate that starts the metrics line of transect f (0: no line)
+	double transect(int f, int shore) const {
+		if(!columns){
+			return hdr->ycoord(f);
+		}
+		return (step > 0) ? hdr->ycoord(shore) : hdr->xcoord(f);
+	}
+
+	// a search from a to b (in scan order) looks at a pixel within the limits
+	bool visits(int a, int b) const { return max(min(a, b), lo+1) <= min(max(a, b), hi-1); }
+};
+
+// the pixels of one transect and of its neighbours on either side (the
+// searches compare with the pixels of column j+1 (R) and j-1 (L) at every
+// position, whatever the direction)
+struct SweepLine
+{
+	int f;
+	const float *z, *zR, *zL;
+	const float *avg, *avgR, *avgL;
+	const int *ok, *okR, *okL;
+};
+
+// positions, elevations and volumes of the landforms of a slice of parameter
+// sets along one transect (one lane per set)
+struct SweepLanes
+{
+	vector<int> shore, toe, crest, heel, back;		// 0: not found
+	vector<float> toeZ, backZ;
+	vector<int> from, done, seen;
+	vector<double> beach, dune, island;
+	vector<int> beachLo, beachHi, duneLo, duneHi, islandLo, islandHi;	// pixels of each volume
+
+	void resize(size_t n){
+		shore.resize(n); toe.resize(n); crest.resize(n); heel.resize(n); back.resize(n);
+		toeZ.resize(n); backZ.resize(n);
+		from.resize(n); done.resize(n); seen.resize(n);
+		beach.resize(n); dune.resize(n); island.resize(n);
+		beachLo.resize(n); beachHi.resize(n); duneLo.resize(n); duneHi.resize(n); islandLo.resize(n); islandHi.resize(n);
+	}
+};
+
+// The parameter sets of a sweep and the landform metrics of each set. A sweep
+// file lists the sets as a grid and/or a list:
+//
+//		tDT 0.18 0.2 0.22			every combination of the values of the
+//		tDC 0.7 0.75 0.8			grid lines (9 sets here)
+//		set tDT 0.2 tDH 0.45		one set per set line
+//
+// Every set line is combined with every point of the grid. The thresholds a
+// set does not give come from params_rr.ini. Each transect is searched for all
+// the sets at once: at every pixel the sets are the lanes of one loop, and the
+// edge searches and the volumes run on the SIMD kernels of rrKernels().
+class ThresholdSweep
+{
+public:
+	// read the sets of file fn (the other thresholds from prms)
+	bool load(string fn, const Params &prms);
+	size_t size() const { return nsets; }
+
+	// extract the landforms of every transect for every set (on up to nthreads
+	// threads, each taking a slice of the sets). The relative relief and the
+	// elevations of data must be complete.
+	void run(const Raster &data, const Header &hdr, string direction, int buffer, int nthreads);
+
+	// write one line of metrics per set (an empty name is not written)
+	bool write(string csvName, string arrowName) const;
+
+private:
+	size_t nsets;
+	vector<float> thr[SW_NKEYS];		// threshold of every set
+	vector<double> lines;				// transects with a metrics line
+	vector<double> found[4];			// ... with a dune toe, crest, heel, backbarrier
+	vector<double> sum[SW_NMEANS], count[SW_NMEANS];
+
+	void slice(size_t k0, size_t k1, const Raster &data, const SweepDirection &d, const float *zt, const float *avgt);
+	void transect(const SweepDirection &d, const SweepLine &l, size_t k0, int n, SweepLanes &w);
+	void search(const SweepDirection &d, const SweepLine &l, const int *from, int *pos, const float *prevZ, const float *t, const float *dmin, const float *dmax, int n, SweepLanes &w);
+};
+
+bool ThresholdSweep::load(string fn, const Params &prms){
+	ifstream in(fn.c_str());
+	vector< vector< pair<int, float> > > listed;
+	vector<int> gridKey;
+	vector< vector<float> > gridValues;
+	string line;
+	size_t s, k, g;
+
+	if(!in){
+		cout << "ERROR: Cannot open sweep file '" << fn << "'" << endl;
+		return false;
+	}
+	while(getline(in, line)){
+		size_t a = line.find_first_not_of(" \t\r");
+		if(a == string::npos || line[a] == '#'){
+			continue;
+		}
+		istringstream vals(line);
+		string key;
+		float v;
+		int idx;
+		vals >> key;
+
+		if(key.compare("set") == 0){
+			vector< pair<int, float> > set;
+			while(vals >> key){
+				for(idx=0; idx<SW_NKEYS && key.compare(SWEEP_KEYS[idx].name)!=0; ++idx);
+				if(idx == SW_NKEYS || !(vals >> v)){
+					cout << "ERROR: Invalid set line in " << fn << " --> '" << line << "'" << endl;
+					return false;
+				}
+				set.push_back(make_pair(idx, v));
+			}
+			listed.push_back(set);
+			continue;
+		}
+
+		for(idx=0; idx<SW_NKEYS && key.compare(SWEEP_KEYS[idx].name)!=0; ++idx);
+		if(idx == SW_NKEYS){
+			cout << "ERROR: Unknown sweep parameter '" << key << "' in " << fn << endl;
+			return false;
+		}
+		if(find(gridKey.begin(), gridKey.end(), idx) != gridKey.end()){
+			cout << "ERROR: " << key << " is listed twice in " << fn << endl;
+			return false;
+		}
+		vector<float> values;
+		while(vals >> v){
+			values.push_back(v);
+		}
+		if(values.empty() || !vals.eof()){
+			cout << "ERROR: Invalid values of " << key << " in " << fn << endl;
+			return false;
+		}
+		gridKey.push_back(idx);
+		gridValues.push_back(values);
+	}
+	if(listed.empty() && gridKey.empty()){
+		cout << "ERROR: No parameter set in sweep file '" << fn << "'" << endl;
+		return false;
+	}
+	if(listed.empty()){
+		listed.push_back(vector< pair<int, float> >());
+	}
+	for(s=0; s<listed.size(); ++s){
+		for(k=0; k<listed[s].size(); ++k){
+			if(find(gridKey.begin(), gridKey.end(), listed[s][k].first) != gridKey.end()){
+				cout << "ERROR: " << SWEEP_KEYS[listed[s][k].first].name << " is given both in a set line and in a grid line of " << fn << endl;
+				return false;
+			}
+		}
+	}
+
+	size_t points = 1;
+	for(g=0; g<gridValues.size(); ++g){
+		points *= gridValues[g].size();
+	}
+	nsets = listed.size()*points;
+	for(k=0; k<SW_NKEYS; ++k){
+		thr[k].assign(nsets, prms.*SWEEP_KEYS[k].value);
+	}
+	// set line by set line, the last grid line varying fastest
+	for(s=0; s<nsets; ++s){
+		const vector< pair<int, float> > &set = listed[s/points];
+		size_t p = s%points;
+		for(g=gridValues.size(); g-->0; ){
+			thr[gridKey[g]][s] = gridValues[g][p%gridValues[g].size()];
+			p /= gridValues[g].size();
+		}
+		for(k=0; k<set.size(); ++k){
+			thr[set[k].first][s] = set[k].second;
+		}
+	}
+
+	lines.assign(nsets, 0);
+	for(k=0; k<4; ++k){
+		found[k].assign(nsets, 0);
+	}
+	for(k=0; k<SW_NMEANS; ++k){
+		sum[k].assign(nsets, 0);
+		count[k].assign(nsets, 0);
+	}
+	return true;
+}
+
+void ThresholdSweep::run(const Raster &data, const Header &hdr, string direction, int buffer, int nthreads){
+	SweepDirection d(direction, hdr, buffer);
+	vector<float> zt, avgt;
+	vector<thread> pool;
+	size_t k0, per;
+
+	// column transects read column-major copies (contiguous along the transect)
+	if(d.columns){
+		zt.resize(hdr.npix);
+		avgt.resize(hdr.npix);
+		transposeRaster(data.z.data(), zt.data(), hdr.nlines, hdr.ncols);
+		transposeRaster(data.avg, avgt.data(), hdr.nlines, hdr.ncols);
+	}
+
+	// one slice of the sets per thread: the metrics of a set are summed over the
+	// transects in order, whatever the number of threads
+	size_t slices = (nsets+SWEEP_LANES-1)/SWEEP_LANES;
+	if(slices > (size_t)max(nthreads, 1)){
+		slices = max(nthreads, 1);
+	}
+	per = (nsets+slices-1)/slices;
+	for(k0=per; k0<nsets; k0+=per){
+		pool.push_back(thread(&ThresholdSweep::slice, this, k0, min(k0+per, nsets), cref(data), cref(d), zt.data(), avgt.data()));
+	}
+	slice(0, min(per, nsets), data, d, zt.data(), avgt.data());
+	for(size_t t=0; t<pool.size(); ++t){
+		pool[t].join();
+	}
+}
+
+void ThresholdSweep::slice(size_t k0, size_t k1, const Raster &data, const SweepDirection &d, const float *zt, const float *avgt){
+	const Header &hdr = *d.hdr;
+	int n = (int)(k1-k0);
+	SweepLanes w;
+	SweepLine l;
+	vector<int> ok(d.length+2, 0), okR, okL;
+	int f, t;
+
+	w.resize(n);
+	if(d.columns){
+		okR.assign(d.length, 0);
+		okL.assign(d.length, 0);
+	}
+
+	// (the transects outside the image limits find no shoreline)
+	for(f=d.flo+1; f<d.fhi; ++f){
+		l.f = f;
+		if(d.columns){
+			l.z = zt+(size_t)f*hdr.nlines;
+			l.zR = l.z+hdr.nlines;
+			l.zL = l.z-hdr.nlines;
+			l.avg = avgt+(size_t)f*hdr.nlines;
+			l.avgR = l.avg+hdr.nlines;
+			l.avgL = l.avg-hdr.nlines;
+			for(t=0; t<d.length; ++t){
+				ok[t] = data.valid(t, f);
+				okR[t] = data.valid(t, f+1);
+				okL[t] = data.valid(t, f-1);
+			}
+			l.ok = ok.data();
+			l.okR = okR.data();
+			l.okL = okL.data();
+		} else{
+			// a row and the pixels next to it along the row
+			l.z = data.z.data()+(size_t)f*hdr.ncols;
+			l.zR = l.z+1;
+			l.zL = l.z-1;
+			l.avg = data.avg+(size_t)f*hdr.ncols;
+			l.avgR = l.avg+1;
+			l.avgL = l.avg-1;
+			for(t=0; t<d.length; ++t){
+				ok[t+1] = data.valid(f, t);
+			}
+			l.ok = ok.data()+1;
+			l.okR = l.ok+1;
+			l.okL = l.ok-1;
+		}
+		transect(d, l, k0, n, w);
+	}
+}
+
+// the dune crest (prevZ: the dune toe elevations) or the dune heel (prevZ NULL)
+// of every lane, searched from position from and stored in pos
+void ThresholdSweep::search(const SweepDirection &d, const SweepLine &l, const int *from, int *pos, const float *prevZ, const float *t, const float *dmin, const float *dmax, int n, SweepLanes &w){
+	int k, j, j0 = -1;
+
+	for(k=0; k<n; ++k){
+		// (a search that runs away from the side the landform lies on, or that
+		// starts past the image limits, finds nothing)
+		int reach = (d.step > 0) ? from[k] < d.hi : from[k] > d.lo;
+		pos[k] = 0;
+		w.done[k] = !w.shore[k] || d.step != d.behind || !reach;
+		if(!w.done[k] && (j0 < 0 || (from[k]-j0)*d.step < 0)){
+			j0 = from[k];
+		}
+	}
+	for(j=j0; j0>=0 && j>=0 && j<d.length; j+=d.step){
+		int inr = j>d.lo && j<d.hi;
+		float a = l.avg[j], al = l.avgL[j], z = l.z[j];
+		int ok = l.ok[j], open = 0;
+
+		for(k=0; k<n; ++k){
+			int started = (j-from[k])*d.step >= 0;
+			int back = (j-from[k])*d.behind > 0;
+			float dist = d.distance(from[k], j);
+			int hit = started & inr & back & !w.done[k]
+				& (a >= t[k]) & (al < t[k]) & (al != -9999) & (a != -9999) & ok
+				& (dist > dmin[k]) & (dist < dmax[k])
+				& (prevZ ? prevZ[k] < z : 1);
+			pos[k] = hit ? j : pos[k];
+			w.done[k] |= hit | (started & (d.grows() ? dist >= dmax[k] : dist <= dmin[k]));
+			open += !w.done[k];
+		}
+		if(!open) break;
+	}
+}
+
+void ThresholdSweep::transect(const SweepDirection &d, const SweepLine &l, size_t k0, int n, SweepLanes &w){
+	const Header &hdr = *d.hdr;
+	const float *tS = thr[SW_SHORE].data()+k0, *tDT = thr[SW_DT].data()+k0, *tBB = thr[SW_BB].data()+k0;
+	const float *dmin = thr[SW_DUNE_MIN].data()+k0, *dmax = thr[SW_DUNE_MAX].data()+k0;
+	const RRKernels &kern = rrKernels();
+	int k, j, j0, open;
+
+	///////////////////////
+	// SHORELINE
+	///////////////////////
+	j0 = (d.step > 0) ? d.lo+1 : d.hi-1;
+	for(k=0; k<n; ++k){
+		w.shore[k] = 0;
+		w.done[k] = 0;
+		w.from[k] = j0;
+	}
+	open = n;
+	for(j=j0; j>d.lo && j<d.hi && open; j+=d.step){
+		if(l.ok[j]){
+			open = kern.crossing(l.z[j], l.zR[j], l.okR[j], j, d.step, tS, w.from.data(), w.shore.data(), w.done.data(), n);
+		}
+	}
+
+	///////////////////////
+	// DUNE TOE
+	///////////////////////
+	// (a search that looks at the distance window without a match leaves a
+	// toe elevation of -99999, which the dune crest is compared with)
+	j0 = -1;
+	for(k=0; k<n; ++k){
+		w.toe[k] = 0;
+		w.seen[k] = 0;
+		w.done[k] = !w.shore[k];
+		if(!w.done[k] && (j0 < 0 || (w.shore[k]-j0)*d.step < 0)){
+			j0 = w.shore[k];
+		}
+	}
+	for(j=j0; j0>=0 && j>=0 && j<d.length; j+=d.step){
+		int inr = j>d.lo && j<d.hi;
+		float a = l.avg[j], ar = l.avgR[j];
+
+		open = 0;
+		for(k=0; k<n; ++k){
+			int started = (j-w.shore[k])*d.step >= 0;
+			float dist = d.distance(w.shore[k], j);
+			int win = started & inr & (dist > dmin[k]) & (dist < dmax[k]) & !w.done[k];
+			int hit = win & (ar < tDT[k]) & (a >= tDT[k]);
+			w.toe[k] = hit ? j : w.toe[k];
+			w.seen[k] |= win;
+			w.done[k] |= hit | (started & (d.grows() ? dist >= dmax[k] : dist <= dmin[k]));
+			open += !w.done[k];
+		}
+		if(!open) break;
+	}
+	for(k=0; k<n; ++k){
+		w.toeZ[k] = w.toe[k] ? l.z[w.toe[k]] : (w.seen[k] ? -99999 : 0);
+	}
+
+	///////////////////////
+	// DUNE CREST, DUNE HEEL
+	///////////////////////
+	search(d, l, w.toe.data(), w.crest.data(), w.toeZ.data(), thr[SW_DC].data()+k0, thr[SW_CREST_MIN].data()+k0, thr[SW_CREST_MAX].data()+k0, n, w);
+	search(d, l, w.crest.data(), w.heel.data(), NULL, thr[SW_DH].data()+k0, thr[SW_HEEL_MIN].data()+k0, thr[SW_HEEL_MAX].data()+k0, n, w);
+
+	///////////////////////
+	// BACKBARRIER EDGE
+	///////////////////////
+	j0 = -1;
+	for(k=0; k<n; ++k){
+		// (from the last dune landform found)
+		w.from[k] = w.heel[k] ? w.heel[k] : (w.crest[k] ? w.crest[k] : (w.toe[k] ? w.toe[k] : w.shore[k]));
+		w.back[k] = 0;
+		w.done[k] = !w.shore[k];
+		if(!w.done[k] && (j0 < 0 || (w.from[k]-j0)*d.step < 0)){
+			j0 = w.from[k];
+		}
+	}
+	open = n;
+	for(j=j0; j0>=0 && j>=0 && j<d.length && open; j+=d.step){
+		if(j>d.lo && j<d.hi && l.ok[j]){
+			open = kern.crossing(l.z[j], l.zL[j], l.okL[j], j, d.step, tBB, w.from.data(), w.back.data(), w.done.data(), n);
+		}
+	}
+	for(k=0; k<n; ++k){
+		bool seen = (d.step > 0) ? d.visits(w.from[k], d.length-1) : d.visits(0, w.from[k]);
+		w.backZ[k] = w.back[k] ? l.z[w.back[k]] : (seen ? -99999 : 0);
+	}
+
+	///////////////////////
+	// VOLUMES
+	///////////////////////
+	// (only the pixels between the landforms of some lane are visited, in the
+	// order of the extraction so that the sums are the same)
+	int v0 = d.length, v1 = -1;
+	bool up = d.volumeUp;
+	for(k=0; k<n; ++k){
+		int s = w.shore[k], toe = w.toe[k], heel = w.heel[k], back = w.back[k];
+		w.beach[k] = 0;
+		w.dune[k] = 0;
+		w.island[k] = 0;
+		// (the volumes of the landforms not found are empty)
+		w.beachLo[k] = w.duneLo[k] = w.islandLo[k] = d.length;
+		w.beachHi[k] = w.duneHi[k] = w.islandHi[k] = -1;
+		if(!s){
+			continue;
+		}
+		// (beach: shoreline to dune toe, dune: dune toe to heel, island: shoreline to backbarrier)
+		if(toe && 0 <= (d.shoreline(l.f, s) - d.along(toe))*d.beachRes){
+			w.beachLo[k] = up ? s : toe;
+			w.beachHi[k] = up ? toe : s;
+		}
+		if(heel){
+			w.duneLo[k] = up ? toe : heel;
+			w.duneHi[k] = up ? heel : toe;
+		}
+		if(w.backZ[k] != -99999){
+			w.islandLo[k] = up ? s : back;
+			w.islandHi[k] = up ? back : s;
+		}
+		v0 = min(v0, min(w.beachLo[k], min(w.duneLo[k], w.islandLo[k])));
+		v1 = max(v1, max(w.beachHi[k], max(w.duneHi[k], w.islandHi[k])));
+	}
+	v0 = max(v0, 0);
+	v1 = min(v1, d.length-1);
+	// (W sums from the right to the left)
+	int vstep = (d.step < 0 && !d.columns) ? -1 : 1;
+	for(j=(vstep > 0) ? v0 : v1; j>=v0 && j<=v1; j+=vstep){
+		if(!l.ok[j]){
+			continue;
+		}
+		kern.volume(l.z[j], j, hdr.xres, hdr.yres, tS, w.beachLo.data(), w.beachHi.data(), w.beach.data(), n);
+		kern.volume(l.z[j], j, hdr.xres, hdr.yres, tS, w.duneLo.data(), w.duneHi.data(), w.dune.data(), n);
+		kern.volume(l.z[j], j, hdr.xres, hdr.yres, tS, w.islandLo.data(), w.islandHi.data(), w.island.data(), n);
+	}
+
+	///////////////////////
+	// METRICS
+	///////////////////////
+	for(k=0; k<n; ++k){
+		size_t s = k0+k;
+		if(!w.shore[k] || d.transect(l.f, w.shore[k]) == 0){
+			continue;
+		}
+		// (the crest and heel elevations of a search that looked at a pixel
+		// without a match are -99999 as well)
+		double shorex = d.shoreline(l.f, w.shore[k]);
+		double toex = w.toe[k] ? d.along(w.toe[k]) : 0;
+		double backx = w.back[k] ? d.along(w.back[k]) : 0;
+		bool crestSeen = d.step == d.behind && ((d.step > 0) ? d.visits(w.toe[k]+1, d.length-1) : d.visits(0, w.toe[k]-1));
+		double crestz = w.crest[k] ? l.z[w.crest[k]] : (crestSeen ? -99999 : 0);
+		double toez = w.toeZ[k];
+		double value[SW_NMEANS];
+
+		value[SW_DUNE_HEIGHT] = ((crestz-toez)>0 && (crestz-toez)<d.dhMax) ? crestz-toez : -99999;
+		value[SW_BEACH_VOL] = (w.beach[k] <= 0) ? -99999 : w.beach[k];
+		value[SW_DUNE_VOL] = (w.dune[k] <= 0) ? -99999 : w.dune[k];
+		value[SW_ISLAND_VOL] = (w.island[k] <= 0) ? -99999 : w.island[k];
+		// (a width without the landform at its far end is left out)
+		value[SW_BEACH_WIDTH] = w.toe[k] ? abs(shorex-toex)*d.res : -99999;
+		value[SW_ISLAND_WIDTH] = (w.back[k] && abs(shorex-backx)*d.res>0) ? abs(shorex-backx)*d.res : -99999;
+
+		lines[s] += 1;
+		found[0][s] += w.toe[k] ? 1 : 0;
+		found[1][s] += w.crest[k] ? 1 : 0;
+		found[2][s] += w.heel[k] ? 1 : 0;
+		found[3][s] += w.back[k] ? 1 : 0;
+		for(j=0; j<SW_NMEANS; ++j){
+			// (the values of the metrics file)
+			float v = (float)value[j];
+			if(v != -99999){
+				sum[j][s] += v;
+				count[j][s] += 1;
+			}
+		}
+	}
+}
+
+bool ThresholdSweep::write(string csvName, string arrowName) const {
+	static const char *means[SW_NMEANS] = { "beach_width", "beach_vol", "dune_height", "dune_vol", "island_width", "island_volume" };
+	MetricsWriter table;
+	size_t s;
+	int k;
+
+	if(!table.open(csvName, arrowName)){
+		return false;
+	}
+	table.column("set");
+	for(k=0; k<SW_NKEYS; ++k){
+		table.column(SWEEP_KEYS[k].name, true);
+	}
+	table.column("transects");
+	table.column("dunetoe_found");
+	table.column("dunecrest_found");
+	table.column("duneheel_found");
+	table.column("backbarrier_found");
+	for(k=0; k<SW_NMEANS; ++k){
+		table.column(string("mean_")+means[k]);
+	}
+	table.header();
+
+	for(s=0; s<nsets; ++s){
+		table.fields((double)(s+1));
+		for(k=0; k<SW_NKEYS; ++k){
+			table.fields(thr[k][s]);
+		}
+		table.fields(lines[s], found[0][s], found[1][s], found[2][s], found[3][s]);
+		for(k=0; k<SW_NMEANS; ++k){
+			table.fields(count[k][s] ? sum[k][s]/count[k][s] : -99999.0);
+		}
+		table.endLine();
+	}
+	return table.close();
+}